@@ -0,0 +1,67 @@
+#version 430 core
+layout (local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// edge-avoiding a-trous wavelet filter (Dammertz et al. 2010)
+// one dispatch per iteration, stepWidth doubles every iteration
+
+
+layout (rgba16f, binding = 0) uniform readonly image2D inImage;
+layout (rgba16f, binding = 1) uniform writeonly image2D outImage;
+layout (rgba16f, binding = 2) uniform readonly image2D normalDepthImage;
+layout (rgba16f, binding = 3) uniform readonly image2D albedoImage;
+
+uniform int stepWidth;
+uniform float colorPhi;
+uniform float normalPhi;
+uniform float depthPhi;
+uniform float albedoPhi;
+
+
+const float kernel[3] = float[3](3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0);
+
+
+void main() {
+    ivec2 size = imageSize(outImage);
+    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+
+    if (pixelCoord.x >= size.x || pixelCoord.y >= size.y) {
+        return;
+    }
+
+    vec4 color = imageLoad(inImage, pixelCoord);
+    vec4 normalDepth = imageLoad(normalDepthImage, pixelCoord);
+    vec3 albedo = imageLoad(albedoImage, pixelCoord).rgb;
+
+    vec3 sum = vec3(0.0);
+    float weightSum = 0.0;
+
+    for (int y = -2; y <= 2; y++) {
+        for (int x = -2; x <= 2; x++) {
+            ivec2 coord = clamp(pixelCoord + ivec2(x, y) * stepWidth, ivec2(0), size - 1);
+
+            vec3 sampleColor = imageLoad(inImage, coord).rgb;
+            vec4 sampleNormalDepth = imageLoad(normalDepthImage, coord);
+            vec3 sampleAlbedo = imageLoad(albedoImage, coord).rgb;
+
+            vec3 t = color.rgb - sampleColor;
+            float colorWeight = min(exp(-dot(t, t) / colorPhi), 1.0);
+
+            t = normalDepth.xyz - sampleNormalDepth.xyz;
+            float normalWeight = min(exp(-max(dot(t, t) / (stepWidth * stepWidth), 0.0) / normalPhi), 1.0);
+
+            float dt = normalDepth.w - sampleNormalDepth.w;
+            float depthWeight = min(exp(-(dt * dt) / depthPhi), 1.0);
+
+            t = albedo - sampleAlbedo;
+            float albedoWeight = min(exp(-dot(t, t) / albedoPhi), 1.0);
+
+            float weight = colorWeight * normalWeight * depthWeight * albedoWeight;
+            weight *= kernel[abs(x)] * kernel[abs(y)];
+
+            sum += sampleColor * weight;
+            weightSum += weight;
+        }
+    }
+
+    imageStore(outImage, pixelCoord, vec4(sum / weightSum, color.a));
+}
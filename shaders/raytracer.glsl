@@ -1,8 +1,26 @@
 
 #version 430 core
-layout (local_size_x = WG_SIZE, local_size_y = WG_SIZE, local_size_z = 1) in;
+layout (local_size_x = WG_WIDTH, local_size_y = WG_HEIGHT, local_size_z = 1) in;
 
 #define FLT_MAX 3.402823466e+38F
+#define PI 3.14159265
+
+#define PRIMITIVE_NONE 0
+#define PRIMITIVE_SPHERE 1
+#define PRIMITIVE_TRIANGLE 2
+
+// specialized variants bake the loop bounds in so they can be unrolled, 0 reads them from the config
+#if BOUNCE_LIMIT > 0
+    #define BOUNCES BOUNCE_LIMIT
+#else
+    #define BOUNCES int(config.bounceLimit)
+#endif
+
+#if NUM_SAMPLES > 0
+    #define SAMPLES NUM_SAMPLES
+#else
+    #define SAMPLES int(config.numSamples)
+#endif
 
 
 // ----- STRUCT DEFINITIONS -----
@@ -14,6 +32,14 @@ struct Camera {
 };
 
 
+// forward matrices of the camera used for the previous frame
+struct PrevCamera {
+    mat4 viewMat;
+    mat4 projMat;
+    vec3 position;
+};
+
+
 struct Ray {
     vec3 origin;
     vec3 direction;
@@ -38,6 +64,14 @@ struct Triangle {
 };
 
 
+// what the intersection test needs of a triangle
+struct TriangleGeometry {
+    vec3 v0;
+    vec3 edge1;
+    vec3 edge2;
+};
+
+
 struct Material {
     vec3 albedo;
     float roughness;
@@ -45,12 +79,39 @@ struct Material {
 };
 
 
+// only what the closest-hit search needs, the surface is resolved once afterwards
 struct HitRecord {
-    vec3 worldPosition;
     float hitDistance;
+    int primitiveType;
+    int primitiveIndex;
+    // barycentrics of v1 and v2, unused for spheres
+    vec2 barycentrics;
+};
+
+
+struct Surface {
+    vec3 worldPosition;
     vec3 worldNormal;
     float materialIndex;
     vec2 uv;
+    // 0.5 * log2(texel area / world area) of the primitive, the texture lod of a unit wide ray cone
+    float lodBias;
+};
+
+
+// first-hit data, used as guide for the denoiser
+struct FirstHit {
+    vec3 normal;
+    float depth;
+    vec3 albedo;
+};
+
+
+// one entry of an alias table, see rt::AliasEntry
+struct AliasEntry {
+    float threshold;
+    uint alias;
+    float probability;
 };
 
 
@@ -69,15 +130,89 @@ struct Config {
 
 // ----- UNIFORMS AND BUFFERS -----
 
-layout (rgba16f, binding = 0) uniform image2D outImage;
+#if NUM_VIEWS > 1
+    // one layer per view, indexed by the z workgroup
+    layout (rgba16f, binding = 0) uniform image2DArray outImage;
+#else
+    layout (rgba16f, binding = 0) uniform image2D outImage;
+#endif
+
+#if WRITE_AOVS
+    // xyz: world normal, w: hit distance (0 on miss)
+    layout (rgba16f, binding = 1) uniform writeonly image2D normalDepthImage;
+    layout (rgba16f, binding = 2) uniform writeonly image2D albedoImage;
+#endif
+
+#if REPROJECT_HISTORY
+    // copies of outImage and normalDepthImage from the previous frame
+    layout (rgba16f, binding = 3) uniform readonly image2D historyImage;
+    layout (rgba16f, binding = 4) uniform readonly image2D historyNormalDepthImage;
 
-uniform sampler2D materialTexture;
+    uniform PrevCamera prevCamera;
+    // 1 for the first frame after a camera change
+    uniform int reprojectHistory;
+#endif
+
+#if COLLECT_STATS
+    // primitive tests and node visits of this frame per pixel, shown as a heatmap
+    layout (r32ui, binding = 5) uniform writeonly uimage2D statsImage;
+
+    // totals of this frame, cleared by the host before the dispatch
+    // (32 bit, so they wrap for frames doing billions of tests)
+    layout (std430, binding = 4) buffer statsBlock {
+        uint paths;
+        uint rays;
+        uint primitiveTests;
+        uint nodeVisits;
+        uint maxPixelCost;
+    } stats;
+
+    // counted per invocation, added to the buffer once per pixel
+    uint statRays;
+    uint statPrimitiveTests;
+    uint statNodeVisits;
+#endif
+
+#if CONSTANT_MATERIALS
+    // xyz: albedo, w: roughness, used when no material varies over its surface
+    uniform vec4 materialConstants[MAX_MATERIAL_CONSTANTS];
+#else
+    uniform sampler2D materialTexture;
+#endif
+
+#if NUM_VIEWS > 1
+    uniform Camera cameras[NUM_VIEWS];
+    // every use of the camera picks this invocation's view
+    #define camera cameras[gl_GlobalInvocationID.z]
+#else
+    uniform Camera camera;
+#endif
 
-uniform Camera camera;
 uniform SceneInfo sceneInfo;
+
+#if ENVIRONMENT_MAP
+    // equirectangular, u follows the azimuth and v goes from straight up to straight down
+    uniform sampler2D environmentTexture;
+
+    // alias table over the rows, then one table per row over its pixels
+    layout (std430, binding = 5) readonly buffer environmentBlock {
+        AliasEntry data[];
+    } environmentTable;
+
+    // 0 when the scene has no map (in variants that are not specialized)
+    uniform int useEnvironment;
+    uniform float environmentIntensity;
+    uniform ivec2 environmentSize;
+#endif
 uniform Config config;
-uniform float numMaterials;
+// columns and rows of material cells in the packed texture
+uniform vec2 materialGridSize;
 uniform int frameIndex;
+// part of the full image rendered by this dispatch
+// xy: position of the output image's first pixel in the full image, zw: size of the full image
+uniform ivec4 imageRegion;
+// first pixel of the output image covered by this dispatch, frames split into tiles dispatch one at a time
+uniform ivec2 dispatchOffset;
 
 
 #if USE_UNIFORM_OBJECTS
@@ -93,7 +228,7 @@ uniform int frameIndex;
     uniform SceneSpheres sceneSpheres;
     uniform SceneTriangles sceneTriangles;
 
-#else
+#elif PRIMITIVE_FORMAT == 0
 
     layout (std430, binding = 2) readonly buffer sceneSpheresBlock {
         Sphere data[];
@@ -103,6 +238,50 @@ uniform int frameIndex;
         Triangle data[];
     } sceneTriangles;
 
+#else
+
+    // see rt::internal::CompactSphere and CompactTriangle, or QuantizedSphere and QuantizedTriangle
+    // radiusMaterial: half radius in the low bits, material cell in the high bits
+    #if PRIMITIVE_FORMAT == 1
+        struct PackedSphere {
+            vec3 position;
+            uint radiusMaterial;
+        };
+
+        // float arrays keep the 36 byte stride, vec3 members would be padded to 16 bytes
+        struct PackedTriangle {
+            float v0[3];
+            float edge1[3];
+            float edge2[3];
+        };
+    #else
+        // positions are 21 bits per axis over the scene bounds: position = quantizeOrigin + steps * quantizeScale
+        struct PackedSphere {
+            uint position[2];
+            uint radiusMaterial;
+        };
+
+        struct PackedTriangle {
+            uint vertices[6];
+        };
+
+        uniform vec3 quantizeOrigin;
+        uniform vec3 quantizeScale;
+    #endif
+
+    layout (std430, binding = 2) readonly buffer sceneSpheresBlock {
+        PackedSphere data[];
+    } sceneSpheres;
+
+    layout (std430, binding = 3) readonly buffer sceneTrianglesBlock {
+        PackedTriangle data[];
+    } sceneTriangles;
+
+    // only read for the closest hit, xyz: half uvs, w: material cell
+    layout (std430, binding = 6) readonly buffer sceneTriangleAttributesBlock {
+        uvec4 data[];
+    } sceneTriangleAttributes;
+
 #endif
 
 // ----- RNG FUNCTIONS -----
@@ -128,21 +307,90 @@ float randomNormalFloat(inout uint seed) {
 }
 
 
+// uniform over the sphere, so normal + randomDirection() is cosine distributed
 vec3 randomDirection(inout uint state) {
     return normalize(vec3(
-        // randomValue(state),
-        // randomValue(state),
-        // randomValue(state)
         randomNormalFloat(state),
         randomNormalFloat(state),
         randomNormalFloat(state)
-    ) * 2 - 1);
+    ));
+}
+
+
+// ----- PRIMITIVE FUNCTIONS -----
+
+#if PRIMITIVE_FORMAT == 2
+
+vec3 dequantize(uint lo, uint hi) {
+    uvec3 steps = uvec3(lo & 0x1FFFFFu, (lo >> 21u) | ((hi & 0x3FFu) << 11u), hi >> 10u);
+    return quantizeOrigin + vec3(steps) * quantizeScale;
+}
+
+#endif
+
+
+Sphere loadSphere(int index) {
+#if USE_UNIFORM_OBJECTS || PRIMITIVE_FORMAT == 0
+    return sceneSpheres.data[index];
+#else
+    PackedSphere packed = sceneSpheres.data[index];
+    Sphere sphere;
+#if PRIMITIVE_FORMAT == 1
+    sphere.position = packed.position;
+#else
+    sphere.position = dequantize(packed.position[0], packed.position[1]);
+#endif
+    sphere.radius = unpackHalf2x16(packed.radiusMaterial).x;
+    sphere.materialIndex = float(packed.radiusMaterial >> 16u);
+    return sphere;
+#endif
+}
+
+
+TriangleGeometry loadTriangleGeometry(int index) {
+    TriangleGeometry geometry;
+#if USE_UNIFORM_OBJECTS || PRIMITIVE_FORMAT == 0
+    Triangle triangle = sceneTriangles.data[index];
+    geometry.v0 = triangle.v0;
+    geometry.edge1 = triangle.v1 - triangle.v0;
+    geometry.edge2 = triangle.v2 - triangle.v0;
+#elif PRIMITIVE_FORMAT == 1
+    PackedTriangle packed = sceneTriangles.data[index];
+    geometry.v0 = vec3(packed.v0[0], packed.v0[1], packed.v0[2]);
+    geometry.edge1 = vec3(packed.edge1[0], packed.edge1[1], packed.edge1[2]);
+    geometry.edge2 = vec3(packed.edge2[0], packed.edge2[1], packed.edge2[2]);
+#else
+    PackedTriangle packed = sceneTriangles.data[index];
+    geometry.v0 = dequantize(packed.vertices[0], packed.vertices[1]);
+    geometry.edge1 = dequantize(packed.vertices[2], packed.vertices[3]) - geometry.v0;
+    geometry.edge2 = dequantize(packed.vertices[4], packed.vertices[5]) - geometry.v0;
+#endif
+    return geometry;
+}
+
+
+Triangle loadTriangle(int index) {
+#if USE_UNIFORM_OBJECTS || PRIMITIVE_FORMAT == 0
+    return sceneTriangles.data[index];
+#else
+    TriangleGeometry geometry = loadTriangleGeometry(index);
+    uvec4 attributes = sceneTriangleAttributes.data[index];
+    Triangle triangle;
+    triangle.v0 = geometry.v0;
+    triangle.v1 = geometry.v0 + geometry.edge1;
+    triangle.v2 = geometry.v0 + geometry.edge2;
+    triangle.uv0 = unpackHalf2x16(attributes.x);
+    triangle.uv1 = unpackHalf2x16(attributes.y);
+    triangle.uv2 = unpackHalf2x16(attributes.z);
+    triangle.materialIndex = float(attributes.w);
+    return triangle;
+#endif
 }
 
 
 // ----- INTERSECTION FUNCTIONS -----
 
-bool hit(Sphere sphere, Ray ray, out HitRecord record) {
+bool hit(Sphere sphere, int index, Ray ray, inout HitRecord record) {
     vec3 oc = ray.origin - sphere.position;
     float a = dot(ray.direction, ray.direction);
     float b = 2.0 * dot(oc, ray.direction);
@@ -156,15 +404,9 @@ bool hit(Sphere sphere, Ray ray, out HitRecord record) {
     float t = (-b - sqrt(d)) / (2.0 * a);
 
     if (t > 0.0 && t < record.hitDistance) {
-        record.worldPosition = ray.origin + ray.direction * t;
-        record.worldNormal = normalize(record.worldPosition - sphere.position);
         record.hitDistance = t;
-        record.materialIndex = sphere.materialIndex;
-
-        float u = 0.5 - atan(record.worldNormal.z, record.worldNormal.x) / (2*3.14);
-        float v = 0.5 - asin(record.worldNormal.y) / 3.14;
-        record.uv = vec2(u, v);
-
+        record.primitiveType = PRIMITIVE_SPHERE;
+        record.primitiveIndex = index;
         return true;
     }
 
@@ -172,9 +414,9 @@ bool hit(Sphere sphere, Ray ray, out HitRecord record) {
 }
 
 
-bool hit(Triangle triangle, Ray ray, out HitRecord record) {
-    vec3 v0v1 = triangle.v1 - triangle.v0;
-    vec3 v0v2 = triangle.v2 - triangle.v0;
+bool hit(TriangleGeometry triangle, int index, Ray ray, inout HitRecord record) {
+    vec3 v0v1 = triangle.edge1;
+    vec3 v0v2 = triangle.edge2;
     vec3 pvec = cross(ray.direction, v0v2);
 
     float det = dot(v0v1, pvec);
@@ -197,12 +439,10 @@ bool hit(Triangle triangle, Ray ray, out HitRecord record) {
 
     float t = dot(v0v2, qvec) * invDet;
     if (t > 0.0 && t < record.hitDistance) {
-        record.worldPosition = ray.origin + ray.direction * t;
         record.hitDistance = t;
-        record.worldNormal = normalize(cross(v0v1, v0v2));
-        record.worldNormal *= dot(record.worldNormal, ray.direction) < 0.0 ? 1 : -1;
-        record.materialIndex = triangle.materialIndex;
-        record.uv = u * triangle.uv1 + v * triangle.uv2 + (1-u-v) * triangle.uv0;
+        record.primitiveType = PRIMITIVE_TRIANGLE;
+        record.primitiveIndex = index;
+        record.barycentrics = vec2(u, v);
         return true;
     }
 
@@ -211,42 +451,147 @@ bool hit(Triangle triangle, Ray ray, out HitRecord record) {
 
 // ----- MAIN FUNCTIONS -----
 
-Ray genRay() {
-    vec2 imgSize = imageSize(outImage);
-    vec2 coord = vec2(gl_GlobalInvocationID.x, imgSize.y - gl_GlobalInvocationID.y);
+// pixel in the output image
+ivec2 texturePixel() {
+    return ivec2(gl_GlobalInvocationID.xy) + dispatchOffset;
+}
+
+
+// pixel in the full image, rays and random sequences only depend on this so regions match a full render
+ivec2 imagePixel() {
+    return texturePixel() + imageRegion.xy;
+}
+
+
+vec3 primaryDirection(vec2 pixel) {
+    vec2 imgSize = vec2(imageRegion.zw);
+    vec2 coord = vec2(pixel.x, imgSize.y - pixel.y);
     coord = coord / imgSize * 2.0 - 1.0;
 
     vec4 target = camera.invProjMat * vec4(coord, 1.0, 1.0);
+    return (camera.invViewMat * vec4(normalize(target.xyz / target.w), 0.0)).xyz;
+}
 
+
+Ray genRay() {
     Ray ray;
     ray.origin = camera.position;
-    ray.direction = (camera.invViewMat * vec4(normalize(target.xyz / target.w), 0.0)).xyz;
+    ray.direction = primaryDirection(vec2(imagePixel()));
     return ray;
 }
 
 
+// angle between the primary rays of neighbouring pixels, the initial spread of the ray cone
+float pixelSpreadAngle() {
+    vec2 pixel = vec2(imagePixel());
+    return length(primaryDirection(pixel + vec2(0.0, 1.0)) - primaryDirection(pixel));
+}
+
+
+#if !CONSTANT_MATERIALS
+
+// texel size of one material's cell in the packed texture
+vec2 materialCellSize() {
+    return vec2(textureSize(materialTexture, 0)) / materialGridSize;
+}
+
+#endif
+
+
 HitRecord traceRay(Ray ray) {
     HitRecord record;
     record.hitDistance = FLT_MAX;
+    record.primitiveType = PRIMITIVE_NONE;
+
+#if COLLECT_STATS
+    // every primitive is tested, there is no acceleration structure to visit yet
+    statRays++;
+    statPrimitiveTests += uint(HAS_SPHERES * sceneInfo.numSpheres + HAS_TRIANGLES * sceneInfo.numTriangles);
+#endif
 
+#if HAS_SPHERES
     for (int i = 0; i < sceneInfo.numSpheres; i++) {
-        hit(sceneSpheres.data[i], ray, record);
+        hit(loadSphere(i), i, ray, record);
     }
+#endif
 
+#if HAS_TRIANGLES
     for (int i = 0; i < sceneInfo.numTriangles; i++) {
-        hit(sceneTriangles.data[i], ray, record);
+        hit(loadTriangleGeometry(i), i, ray, record);
     }
+#endif
 
     return record;
 }
 
 
-Material loadMaterial(float materialIndex, vec2 uv) {
-    float v = 1.0 / numMaterials * (materialIndex + uv.y);
+// position, normal and uv of the closest hit
+Surface resolveHit(Ray ray, HitRecord record) {
+    Surface surface;
+    surface.worldPosition = ray.origin + ray.direction * record.hitDistance;
+    surface.lodBias = 0.0;
+
+#if CONSTANT_MATERIALS
+    float texelArea = 1.0;
+#else
+    vec2 cellSize = materialCellSize();
+    float texelArea = cellSize.x * cellSize.y;
+#endif
+
+#if HAS_SPHERES
+    if (record.primitiveType == PRIMITIVE_SPHERE) {
+        Sphere sphere = loadSphere(record.primitiveIndex);
+        surface.worldNormal = normalize(surface.worldPosition - sphere.position);
+        surface.materialIndex = sphere.materialIndex;
+
+        float u = 0.5 - atan(surface.worldNormal.z, surface.worldNormal.x) / (2*3.14);
+        float v = 0.5 - asin(surface.worldNormal.y) / 3.14;
+        surface.uv = vec2(u, v);
+
+        // the whole cell is wrapped around the sphere
+        float worldArea = 4.0 * 3.14 * sphere.radius * sphere.radius;
+        surface.lodBias = 0.5 * log2(texelArea / worldArea);
+    }
+#endif
+
+#if HAS_TRIANGLES
+    if (record.primitiveType == PRIMITIVE_TRIANGLE) {
+        Triangle triangle = loadTriangle(record.primitiveIndex);
+        float u = record.barycentrics.x;
+        float v = record.barycentrics.y;
+
+        vec3 edgeCross = cross(triangle.v1 - triangle.v0, triangle.v2 - triangle.v0);
+        surface.worldNormal = normalize(edgeCross);
+        surface.worldNormal *= dot(surface.worldNormal, ray.direction) < 0.0 ? 1 : -1;
+        surface.materialIndex = triangle.materialIndex;
+        surface.uv = u * triangle.uv1 + v * triangle.uv2 + (1-u-v) * triangle.uv0;
+
+        vec2 uvEdge1 = triangle.uv1 - triangle.uv0;
+        vec2 uvEdge2 = triangle.uv2 - triangle.uv0;
+        float uvArea = abs(uvEdge1.x * uvEdge2.y - uvEdge1.y * uvEdge2.x);
+        surface.lodBias = 0.5 * log2(max(texelArea * uvArea, 1e-8) / length(edgeCross));
+    }
+#endif
+
+    return surface;
+}
+
+
+Material loadMaterial(float materialIndex, vec2 uv, float lod) {
+#if CONSTANT_MATERIALS
+    vec4 value_ar = materialConstants[int(materialIndex)];
+#else
+    // cells are laid out row by row, uvs wrap inside the cell
+    vec2 cell = vec2(mod(materialIndex, materialGridSize.x), floor(materialIndex / materialGridSize.x));
+    vec2 cellUv = (cell + fract(uv)) / materialGridSize;
+
+    // levels smaller than 4 texels per cell would mostly show the neighbouring materials
+    vec2 cellSize = materialCellSize();
+    float maxLod = max(log2(min(cellSize.x, cellSize.y)) - 2.0, 0.0);
 
     // ar: albedo and roughness
-    float u_ar = 1.0 / 1.0 * (0 + uv.x);
-    vec4 value_ar = texture(materialTexture, vec2(u_ar, v));
+    vec4 value_ar = textureLod(materialTexture, cellUv, clamp(lod, 0.0, maxLod));
+#endif
 
     Material material;
     material.albedo = value_ar.rgb;
@@ -256,54 +601,274 @@ Material loadMaterial(float materialIndex, vec2 uv) {
 }
 
 
-vec3 perPixel(inout uint rngState) {
+#if ENVIRONMENT_MAP
+
+vec2 environmentUv(vec3 direction) {
+    return vec2(0.5 + atan(direction.z, direction.x) / (2.0 * PI), acos(clamp(direction.y, -1.0, 1.0)) / PI);
+}
+
+
+// solid angle density of sampleEnvironment() returning the direction
+float environmentPdf(vec3 direction) {
+    float sinTheta = sqrt(max(1.0 - direction.y * direction.y, 0.0));
+    if (sinTheta == 0.0) {
+        return 0.0;
+    }
+
+    ivec2 texel = min(ivec2(environmentUv(direction) * vec2(environmentSize)), environmentSize - 1);
+    float rowProbability = environmentTable.data[texel.y].probability;
+    float texelProbability = environmentTable.data[environmentSize.y + texel.y * environmentSize.x + texel.x].probability;
+    // a texel spans 2pi / width of azimuth and pi / height of elevation
+    return rowProbability * texelProbability * float(environmentSize.x * environmentSize.y) / (2.0 * PI * PI * sinTheta);
+}
+
+
+int sampleAliasTable(int offset, int count, inout uint rngState) {
+    float pick = randomValue(rngState) * float(count);
+    int index = min(int(pick), count - 1);
+    AliasEntry entry = environmentTable.data[offset + index];
+    return pick - float(index) < entry.threshold ? index : int(entry.alias);
+}
+
+
+// direction towards the map picked by luminance, uniform within the texel
+vec3 sampleEnvironment(inout uint rngState, out float pdf) {
+    int y = sampleAliasTable(0, environmentSize.y, rngState);
+    int x = sampleAliasTable(environmentSize.y + y * environmentSize.x, environmentSize.x, rngState);
+    vec2 uv = (vec2(x, y) + vec2(randomValue(rngState), randomValue(rngState))) / vec2(environmentSize);
+
+    float phi = (uv.x - 0.5) * 2.0 * PI;
+    float theta = uv.y * PI;
+    vec3 direction = vec3(cos(phi) * sin(theta), cos(theta), sin(phi) * sin(theta));
+    pdf = environmentPdf(direction);
+    return direction;
+}
+
+
+float powerHeuristic(float pdf, float otherPdf) {
+    float squared = pdf * pdf;
+    return squared / (squared + otherPdf * otherPdf);
+}
+
+#endif
+
+
+// light arriving along rays that hit nothing
+vec3 skyRadiance(vec3 direction) {
+#if ENVIRONMENT_MAP
+    if (useEnvironment == 1) {
+        return textureLod(environmentTexture, environmentUv(direction), 0.0).rgb * environmentIntensity;
+    }
+#endif
+    return sceneInfo.backgroundColor;
+}
+
+
+#if ENVIRONMENT_MAP
+
+// next event estimation: the map's direct light on the diffuse part of the surface (its roughness, as a lambertian lobe),
+// weighted against the same light being found by the bounce
+vec3 sampleDirectLight(Surface surface, Material material, inout uint rngState) {
+    float lightPdf;
+    vec3 direction = sampleEnvironment(rngState, lightPdf);
+    float cosine = dot(surface.worldNormal, direction);
+    if (cosine <= 0.0 || lightPdf <= 0.0) {
+        return vec3(0.0);
+    }
+
+    Ray shadowRay;
+    shadowRay.origin = surface.worldPosition + surface.worldNormal * 0.001;
+    shadowRay.direction = direction;
+    if (traceRay(shadowRay).primitiveType != PRIMITIVE_NONE) {
+        return vec3(0.0);
+    }
+
+    float bouncePdf = cosine / PI;
+    vec3 brdf = material.albedo * material.roughness / PI;
+    return brdf * cosine * skyRadiance(direction) * powerHeuristic(lightPdf, bouncePdf) / lightPdf;
+}
+
+#endif
+
+
+vec3 perPixel(inout uint rngState, out FirstHit firstHit) {
     Ray ray = genRay();
     vec3 light = vec3(0.0, 0.0, 0.0);
     vec3 contribution = vec3(1.0, 1.0, 1.0);
 
-    for (float i = 0; i < config.bounceLimit; i++) {
+    firstHit.normal = vec3(0.0);
+    firstHit.depth = 0.0;
+    firstHit.albedo = skyRadiance(ray.direction);
+
+    // diffuse part and cosine density of the last bounce, for weighting the light it finds against the light sampling
+    float bounceRoughness = 0.0;
+    float bouncePdf = 0.0;
+
+    // ray cone footprint (Ray Tracing Gems, ch. 20) for picking texture levels
+    float coneSpread = pixelSpreadAngle();
+    float coneWidth = 0.0;
+
+    for (int i = 0; i < BOUNCES; i++) {
         HitRecord record = traceRay(ray);
 
-        if (record.hitDistance == FLT_MAX) {
-            light += sceneInfo.backgroundColor * contribution;
+        if (record.primitiveType == PRIMITIVE_NONE) {
+            vec3 radiance = skyRadiance(ray.direction);
+#if ENVIRONMENT_MAP
+            // the glossy part of the bounce is not light sampled, so it keeps its full weight
+            if (useEnvironment == 1 && i > 0) {
+                radiance *= mix(1.0, powerHeuristic(bouncePdf, environmentPdf(ray.direction)), bounceRoughness);
+            }
+#endif
+            light += radiance * contribution;
             break;
         }
 
-        Material material = loadMaterial(record.materialIndex, record.uv);
+        Surface surface = resolveHit(ray, record);
+
+        coneWidth += coneSpread * record.hitDistance;
+        float cosine = max(abs(dot(surface.worldNormal, ray.direction)), 1e-4);
+        float lod = surface.lodBias + log2(max(coneWidth, 1e-8)) - log2(cosine);
+        Material material = loadMaterial(surface.materialIndex, surface.uv, lod);
+
+        if (i == 0) {
+            firstHit.normal = surface.worldNormal;
+            firstHit.depth = record.hitDistance;
+            firstHit.albedo = material.albedo;
+        }
+
+#if ENVIRONMENT_MAP
+        if (useEnvironment == 1 && material.roughness > 0.0) {
+            light += sampleDirectLight(surface, material, rngState) * contribution;
+        }
+#endif
 
         // light += materials.data[record.materialIndex].albedo * materials.data[record.materialIndex].emissionPower * contribution;
         contribution *= material.albedo;
 
-        vec3 diffuseDir = normalize(record.worldNormal + randomDirection(rngState));
-        vec3 specularDir = reflect(ray.direction, record.worldNormal);
+        vec3 diffuseDir = normalize(surface.worldNormal + randomDirection(rngState));
+        vec3 specularDir = reflect(ray.direction, surface.worldNormal);
 
-        ray.origin = record.worldPosition + record.worldNormal * 0.001;
+        ray.origin = surface.worldPosition + surface.worldNormal * 0.001;
+        // rough bounces scatter widely, which widens the cone
+        coneSpread += material.roughness;
         ray.direction = normalize(mix(specularDir, diffuseDir, material.roughness));
+        bounceRoughness = material.roughness;
+        bouncePdf = max(dot(surface.worldNormal, ray.direction), 0.0) / PI;
     }
 
     return light;
 }
 
 
+#if REPROJECT_HISTORY
+
+// warps the previous frame's accumulation into the current view
+// returns accumulated color and its sample count (0 when disoccluded)
+vec4 loadReprojectedHistory(FirstHit firstHit) {
+    if (firstHit.depth == 0.0) {
+        return vec4(0.0);
+    }
+
+    Ray ray = genRay();
+    vec3 worldPosition = ray.origin + ray.direction * firstHit.depth;
+
+    vec4 clip = prevCamera.projMat * prevCamera.viewMat * vec4(worldPosition, 1.0);
+    if (clip.w <= 0.0) {
+        return vec4(0.0);
+    }
+
+    // inverse of the mapping in genRay()
+    vec2 imgSize = imageSize(outImage);
+    vec2 ndc = clip.xy / clip.w;
+    ivec2 prevCoord = ivec2(round(vec2(
+        (ndc.x + 1.0) * 0.5 * imgSize.x,
+        imgSize.y - (ndc.y + 1.0) * 0.5 * imgSize.y
+    )));
+
+    if (any(lessThan(prevCoord, ivec2(0))) || any(greaterThanEqual(prevCoord, ivec2(imgSize)))) {
+        return vec4(0.0);
+    }
+
+    // disocclusion: the surface seen there last frame must be the same one
+    vec4 prevNormalDepth = imageLoad(historyNormalDepthImage, prevCoord);
+    float expectedDepth = distance(prevCamera.position, worldPosition);
+    if (abs(prevNormalDepth.w - expectedDepth) > 0.05 * expectedDepth || dot(prevNormalDepth.xyz, firstHit.normal) < 0.9) {
+        return vec4(0.0);
+    }
+
+    vec4 history = imageLoad(historyImage, prevCoord);
+    return vec4(history.rgb, min(history.a, float(MAX_HISTORY_LENGTH)));
+}
+
+#endif
+
+
 void main() {
-    ivec2 pixelCoord = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 pixelCoord = texturePixel();
+    // workgroups on the right and bottom edges reach past the image
+    if (any(greaterThanEqual(pixelCoord, imageSize(outImage).xy))) {
+        return;
+    }
 
 #if 0
     vec2 coord = vec2(pixelCoord) / imageSize(outImage);
     imageStore(outImage, pixelCoord, texture(materialTexture, coord));
 #else
-    uint rngState = pixelCoord.x * pixelCoord.y + uint(frameIndex) * 32421u;
+#if NUM_VIEWS > 1
+    ivec3 outCoord = ivec3(pixelCoord, gl_GlobalInvocationID.z);
+#else
+    ivec2 outCoord = pixelCoord;
+#endif
+
+    ivec2 seedPixel = imagePixel();
+    uint rngState = seedPixel.x * seedPixel.y + uint(frameIndex) * 32421u;
 
+#if COLLECT_STATS
+    statRays = 0u;
+    statPrimitiveTests = 0u;
+    statNodeVisits = 0u;
+#endif
+
+    // primary rays are not jittered, so every sample sees the same first hit
+    FirstHit firstHit;
     vec3 frameColor = vec3(0.0, 0.0, 0.0);
-    for (float i = 0; i < config.numSamples; i++) {
-        frameColor += perPixel(rngState);
+    for (int i = 0; i < SAMPLES; i++) {
+        frameColor += perPixel(rngState, firstHit);
     }
-    frameColor /= config.numSamples;
+    frameColor /= float(SAMPLES);
+
+#if WRITE_AOVS
+    imageStore(normalDepthImage, pixelCoord, vec4(firstHit.normal, firstHit.depth));
+    imageStore(albedoImage, pixelCoord, vec4(firstHit.albedo, 1.0));
+#endif
 
-    vec3 accumColor = imageLoad(outImage, pixelCoord).rgb;
+    // alpha holds the number of frames accumulated in the pixel
+    // (saturates at 2048 because of rgba16f, which then acts as a moving average)
+    vec4 accum;
+    if (frameIndex == 1) {
+        accum = vec4(0.0);
+    }
+#if REPROJECT_HISTORY
+    else if (reprojectHistory == 1) {
+        accum = loadReprojectedHistory(firstHit);
+    }
+#endif
+    else {
+        accum = imageLoad(outImage, outCoord);
+    }
 
-    vec3 avgColor = (accumColor * (frameIndex-1) + frameColor) / frameIndex;
-    imageStore(outImage, pixelCoord, vec4(avgColor, 1.0));
+    vec3 avgColor = (accum.rgb * accum.a + frameColor) / (accum.a + 1.0);
+    imageStore(outImage, outCoord, vec4(avgColor, accum.a + 1.0));
+
+#if COLLECT_STATS
+    uint pixelCost = statPrimitiveTests + statNodeVisits;
+    imageStore(statsImage, pixelCoord, uvec4(pixelCost));
+    atomicAdd(stats.paths, uint(SAMPLES));
+    atomicAdd(stats.rays, statRays);
+    atomicAdd(stats.primitiveTests, statPrimitiveTests);
+    atomicAdd(stats.nodeVisits, statNodeVisits);
+    atomicMax(stats.maxPixelCost, pixelCost);
+#endif
 
     // imageStore(outImage, pixelCoord, vec4(frameColor, 1.0));
 #endif
@@ -5,13 +5,38 @@
 uniform sampler2D texture0;
 uniform vec2 windowSize;
 uniform float gamma;
+// per-pixel cost of the raytracer instead of the image, scaled to 0 - 1 by heatmapScale
+uniform int showHeatmap;
+uniform usampler2D heatmapTexture;
+uniform float heatmapScale;
+
+
+// blue (cheap) through cyan, green and yellow to red (costly)
+vec3 heatmapColor(float t) {
+    const vec3 colors[5] = vec3[](
+        vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 1.0), vec3(0.0, 1.0, 0.0), vec3(1.0, 1.0, 0.0), vec3(1.0, 0.0, 0.0)
+    );
+    float x = clamp(t, 0.0, 1.0) * 4.0;
+    int i = min(int(x), 3);
+    return mix(colors[i], colors[i + 1], x - float(i));
+}
 
 
 void main() {
     vec2 uv = gl_FragCoord.xy / windowSize;
     uv.y = 1.0f - uv.y;
 
-    vec4 color = texture(texture0, uv);
-    color = pow(color, vec4(gamma));
-    gl_FragColor = color;
+    if (showHeatmap == 1) {
+        // integer textures cannot be filtered, so the nearest texel is fetched
+        ivec2 size = textureSize(heatmapTexture, 0);
+        ivec2 texel = min(ivec2(uv * vec2(size)), size - 1);
+        uint cost = texelFetch(heatmapTexture, texel, 0).r;
+        gl_FragColor = vec4(heatmapColor(float(cost) * heatmapScale), 1.0);
+        return;
+    }
+
+    // alpha of the raytraced image holds the sample count
+    vec3 color = texture(texture0, uv).rgb;
+    color = pow(color, vec3(gamma));
+    gl_FragColor = vec4(color, 1.0);
 }
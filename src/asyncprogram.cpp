@@ -0,0 +1,80 @@
+#include "src/asyncprogram.h"
+#include "src/glext.h"
+#include "src/logger.h"
+#include <raylib/rlgl.h>
+#include <string.h>
+
+
+// driver logs span many lines, logged one by one so they survive the logger's string limit
+static void logInfoLog(char* log) {
+    for (char* line = strtok(log, "\n"); line != nullptr; line = strtok(nullptr, "\n")) {
+        INFO("    %s", line);
+    }
+}
+
+
+AsyncProgram::AsyncProgram(const char* source) {
+    m_shader = glext::createShader(glext::COMPUTE_SHADER);
+    glext::shaderSource(m_shader, source);
+    glext::compileShader(m_shader);
+
+    // linking is queued right away, its status covers the compile as well
+    m_program = glext::createProgram();
+    glext::attachShader(m_program, m_shader);
+    glext::linkProgram(m_program);
+    TRACE("Started compiling compute program [ID: %u]", m_program);
+}
+
+
+AsyncProgram::AsyncProgram(uint32_t program)
+    : m_program(program), m_linked(true) {}
+
+
+AsyncProgram::~AsyncProgram() {
+    if (m_shader != 0) {
+        glext::deleteShader(m_shader);
+    }
+    if (m_program != 0) {
+        rlUnloadShaderProgram(m_program);
+    }
+}
+
+
+bool AsyncProgram::isReady() const {
+    if (m_linked || m_program == 0 || !glext::hasParallelShaderCompile()) {
+        return true;
+    }
+    return glext::getProgramInteger(m_program, glext::COMPLETION_STATUS) != 0;
+}
+
+
+uint32_t AsyncProgram::take() {
+    uint32_t program = m_program;
+    m_program = 0;
+
+    if (m_linked || program == 0) {
+        return program;
+    }
+
+    char log[2048];
+    if (!glext::getShaderInteger(m_shader, glext::COMPILE_STATUS)) {
+        glext::getShaderInfoLog(m_shader, sizeof(log), log);
+        INFO("Failed to compile compute shader [ID: %u]:", m_shader);
+        logInfoLog(log);
+    } else if (!glext::getProgramInteger(program, glext::LINK_STATUS)) {
+        glext::getProgramInfoLog(program, sizeof(log), log);
+        INFO("Failed to link compute program [ID: %u]:", program);
+        logInfoLog(log);
+    } else {
+        glext::detachShader(program, m_shader);
+        glext::deleteShader(m_shader);
+        m_shader = 0;
+        TRACE("Compute program ready [ID: %u]", program);
+        return program;
+    }
+
+    glext::deleteShader(m_shader);
+    m_shader = 0;
+    rlUnloadShaderProgram(program);
+    return 0;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+
+// a compute program compiled and linked without waiting for the driver
+// with GL_KHR_parallel_shader_compile the work runs on driver threads and isReady() can be polled every frame,
+// otherwise the driver finishes it on the first status query
+
+
+class AsyncProgram {
+
+public:
+    // starts compiling and linking the source
+    explicit AsyncProgram(const char* source);
+    // wraps an already linked program (e.g. one loaded from the binary cache)
+    explicit AsyncProgram(uint32_t program);
+    ~AsyncProgram();
+    AsyncProgram(const AsyncProgram&) = delete;
+    AsyncProgram& operator=(const AsyncProgram&) = delete;
+    bool isReady() const;
+    // waits if needed, returns 0 (after logging the errors) when compiling or linking failed
+    // the caller owns the returned program
+    uint32_t take();
+
+private:
+    uint32_t m_shader = 0;
+    uint32_t m_program = 0;
+    bool m_linked = false;
+};
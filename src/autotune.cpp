@@ -0,0 +1,187 @@
+#include "src/autotune.h"
+#include "src/glext.h"
+#include "src/hash.h"
+#include "src/logger.h"
+#include "src/profiler.h"
+#include <chrono>
+#include <filesystem>
+#include <stdio.h>
+#include <string.h>
+
+
+// every candidate renders at least minFrames, then until timedSeconds have passed
+static const double timedSeconds = 0.25;
+static const int minFrames = 4;
+static const int maxFrames = 256;
+
+
+// runs frames of a raytracer of its own, the dispatch is private to the raytracer's friends
+class WorkgroupTimer {
+
+public:
+    // seconds per frame, 0 when the candidate could not render
+    static double timeCandidate(const ComputeShaderParams& params, Vector2 size, const rt::CompiledScene& scene, const rt::Camera& camera, const rt::Config& config) {
+        Raytracer raytracer(size, params);
+        raytracer.setScene(scene);
+        raytracer.setCamera(camera);
+        raytracer.setConfig(config);
+
+        // the first frame waits for the program to build, neither is timed
+        for (int i = 0; i < 2; i++) {
+            if (!raytracer.runComputeShader()) {
+                return 0.0;
+            }
+        }
+        glext::finish();
+
+        const auto start = std::chrono::steady_clock::now();
+        int frames = 0;
+        double seconds = 0.0;
+        while (frames < maxFrames && (frames < minFrames || seconds < timedSeconds)) {
+            raytracer.runComputeShader();
+            // waited for every frame, otherwise only the submission is measured
+            glext::finish();
+            frames++;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return seconds / frames;
+    }
+};
+
+
+namespace autotune {
+
+
+struct Shape {
+    uint32_t width;
+    uint32_t height;
+};
+
+
+// one line per device: <key> <width> <height> <renderer>
+static const char* cacheFile = "cache/workgroup.txt";
+
+// 32 to 256 invocations, wide shapes follow the rows of the image and tall ones its columns
+static const Shape candidates[] = {
+    {8, 4}, {4, 8}, {8, 8}, {16, 4}, {32, 2}, {16, 8}, {8, 16}, {32, 4}, {16, 16}, {32, 8},
+};
+
+static uint64_t getDeviceKey() {
+    uint64_t hash = hashSeed;
+    for (uint32_t name : {glext::VENDOR, glext::RENDERER, glext::VERSION}) {
+        const char* str = glext::getString(name);
+        hash = hashBytes(str, strlen(str) + 1, hash);
+    }
+    return hash;
+}
+
+
+static bool findCached(uint64_t key, Shape& shape) {
+    FILE* file = fopen(cacheFile, "r");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char line[512];
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file)) {
+        unsigned long long lineKey = 0;
+        Shape lineShape = {};
+        if (sscanf(line, "%llx %u %u", &lineKey, &lineShape.width, &lineShape.height) == 3 && lineKey == key) {
+            found = lineShape.width > 0 && lineShape.height > 0;
+            shape = lineShape;
+        }
+    }
+
+    fclose(file);
+    return found;
+}
+
+
+static void storeCached(uint64_t key, Shape shape) {
+    // lines of other devices are kept
+    std::vector<std::string> lines;
+    if (FILE* file = fopen(cacheFile, "r")) {
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            unsigned long long lineKey = 0;
+            if (sscanf(line, "%llx", &lineKey) == 1 && lineKey != key) {
+                lines.push_back(line);
+            }
+        }
+        fclose(file);
+    }
+    lines.push_back(TextFormat("%016llx %u %u %s\n", (unsigned long long) key, shape.width, shape.height, glext::getString(glext::RENDERER)));
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cacheFile).parent_path(), error);
+
+    FILE* file = fopen(cacheFile, "w");
+    if (file == nullptr) {
+        INFO("Failed to write the workgroup cache '%s'", cacheFile);
+        return;
+    }
+    for (const std::string& line : lines) {
+        fputs(line.c_str(), file);
+    }
+    fclose(file);
+}
+
+
+bool applyCached(ComputeShaderParams& params) {
+    Shape shape;
+    if (!findCached(getDeviceKey(), shape)) {
+        TRACE("No tuned workgroup shape for this device in '%s'", cacheFile);
+        return false;
+    }
+
+    INFO("Using the tuned workgroup shape %u x %u", shape.width, shape.height);
+    params.workgroupWidth = shape.width;
+    params.workgroupHeight = shape.height;
+    return true;
+}
+
+
+bool run(ComputeShaderParams& params, Vector2 size, const rt::CompiledScene& scene, const rt::Camera& camera, const rt::Config& config) {
+    PROFILE_FUNCTION();
+    INFO("Tuning the workgroup shape at %d x %d:", (int) size.x, (int) size.y);
+
+    Shape best = {};
+    double bestTime = 0.0;
+    for (const Shape& shape : candidates) {
+        ComputeShaderParams candidate = params;
+        candidate.workgroupWidth = shape.width;
+        candidate.workgroupHeight = shape.height;
+
+        const double frameTime = WorkgroupTimer::timeCandidate(candidate, size, scene, camera, config);
+        if (frameTime == 0.0) {
+            INFO("    %u x %u: failed to render", shape.width, shape.height);
+            continue;
+        }
+
+        INFO("    %u x %u: %.3f ms per frame", shape.width, shape.height, frameTime * 1000.0);
+        if (bestTime == 0.0 || frameTime < bestTime) {
+            best = shape;
+            bestTime = frameTime;
+        }
+    }
+
+    if (bestTime == 0.0) {
+        INFO("No workgroup shape could render, keeping %u x %u", params.workgroupWidth, params.workgroupHeight);
+        return false;
+    }
+
+    INFO("Fastest workgroup shape is %u x %u, cached in '%s'", best.width, best.height, cacheFile);
+    storeCached(getDeviceKey(), best);
+    params.workgroupWidth = best.width;
+    params.workgroupHeight = best.height;
+    return true;
+}
+
+
+double timeFrames(const ComputeShaderParams& params, Vector2 size, const rt::CompiledScene& scene, const rt::Camera& camera, const rt::Config& config) {
+    return WorkgroupTimer::timeCandidate(params, size, scene, camera, config);
+}
+
+
+} // namespace autotune
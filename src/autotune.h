@@ -0,0 +1,22 @@
+#pragma once
+
+#include "src/raytracer.h"
+
+
+// picks the raytracing shader's workgroup shape by timing candidates on this device
+// the fastest one is cached per device (vendor, renderer and driver version), so later runs skip the timing
+
+
+namespace autotune {
+
+
+// sets the shape cached for this device, false when it has not been tuned yet
+bool applyCached(ComputeShaderParams& params);
+// renders the scene at the given size with every candidate shape, then caches the fastest and sets it
+// returns false when no candidate could render, params are unchanged then
+bool run(ComputeShaderParams& params, Vector2 size, const rt::CompiledScene& scene, const rt::Camera& camera, const rt::Config& config);
+// seconds per frame of a raytracer of its own with these params, 0 when it could not render
+double timeFrames(const ComputeShaderParams& params, Vector2 size, const rt::CompiledScene& scene, const rt::Camera& camera, const rt::Config& config);
+
+
+} // namespace autotune
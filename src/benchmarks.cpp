@@ -0,0 +1,447 @@
+#include "src/benchmarks.h"
+#include "src/autotune.h"
+#include "src/camera.h"
+#include "src/capi.h"
+#include "src/headless.h"
+#include "src/logger.h"
+#include "src/scenefile.h"
+#include "src/structs/objects.h"
+#include <chrono>
+#include <filesystem>
+#include <math.h>
+#include <random>
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+
+namespace benchmarks {
+
+
+#ifdef _WIN32
+static const char* nullDevice = "NUL";
+#else
+static const char* nullDevice = "/dev/null";
+#endif
+
+
+template <typename Fn>
+static double nanosecondsPerCall(int iterations, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn(i);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+
+// what the logger used to do on the calling thread
+static void syncLog(FILE* file, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(file, format, args);
+    va_end(args);
+}
+
+
+bool run(const std::string& name) {
+    if (name == "logger") {
+        logging();
+        return true;
+    }
+    if (name == "scene") {
+        sceneLoading();
+        return true;
+    }
+    if (name == "multiview") {
+        multiView();
+        return true;
+    }
+    if (name == "primitives") {
+        primitiveFormats();
+        return true;
+    }
+    if (name == "variants") {
+        shaderVariants();
+        return true;
+    }
+
+    INFO("Unknown benchmark '%s' (available: logger, scene, multiview, primitives, variants)", name.c_str());
+    return false;
+}
+
+
+void logging() {
+    // bursts smaller than the ring, so the numbers measure the hot path rather than the drop policy
+    const int burstSize = 4096;
+    const int numBursts = 64;
+    const int iterations = burstSize * numBursts;
+
+    FILE* sink = fopen(nullDevice, "w");
+    if (sink == nullptr) {
+        INFO("Failed to open '%s' for the logger benchmark", nullDevice);
+        return;
+    }
+
+    const logger::LogLevel previousLevel = logger::currentLogLevel;
+    logger::setOutput(sink);
+    const uint64_t droppedBefore = logger::getDroppedCount();
+
+    // a TRACE call with --verbose off
+    logger::setLogLevel(logger::LogLevel::INFO);
+    const double filtered = nanosecondsPerCall(iterations, [](int i) {
+        TRACE("Sphere %d: position (%f, %f, %f) radius %f", i, 1.0f, 2.0f, 3.0f, 0.5f);
+    });
+
+    logger::setLogLevel(logger::LogLevel::TRACE);
+    double queued = 0.0;
+    for (int burst = 0; burst < numBursts; burst++) {
+        queued += nanosecondsPerCall(burstSize, [](int i) {
+            TRACE("Sphere %d: position (%f, %f, %f) radius %f", i, 1.0f, 2.0f, 3.0f, 0.5f);
+        });
+        // the consumer drains between bursts, outside the measured time
+        logger::flush();
+    }
+    queued /= numBursts;
+    const uint64_t dropped = logger::getDroppedCount() - droppedBefore;
+
+    const double synchronous = nanosecondsPerCall(iterations, [sink](int i) {
+        syncLog(sink, "LOG [ TRACE ]: Sphere %d: position (%f, %f, %f) radius %f\n", i, 1.0f, 2.0f, 3.0f, 0.5f);
+    });
+
+    logger::setOutput(stdout);
+    logger::setLogLevel(previousLevel);
+    fclose(sink);
+
+    INFO("Logger benchmark (%d calls, output to %s):", iterations, nullDevice);
+    INFO("    filtered by level  : %8.2f ns/call", filtered);
+    INFO("    queued (async)     : %8.2f ns/call (%llu dropped)", queued, (unsigned long long) dropped);
+    INFO("    vfprintf (sync)    : %8.2f ns/call", synchronous);
+    logger::flush();
+}
+
+
+void sceneLoading() {
+    const int numMaterials = 16;
+    const int numSpheres = 900000;
+    const int numTriangles = 100000;
+
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string textFile = (directory / "benchmark.rtscene").string();
+    const std::string binaryFile = (directory / "benchmark.rtsb").string();
+
+    FILE* file = fopen(textFile.c_str(), "w");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for the scene benchmark", textFile.c_str());
+        return;
+    }
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (int i = 0; i < numMaterials; i++) {
+        fprintf(file, "material m%d albedo %.3f %.3f %.3f 0.05 roughness %.2f 0.01\n", i, unit(rng), unit(rng), unit(rng), unit(rng));
+    }
+    for (int i = 0; i < numSpheres; i++) {
+        fprintf(file, "sphere m%d %.4f %.4f %.4f %.4f\n", i % numMaterials, position(rng), position(rng), position(rng), 0.5f + unit(rng));
+    }
+    for (int i = 0; i < numTriangles; i++) {
+        const float x = position(rng), y = position(rng), z = position(rng);
+        fprintf(file, "triangle m%d %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f\n", i % numMaterials, x, y, z, x + unit(rng), y, z, x, y + unit(rng), z);
+    }
+    fclose(file);
+
+    // load() logs the throughput
+    INFO("Scene benchmark (%d spheres, %d triangles):", numSpheres, numTriangles);
+    rt::SceneBuilder scene;
+    scenefile::Description desc;
+    if (scenefile::load(textFile.c_str(), scene) && scenefile::parse(textFile.c_str(), desc) && scenefile::saveBinary(binaryFile.c_str(), desc)) {
+        scenefile::load(binaryFile.c_str(), scene);
+    }
+
+    std::filesystem::remove(textFile);
+    std::filesystem::remove(binaryFile);
+    logger::flush();
+}
+
+
+// seconds per frame of every view, 0 when rendering failed
+// unbatched, the views are rendered one after another by switching the camera, as before multi-view dispatches
+static double renderViews(const char* sceneFile, uint32_t numSpheres, uint32_t numViews, bool batched, int numFrames) {
+    const rt_context_desc desc = {
+        .width = 512,
+        .height = 512,
+        .maxSphereCount = numSpheres,
+        .maxTriangleCount = 1,
+        .viewCount = batched ? numViews : 1,
+        .primitiveFormat = RT_PRIMITIVE_FORMAT_FULL,
+    };
+    rt_context* context = rt_create_context(&desc);
+    if (context == nullptr) {
+        return 0.0;
+    }
+
+    // a ring of cameras looking at the center
+    const auto setCamera = [&](uint32_t view) {
+        const float angle = 2.0f * 3.14159265f * view / numViews;
+        const float position[3] = {12.0f * sinf(angle), 2.0f, 12.0f * cosf(angle)};
+        const float direction[3] = {-position[0], -position[1], -position[2]};
+        rt_set_view_camera(context, batched ? view : 0, position, direction, 60.0f);
+    };
+
+    // read back every frame, so the time includes the gpu work and is the same amount of pixels either way
+    std::vector<unsigned char> pixels;
+    const auto renderFrame = [&]() {
+        if (batched) {
+            return rt_render(context, 1, RT_PIXEL_FORMAT_RGBA8, pixels.data(), pixels.size()) == RT_OK;
+        }
+        for (uint32_t view = 0; view < numViews; view++) {
+            setCamera(view);
+            if (rt_render(context, 1, RT_PIXEL_FORMAT_RGBA8, pixels.data(), pixels.size()) != RT_OK) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    double seconds = 0.0;
+    if (rt_load_scene(context, sceneFile, nullptr) == RT_OK) {
+        pixels.resize(rt_get_image_size(context, RT_PIXEL_FORMAT_RGBA8));
+        for (uint32_t view = 0; batched && view < numViews; view++) {
+            setCamera(view);
+        }
+
+        // the first frame waits for the shader to build
+        if (renderFrame()) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < numFrames; i++) {
+                renderFrame();
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numFrames;
+        }
+    }
+
+    rt_destroy_context(context);
+    return seconds;
+}
+
+
+void multiView() {
+    const int numSpheres = 256;
+    const int numFrames = 32;
+
+    const std::string sceneFile = (std::filesystem::temp_directory_path() / "benchmark-views.rtscene").string();
+    FILE* file = fopen(sceneFile.c_str(), "w");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for the multi-view benchmark", sceneFile.c_str());
+        return;
+    }
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-5.0f, 5.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    fprintf(file, "material m0 albedo 0.8 0.8 0.8 0.05 roughness 0.5 0.01\n");
+    for (int i = 0; i < numSpheres; i++) {
+        fprintf(file, "sphere m0 %.4f %.4f %.4f %.4f\n", position(rng), position(rng), position(rng), 0.2f + 0.3f * unit(rng));
+    }
+    fclose(file);
+
+    INFO("Multi-view benchmark (512 x 512 per view, %d spheres, %d frames):", numSpheres, numFrames);
+    for (uint32_t numViews : {2u, 4u, 8u}) {
+        const double separate = renderViews(sceneFile.c_str(), numSpheres, numViews, false, numFrames);
+        const double batched = renderViews(sceneFile.c_str(), numSpheres, numViews, true, numFrames);
+        INFO(
+            "    %u views: %8.3f ms per frame separately, %8.3f ms batched (%.2fx)", numViews,
+            separate * 1e3, batched * 1e3, batched > 0.0 ? separate / batched : 0.0
+        );
+    }
+
+    std::filesystem::remove(sceneFile);
+    logger::flush();
+}
+
+
+// seconds per frame, 0 when rendering failed
+static double renderFormat(const char* sceneFile, uint32_t numPrimitives, rt_primitive_format format, int numFrames) {
+    const rt_context_desc desc = {
+        .width = 512,
+        .height = 512,
+        .maxSphereCount = numPrimitives,
+        .maxTriangleCount = numPrimitives,
+        .viewCount = 1,
+        .primitiveFormat = format,
+    };
+    rt_context* context = rt_create_context(&desc);
+    if (context == nullptr) {
+        return 0.0;
+    }
+
+    double seconds = 0.0;
+    if (rt_load_scene(context, sceneFile, nullptr) == RT_OK) {
+        const float position[3] = {0.0f, 2.0f, 16.0f};
+        const float direction[3] = {0.0f, -0.1f, -1.0f};
+        rt_set_camera(context, position, direction, 60.0f);
+
+        std::vector<unsigned char> pixels(rt_get_image_size(context, RT_PIXEL_FORMAT_RGBA8));
+        // the first frame waits for the shader to build and uploads the scene
+        if (rt_render(context, 1, RT_PIXEL_FORMAT_RGBA8, pixels.data(), pixels.size()) == RT_OK) {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < numFrames; i++) {
+                rt_render(context, 1, RT_PIXEL_FORMAT_RGBA8, pixels.data(), pixels.size());
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / numFrames;
+        }
+    }
+
+    rt_destroy_context(context);
+    return seconds;
+}
+
+
+void primitiveFormats() {
+    const int numPrimitives = 1024;
+    const int numFrames = 16;
+
+    const std::string sceneFile = (std::filesystem::temp_directory_path() / "benchmark-primitives.rtscene").string();
+    FILE* file = fopen(sceneFile.c_str(), "w");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for the primitive benchmark", sceneFile.c_str());
+        return;
+    }
+
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-8.0f, 8.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    fprintf(file, "material m0 albedo 0.8 0.8 0.8 0.05 roughness 0.5 0.01\n");
+    fprintf(file, "material m1 albedo 0.3 0.5 0.8 0.05 roughness 0.1 0.01\n");
+    for (int i = 0; i < numPrimitives; i++) {
+        fprintf(file, "sphere m%d %.4f %.4f %.4f %.4f\n", i % 2, position(rng), position(rng), position(rng), 0.1f + 0.2f * unit(rng));
+    }
+    for (int i = 0; i < numPrimitives; i++) {
+        const float x = position(rng), y = position(rng), z = position(rng);
+        fprintf(file, "triangle m%d %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f %.4f\n", i % 2, x, y, z, x + unit(rng), y, z, x, y + unit(rng), z);
+    }
+    fclose(file);
+
+    struct Format {
+        rt_primitive_format format;
+        const char* name;
+        // sphere and triangle, as read by the intersection tests
+        size_t sphereBytes;
+        size_t triangleBytes;
+    };
+    const Format formats[] = {
+        {RT_PRIMITIVE_FORMAT_FULL, "full", sizeof(rt::internal::Sphere), sizeof(rt::internal::Triangle)},
+        {RT_PRIMITIVE_FORMAT_COMPACT, "compact", sizeof(rt::internal::CompactSphere), sizeof(rt::internal::CompactTriangle)},
+        {RT_PRIMITIVE_FORMAT_QUANTIZED, "quantized", sizeof(rt::internal::QuantizedSphere), sizeof(rt::internal::QuantizedTriangle)},
+    };
+
+    INFO("Primitive format benchmark (512 x 512, %d spheres, %d triangles, %d frames):", numPrimitives, numPrimitives, numFrames);
+    double fullTime = 0.0;
+    for (const Format& format : formats) {
+        const double seconds = renderFormat(sceneFile.c_str(), numPrimitives, format.format, numFrames);
+        if (format.format == RT_PRIMITIVE_FORMAT_FULL) {
+            fullTime = seconds;
+        }
+        if (seconds == 0.0) {
+            INFO("    %-9s: failed to render", format.name);
+            continue;
+        }
+        INFO(
+            "    %-9s: %8.3f ms per frame, %2zu bytes per sphere, %2zu per triangle (%.2fx)", format.name,
+            seconds * 1e3, format.sphereBytes, format.triangleBytes, fullTime > 0.0 ? fullTime / seconds : 0.0
+        );
+    }
+
+    std::filesystem::remove(sceneFile);
+    logger::flush();
+}
+
+
+
+// spheres and/or triangles scattered in front of the camera, materials vary over their surface unless constant
+static std::unique_ptr<rt::CompiledScene> createVariantScene(int numSpheres, int numTriangles, bool constantMaterials) {
+    std::mt19937 rng(0);
+    std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    rt::SceneBuilder builder;
+    rt::MaterialHandle materials[4];
+    for (rt::MaterialHandle& handle : materials) {
+        auto material = std::make_shared<rt::Material>();
+        material->setAlbedo({.value = {unit(rng), unit(rng), unit(rng)}, .deviation = constantMaterials ? 0.0f : 0.05f});
+        material->setRoughness({.value = unit(rng), .deviation = constantMaterials ? 0.0f : 0.01f});
+        handle = builder.addMaterial(material);
+    }
+
+    for (int i = 0; i < numSpheres; i++) {
+        builder.addSphere({position(rng), position(rng), position(rng)}, 0.2f + 0.3f * unit(rng), materials[i % 4]);
+    }
+    for (int i = 0; i < numTriangles; i++) {
+        const Vector3 v0 = {position(rng), position(rng), position(rng)};
+        builder.addTriangle(v0, {v0.x + unit(rng), v0.y, v0.z}, {v0.x, v0.y + unit(rng), v0.z}, materials[i % 4]);
+    }
+    return std::make_unique<rt::CompiledScene>(std::move(builder));
+}
+
+
+void shaderVariants() {
+    const Vector2 size = {512, 512};
+    if (!headless::createContext()) {
+        return;
+    }
+
+    {
+        struct VariantScene {
+            const char* name;
+            std::unique_ptr<rt::CompiledScene> scene;
+        };
+        VariantScene scenes[] = {
+            {"spheres", createVariantScene(256, 0, false)},
+            {"spheres, constant materials", createVariantScene(256, 0, true)},
+            {"triangles", createVariantScene(0, 256, false)},
+            {"spheres and triangles", createVariantScene(128, 128, false)},
+        };
+        const rt::Config configs[] = {
+            {.numSamples = 1, .bounceLimit = 5},
+            {.numSamples = 4, .bounceLimit = 5},
+        };
+
+        ComputeShaderParams params = {
+            .workgroupWidth = 8,
+            .workgroupHeight = 8,
+            .storageType = SceneStorageType::SSBO,
+            .maxSphereCount = 256,
+            .maxTriangleCount = 256,
+            .writeAOVs = false,
+            .maxHistoryLength = 0,
+            .specializeVariants = false,
+        };
+        autotune::applyCached(params);
+        const SceneCamera camera({0, 0, 10}, {0, 0, -1}, 60.0f, size, {});
+
+        INFO("Shader variant benchmark (%d x %d):", (int) size.x, (int) size.y);
+        for (const VariantScene& variantScene : scenes) {
+            for (const rt::Config& config : configs) {
+                ComputeShaderParams specialized = params;
+                specialized.specializeVariants = true;
+                const double generic = autotune::timeFrames(params, size, *variantScene.scene, camera.get(), config);
+                const double special = autotune::timeFrames(specialized, size, *variantScene.scene, camera.get(), config);
+                INFO(
+                    "    %-28s %2d spp: %8.3f ms generic, %8.3f ms specialized (%.2fx)", variantScene.name, (int) config.numSamples,
+                    generic * 1e3, special * 1e3, special > 0.0 ? generic / special : 0.0
+                );
+            }
+        }
+    }
+
+    // the scenes release their material cells before the registry goes
+    headless::destroyContext();
+    logger::flush();
+}
+
+} // namespace benchmarks
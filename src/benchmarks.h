@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+
+// headless micro-benchmarks, run with `--benchmark <name>` before any window is created
+namespace benchmarks {
+
+
+// returns false when no benchmark has this name
+bool run(const std::string& name);
+
+// cost per call of filtered, queued and synchronous (vfprintf) logging
+void logging();
+// text and binary scene file throughput on a generated file with a million objects
+void sceneLoading();
+// frame time of a camera rig rendered with one dispatch per view and with a single multi-view dispatch
+void multiView();
+// frame time of a sphere and triangle scene stored in the full, compact and quantized primitive formats
+void primitiveFormats();
+// frame time of the generic shader and of the variant specialized to each scene and config
+void shaderVariants();
+
+
+} // namespace benchmarks
@@ -0,0 +1,190 @@
+#include "src/blockcompress.h"
+#include <algorithm>
+#include <stdlib.h>
+
+
+namespace blockcompress {
+
+
+// gathers a 4x4 block, edge pixels are repeated when the image is not a multiple of 4
+template <int Channels>
+static void loadBlock(const uint8_t* pixels, int width, int height, int blockX, int blockY, uint8_t block[16][Channels]) {
+    for (int y = 0; y < 4; y++) {
+        for (int x = 0; x < 4; x++) {
+            const int px = std::min(blockX * 4 + x, width - 1);
+            const int py = std::min(blockY * 4 + y, height - 1);
+            const uint8_t* pixel = pixels + (py * width + px) * Channels;
+            for (int c = 0; c < Channels; c++) {
+                block[y * 4 + x][c] = pixel[c];
+            }
+        }
+    }
+}
+
+
+static uint16_t toRGB565(const int color[3]) {
+    return ((color[0] >> 3) << 11) | ((color[1] >> 2) << 5) | (color[2] >> 3);
+}
+
+
+static void fromRGB565(uint16_t packed, int color[3]) {
+    const int r = (packed >> 11) & 31;
+    const int g = (packed >> 5) & 63;
+    const int b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+
+static void encodeBlockBC1(const uint8_t block[16][3], uint8_t* out) {
+    int minColor[3] = {255, 255, 255};
+    int maxColor[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = std::min(minColor[c], (int) block[i][c]);
+            maxColor[c] = std::max(maxColor[c], (int) block[i][c]);
+        }
+    }
+
+    // insetting the box by 1/16 lowers the error of the interpolated colors
+    for (int c = 0; c < 3; c++) {
+        const int inset = (maxColor[c] - minColor[c]) >> 4;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    // picks the box diagonal along the colors' main direction, green and blue follow red's correlation
+    int center[3];
+    for (int c = 0; c < 3; c++) {
+        center[c] = (minColor[c] + maxColor[c]) / 2;
+    }
+    int covariance[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        const int r = block[i][0] - center[0];
+        covariance[1] += r * (block[i][1] - center[1]);
+        covariance[2] += r * (block[i][2] - center[2]);
+    }
+    for (int c = 1; c < 3; c++) {
+        if (covariance[c] < 0) {
+            std::swap(minColor[c], maxColor[c]);
+        }
+    }
+
+    uint16_t color0 = toRGB565(maxColor);
+    uint16_t color1 = toRGB565(minColor);
+    // color0 > color1 selects the 4 color mode
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    int palette[4][3];
+    fromRGB565(color0, palette[0]);
+    fromRGB565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestError = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int error = 0;
+                for (int c = 0; c < 3; c++) {
+                    const int diff = block[i][c] - palette[p][c];
+                    error += diff * diff;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    best = p;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    // little endian
+    out[0] = color0 & 0xFF;
+    out[1] = color0 >> 8;
+    out[2] = color1 & 0xFF;
+    out[3] = color1 >> 8;
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+
+static void encodeBlockBC4(const uint8_t block[16][1], uint8_t* out) {
+    int minValue = 255;
+    int maxValue = 0;
+    for (int i = 0; i < 16; i++) {
+        minValue = std::min(minValue, (int) block[i][0]);
+        maxValue = std::max(maxValue, (int) block[i][0]);
+    }
+
+    // red0 > red1 selects the 8 value mode
+    int palette[8] = {maxValue, minValue};
+    for (int p = 1; p < 7; p++) {
+        palette[p + 1] = ((7 - p) * maxValue + p * minValue) / 7;
+    }
+
+    uint64_t indices = 0;
+    if (maxValue != minValue) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(block[i][0] - palette[p]) < std::abs(block[i][0] - palette[best])) {
+                    best = p;
+                }
+            }
+            indices |= (uint64_t) best << (i * 3);
+        }
+    }
+
+    out[0] = maxValue;
+    out[1] = minValue;
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = (indices >> (i * 8)) & 0xFF;
+    }
+}
+
+
+int getLevelSize(int width, int height) {
+    return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+}
+
+
+void encodeBC1(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& out) {
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    out.resize(getLevelSize(width, height));
+
+    uint8_t block[16][3];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            loadBlock<3>(rgb, width, height, bx, by, block);
+            encodeBlockBC1(block, &out[(by * blocksX + bx) * 8]);
+        }
+    }
+}
+
+
+void encodeBC4(const uint8_t* red, int width, int height, std::vector<uint8_t>& out) {
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    out.resize(getLevelSize(width, height));
+
+    uint8_t block[16][1];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            loadBlock<1>(red, width, height, bx, by, block);
+            encodeBlockBC4(block, &out[(by * blocksX + bx) * 8]);
+        }
+    }
+}
+
+
+} // namespace blockcompress
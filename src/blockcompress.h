@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+
+// cpu encoders for the BC1 (rgb) and BC4 (single channel) block formats
+// each 4x4 block is fitted with its bounding endpoints, quality is meant for material textures not final art
+
+
+namespace blockcompress {
+
+
+// bytes of one level, 8 per 4x4 block for both formats
+int getLevelSize(int width, int height);
+// rgb is tightly packed 8 bit rgb
+void encodeBC1(const uint8_t* rgb, int width, int height, std::vector<uint8_t>& out);
+// red is tightly packed 8 bit single channel
+void encodeBC4(const uint8_t* red, int width, int height, std::vector<uint8_t>& out);
+
+
+} // namespace blockcompress
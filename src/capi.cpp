@@ -0,0 +1,286 @@
+#include "src/capi.h"
+#include "src/autotune.h"
+#include "src/camera.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
+#include "src/headless.h"
+#include "src/logger.h"
+#include "src/raytracer.h"
+#include "src/scenefile.h"
+#include <memory>
+#include <vector>
+
+
+// limits used when the description leaves them at 0
+static const uint32_t defaultMaxSphereCount = 1024;
+static const uint32_t defaultMaxTriangleCount = 1024;
+
+// raylib has a single window, so there can only be one context
+static bool contextExists = false;
+
+
+struct rt_context {
+    Vector2 size;
+    uint32_t numViews;
+    // one per view
+    std::vector<rt::Camera> cameras;
+    ComputeShaderParams params;
+    rt::Config config;
+    std::unique_ptr<Raytracer> raytracer;
+    std::vector<std::unique_ptr<rt::CompiledScene>> scenes;
+    bool hasScene = false;
+    // handed to frame callbacks, reused across frames
+    std::vector<unsigned char> frame;
+
+    // returns false when no program could be built
+    bool renderFrame();
+    void readImage(rt_pixel_format format, void* pixels) const;
+    void setCamera(uint32_t view, Vector3 position, Vector3 direction, float fov);
+};
+
+
+static size_t getPixelSize(rt_pixel_format format) {
+    return format == RT_PIXEL_FORMAT_RGBA8 ? 4 : 4 * sizeof(float);
+}
+
+
+bool rt_context::renderFrame() {
+    gputimer::update();
+
+    // nothing is dispatched while the variant for a new scene or config compiles, so this waits for it
+    const int frameIndex = raytracer->getFrameIndex();
+    while (raytracer->getFrameIndex() == frameIndex) {
+        raytracer->runComputeShader();
+        if (raytracer->m_computeShaderProgram == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void rt_context::readImage(rt_pixel_format format, void* pixels) const {
+    raytracer->readPixels(format == RT_PIXEL_FORMAT_RGBA8 ? glext::UNSIGNED_BYTE : glext::FLOAT, pixels);
+}
+
+
+void rt_context::setCamera(uint32_t view, Vector3 position, Vector3 direction, float fov) {
+    const SceneCamera camera(position, direction, fov, size, SceneCameraParams{});
+    cameras[view] = camera.get();
+    raytracer->setCameras(cameras);
+    raytracer->reset();
+}
+
+
+rt_context* rt_create_context(const rt_context_desc* desc) {
+    if (desc == nullptr || desc->width == 0 || desc->height == 0) {
+        INFO("Raytracing context needs a non-zero size");
+        return nullptr;
+    }
+    if (desc->primitiveFormat > RT_PRIMITIVE_FORMAT_QUANTIZED) {
+        INFO("Unknown primitive format %d", (int) desc->primitiveFormat);
+        return nullptr;
+    }
+    if (contextExists) {
+        INFO("Only one raytracing context can exist at a time");
+        return nullptr;
+    }
+
+    if (!headless::createContext()) {
+        return nullptr;
+    }
+    contextExists = true;
+
+    rt_context* context = new rt_context;
+    context->size = {(float) desc->width, (float) desc->height};
+    context->numViews = desc->viewCount ? desc->viewCount : 1;
+    context->params = {
+        .workgroupWidth = 8,
+        .workgroupHeight = 8,
+        // scene files can be far larger than the uniform buffers
+        .storageType = SceneStorageType::SSBO,
+        .maxSphereCount = desc->maxSphereCount ? desc->maxSphereCount : defaultMaxSphereCount,
+        .maxTriangleCount = desc->maxTriangleCount ? desc->maxTriangleCount : defaultMaxTriangleCount,
+        // only the denoiser and reprojection use them, and neither runs here
+        .writeAOVs = false,
+        .maxHistoryLength = 0,
+        .specializeVariants = true,
+        .numViews = context->numViews,
+        .primitiveFormat = (PrimitiveFormat) desc->primitiveFormat,
+    };
+    autotune::applyCached(context->params);
+    context->config = {.numSamples = 1, .bounceLimit = 5};
+
+    context->raytracer = std::make_unique<Raytracer>(context->size, context->params);
+    context->raytracer->setConfig(context->config);
+    context->cameras.resize(context->numViews);
+    for (uint32_t view = 0; view < context->numViews; view++) {
+        context->setCamera(view, {0, 0, 6}, {0, 0, -1}, 60.0f);
+    }
+
+    INFO("Created raytracing context of size = %u x %u with %u views", desc->width, desc->height, context->numViews);
+    return context;
+}
+
+
+void rt_destroy_context(rt_context* context) {
+    if (context == nullptr) {
+        return;
+    }
+
+    // scenes release their material cells before the registry goes
+    context->raytracer.reset();
+    context->scenes.clear();
+    delete context;
+
+    headless::destroyContext();
+    contextExists = false;
+    INFO("Destroyed raytracing context");
+}
+
+
+rt_result rt_load_scene(rt_context* context, const char* fileName, uint32_t* sceneId) {
+    if (context == nullptr || fileName == nullptr) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+
+    rt::SceneBuilder scene;
+    if (!scenefile::load(fileName, scene)) {
+        return RT_ERROR_LOAD_FAILED;
+    }
+
+    // the scene buffers are sized once, when the context is created
+    if (scene.getSphereCount() > context->params.maxSphereCount || scene.getTriangleCount() > context->params.maxTriangleCount) {
+        INFO(
+            "Scene '%s' has %u spheres and %u triangles, the context was created for %u and %u", fileName,
+            (unsigned) scene.getSphereCount(), (unsigned) scene.getTriangleCount(), context->params.maxSphereCount, context->params.maxTriangleCount
+        );
+        return RT_ERROR_SCENE_TOO_LARGE;
+    }
+
+    auto compiled = std::make_unique<rt::CompiledScene>(std::move(scene));
+    if (!compiled->hasAllMaterials()) {
+        INFO("Scene '%s' has more materials than fit in the material atlas", fileName);
+        return RT_ERROR_SCENE_TOO_LARGE;
+    }
+    context->scenes.push_back(std::move(compiled));
+    const uint32_t id = context->scenes.size() - 1;
+    if (sceneId) {
+        *sceneId = id;
+    }
+
+    if (!context->hasScene) {
+        rt_set_scene(context, id);
+        // the builder keeps its cameras when compiled
+        if (!scene.getCameras().empty()) {
+            const rt::CameraPose& pose = scene.getCameras()[0];
+            context->setCamera(0, pose.position, pose.direction, pose.fov);
+        }
+    }
+    return RT_OK;
+}
+
+
+rt_result rt_set_scene(rt_context* context, uint32_t sceneId) {
+    if (context == nullptr || sceneId >= context->scenes.size()) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+
+    context->raytracer->setScene(*context->scenes[sceneId]);
+    context->raytracer->reset();
+    context->hasScene = true;
+    return RT_OK;
+}
+
+
+rt_result rt_set_camera(rt_context* context, const float position[3], const float direction[3], float fov) {
+    return rt_set_view_camera(context, 0, position, direction, fov);
+}
+
+
+rt_result rt_set_view_camera(rt_context* context, uint32_t view, const float position[3], const float direction[3], float fov) {
+    if (context == nullptr || view >= context->numViews || position == nullptr || direction == nullptr || fov <= 0.0f || fov >= 180.0f) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+
+    context->setCamera(view, {position[0], position[1], position[2]}, {direction[0], direction[1], direction[2]}, fov);
+    return RT_OK;
+}
+
+
+rt_result rt_set_config(rt_context* context, uint32_t numSamples, uint32_t bounceLimit) {
+    if (context == nullptr || numSamples == 0 || bounceLimit == 0) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+
+    context->config = {.numSamples = (float) numSamples, .bounceLimit = (float) bounceLimit};
+    context->raytracer->setConfig(context->config);
+    context->raytracer->reset();
+    return RT_OK;
+}
+
+
+size_t rt_get_image_size(const rt_context* context, rt_pixel_format format) {
+    if (context == nullptr) {
+        return 0;
+    }
+    return (size_t) context->size.x * context->size.y * context->numViews * getPixelSize(format);
+}
+
+
+rt_result rt_render(rt_context* context, uint32_t numFrames, rt_pixel_format format, void* pixels, size_t size) {
+    if (context == nullptr || pixels == nullptr) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+    if (size < rt_get_image_size(context, format)) {
+        return RT_ERROR_BUFFER_TOO_SMALL;
+    }
+    if (!context->hasScene) {
+        return RT_ERROR_NO_SCENE;
+    }
+
+    for (uint32_t i = 0; i < numFrames; i++) {
+        if (!context->renderFrame()) {
+            return RT_ERROR_SHADER_FAILED;
+        }
+    }
+
+    context->readImage(format, pixels);
+    return RT_OK;
+}
+
+
+rt_result rt_render_frames(rt_context* context, uint32_t numFrames, rt_pixel_format format, rt_frame_callback callback, void* userData) {
+    if (context == nullptr || callback == nullptr) {
+        return RT_ERROR_INVALID_ARGUMENT;
+    }
+    if (!context->hasScene) {
+        return RT_ERROR_NO_SCENE;
+    }
+
+    context->frame.resize(rt_get_image_size(context, format));
+
+    for (uint32_t i = 0; i < numFrames; i++) {
+        if (!context->renderFrame()) {
+            return RT_ERROR_SHADER_FAILED;
+        }
+
+        context->readImage(format, context->frame.data());
+        callback(context->frame.data(), context->size.x, context->size.y, context->raytracer->getFrameIndex(), userData);
+    }
+    return RT_OK;
+}
+
+
+const char* rt_result_string(rt_result result) {
+    switch (result) {
+        case RT_OK: return "ok";
+        case RT_ERROR_INVALID_ARGUMENT: return "invalid argument";
+        case RT_ERROR_LOAD_FAILED: return "scene failed to load";
+        case RT_ERROR_SCENE_TOO_LARGE: return "scene is larger than the context allows";
+        case RT_ERROR_NO_SCENE: return "no scene set";
+        case RT_ERROR_BUFFER_TOO_SMALL: return "buffer too small";
+        case RT_ERROR_SHADER_FAILED: return "compute shader failed to build";
+    }
+    return "unknown";
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// C interface for embedding the raytracer in other programs, link with librealtime-raytracing.a
+// rendering needs an OpenGL 4.3 context, so a context owns a hidden window the caller never sees
+// only one context can exist at a time, and every call must come from the thread that created it
+// shaders are loaded from shaders/ relative to the working directory, as for the application
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+typedef struct rt_context rt_context;
+
+
+typedef enum rt_result {
+    RT_OK = 0,
+    RT_ERROR_INVALID_ARGUMENT,
+    RT_ERROR_LOAD_FAILED,
+    // more objects than the context was created for, or more materials than the material atlas holds
+    RT_ERROR_SCENE_TOO_LARGE,
+    RT_ERROR_NO_SCENE,
+    RT_ERROR_BUFFER_TOO_SMALL,
+    RT_ERROR_SHADER_FAILED,
+} rt_result;
+
+
+// both have the orientation of saved images, alpha is 1
+typedef enum rt_pixel_format {
+    // linear color, 16 bytes per pixel
+    RT_PIXEL_FORMAT_RGBA32F = 0,
+    // linear color clamped to 0 - 255, 4 bytes per pixel
+    RT_PIXEL_FORMAT_RGBA8,
+} rt_pixel_format;
+
+
+// layout of the primitives on the gpu, the smaller ones trade precision for bandwidth
+typedef enum rt_primitive_format {
+    // 32 byte spheres and 80 byte triangles, exact
+    RT_PRIMITIVE_FORMAT_FULL = 0,
+    // 16 byte spheres and 36 byte triangles, half float radii and uvs
+    RT_PRIMITIVE_FORMAT_COMPACT,
+    // 12 byte spheres and 24 byte triangles, positions also snapped to 2^21 steps over the scene bounds
+    RT_PRIMITIVE_FORMAT_QUANTIZED,
+} rt_primitive_format;
+
+
+typedef struct rt_context_desc {
+    uint32_t width;
+    uint32_t height;
+    // limits of every scene loaded into the context, 0 picks a default
+    uint32_t maxSphereCount;
+    uint32_t maxTriangleCount;
+    // views rendered together (stereo pairs, camera rigs), each with its own camera, 0 picks 1
+    uint32_t viewCount;
+    // RT_PRIMITIVE_FORMAT_FULL when zeroed
+    rt_primitive_format primitiveFormat;
+} rt_context_desc;
+
+
+// the pixels belong to the context and are only valid during the call, they hold every view's image one after another
+typedef void (*rt_frame_callback)(const void* pixels, uint32_t width, uint32_t height, uint32_t frameIndex, void* userData);
+
+
+// returns NULL on failure
+rt_context* rt_create_context(const rt_context_desc* desc);
+void rt_destroy_context(rt_context* context);
+
+// text or binary scene file, sceneId receives the handle for rt_set_scene()
+// the first scene loaded is also made current
+rt_result rt_load_scene(rt_context* context, const char* fileName, uint32_t* sceneId);
+// changing the scene, camera or config restarts accumulation
+rt_result rt_set_scene(rt_context* context, uint32_t sceneId);
+// fov in degrees, direction does not need to be normalized
+// sets the first view, which is the only one unless the context was created with several
+rt_result rt_set_camera(rt_context* context, const float position[3], const float direction[3], float fov);
+rt_result rt_set_view_camera(rt_context* context, uint32_t view, const float position[3], const float direction[3], float fov);
+rt_result rt_set_config(rt_context* context, uint32_t numSamples, uint32_t bounceLimit);
+
+// bytes needed for one image of every view
+size_t rt_get_image_size(const rt_context* context, rt_pixel_format format);
+// accumulates numFrames more frames, then reads the image into pixels
+rt_result rt_render(rt_context* context, uint32_t numFrames, rt_pixel_format format, void* pixels, size_t size);
+// accumulates numFrames more frames, handing each one to callback
+rt_result rt_render_frames(rt_context* context, uint32_t numFrames, rt_pixel_format format, rt_frame_callback callback, void* userData);
+
+const char* rt_result_string(rt_result result);
+
+
+#ifdef __cplusplus
+}
+#endif
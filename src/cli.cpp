@@ -21,6 +21,82 @@ CommandLineOptions::CommandLineOptions(int argc, const char* argv[]) {
         .default_value(2.0f)
         .scan<'f', float>();
 
+    parser.add_argument("--frameBudget")
+        .help("Render time budget in milliseconds for dynamic resolution (0 to disable)")
+        .default_value(25.0f)
+        .scan<'f', float>();
+
+    parser.add_argument("--dispatchBudget")
+        .help("Milliseconds of dispatches per displayed frame, as many as fit (0 for one dispatch per frame)")
+        .default_value(0.0f)
+        .scan<'f', float>();
+
+    parser.add_argument("--dispatchTile")
+        .help("Split every frame into dispatches of tiles of this many pixels square (0 for whole frames)")
+        .default_value(0u)
+        .scan<'u', unsigned>();
+
+    parser.add_argument("--memoryBudget")
+        .help("Warn when tracked GPU memory goes over this many megabytes (0 to disable)")
+        .default_value(0.0f)
+        .scan<'f', float>();
+
+    parser.add_argument("--adaptiveSamples")
+        .help("Let dynamic resolution also adjust samples per frame")
+        .default_value(false)
+        .implicit_value(true);
+
+    parser.add_argument("--autotune")
+        .help("Time workgroup shapes on the startup scene and cache the fastest for this device")
+        .default_value(false)
+        .implicit_value(true);
+
+    parser.add_argument("--primitiveFormat")
+        .help("Layout of a --scene's primitives on the GPU: full, compact or quantized (smaller, less precise)")
+        .default_value(std::string("full"));
+
+    parser.add_argument("--trace")
+        .help("Write a chrome trace of the session to this file (needs a -DENABLE_PROFILER build)")
+        .default_value(std::string(""));
+
+    parser.add_argument("--benchmark")
+        .help("Run a headless benchmark and exit (available: logger, scene, multiview, primitives, variants)")
+        .default_value(std::string(""));
+
+    parser.add_argument("--scene")
+        .help("Scene file to render instead of the built-in scenes (text or binary)")
+        .default_value(std::string(""));
+
+    parser.add_argument("--saveScene")
+        .help("Write the --scene file in the binary format and exit")
+        .default_value(std::string(""));
+
+    parser.add_argument("--serve")
+        .help("Run as a headless render server taking jobs on this unix domain socket")
+        .default_value(std::string(""));
+
+    parser.add_argument("--distribute")
+        .help("Render --scene on these comma separated render server sockets, write --output and exit")
+        .default_value(std::string(""));
+
+    parser.add_argument("--output")
+        .help("Image written by --distribute")
+        .default_value(std::string("output.png"));
+
+    parser.add_argument("--frames")
+        .help("Frames accumulated by --distribute")
+        .default_value(64u)
+        .scan<'u', unsigned>();
+
+    parser.add_argument("--tileSize")
+        .help("Tile size of --distribute and --tiledRender, a multiple of 8 (0 renders one tile with --distribute)")
+        .default_value(256u)
+        .scan<'u', unsigned>();
+
+    parser.add_argument("--tiledRender")
+        .help("Render an image of <width>x<height> (any size) tile by tile into the --output ppm and exit")
+        .default_value(std::string(""));
+
     parser.add_argument("--verbose")
         .help("Enable verbose logging")
         .default_value(false)
@@ -37,5 +113,22 @@ CommandLineOptions::CommandLineOptions(int argc, const char* argv[]) {
     windowWidth = parser.get<unsigned>("windowWidth");
     windowHeight = parser.get<unsigned>("windowHeight");
     imageScale = parser.get<float>("scale");
+    frameBudget = parser.get<float>("frameBudget");
+    dispatchBudget = parser.get<float>("dispatchBudget");
+    dispatchTile = parser.get<unsigned>("dispatchTile");
+    memoryBudget = parser.get<float>("memoryBudget");
+    adaptiveSamples = parser.get<bool>("adaptiveSamples");
+    autotune = parser.get<bool>("autotune");
+    primitiveFormat = parser.get<std::string>("primitiveFormat");
     verbose = parser.get<bool>("verbose");
+    traceFile = parser.get<std::string>("trace");
+    benchmark = parser.get<std::string>("benchmark");
+    sceneFile = parser.get<std::string>("scene");
+    saveScene = parser.get<std::string>("saveScene");
+    serve = parser.get<std::string>("serve");
+    distribute = parser.get<std::string>("distribute");
+    output = parser.get<std::string>("output");
+    frames = parser.get<unsigned>("frames");
+    tileSize = parser.get<unsigned>("tileSize");
+    tiledRender = parser.get<std::string>("tiledRender");
 }
@@ -1,12 +1,31 @@
 
 #pragma once
 
+#include <string>
+
 
 struct CommandLineOptions {
     float windowWidth;  // unsigned casted to a float
     float windowHeight; // unsigned casted to a float
     float imageScale;
+    float frameBudget;  // in milliseconds, 0 disables dynamic resolution
+    float dispatchBudget; // in milliseconds, 0 dispatches once per displayed frame
+    unsigned dispatchTile; // of the tiles frames are dispatched in, 0 for whole frames
+    float memoryBudget; // gpu megabytes, 0 disables the warning
+    bool adaptiveSamples;
+    bool autotune;      // tune the workgroup shape at startup
+    std::string primitiveFormat; // full, compact or quantized (scene files only)
     bool verbose;
+    std::string traceFile;  // empty when not tracing
+    std::string benchmark;  // empty when running normally
+    std::string sceneFile;  // empty for the built-in scenes
+    std::string saveScene;  // empty unless converting sceneFile to binary
+    std::string serve;      // socket path of the render server, empty when running normally
+    std::string distribute; // comma separated render server sockets, empty when running normally
+    std::string output;     // image written by a distributed render
+    unsigned frames;        // frames accumulated by a distributed render
+    unsigned tileSize;      // of a distributed or tiled render, 0 for a single tile
+    std::string tiledRender; // <width>x<height> of an image rendered in tiles to --output, empty when running normally
 
     CommandLineOptions(int argc, const char* argv[]);
 };
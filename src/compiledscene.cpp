@@ -1,8 +1,12 @@
 
 #include "src/compiledscene.h"
 #include "src/logger.h"
+#include "src/materialregistry.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
 #include <algorithm>
 #include <map>
+#include <unordered_map>
 
 
 namespace rt {
@@ -11,37 +15,32 @@ namespace rt {
 static unsigned currentId = 0;
 
 
-CompiledScene::CompiledScene(const Scene& scene, Vector2 packedMatTexSize)
+CompiledScene::CompiledScene(const Scene& scene)
     : m_id(++currentId) {
+    PROFILE_SCOPE("CompiledScene::CompiledScene");
     INFO("Compiling scene [ID: %u]", m_id);
-
-    // normalizing background color
-    m_backgroundColor = {
-        scene.backgroundColor.r / 255.0f,
-        scene.backgroundColor.g / 255.0f,
-        scene.backgroundColor.b / 255.0f,
-    };
-    TRACE("    BackgroundColor = (%f %f %f)", m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z);
+    setLighting(scene.backgroundColor, scene.environment, scene.environmentIntensity);
 
     // vec to hold all the unique mats
     std::vector<const Material*> materials;
+    // index of each mat in the vec
+    std::unordered_map<const Material*, int> materialIndices;
     // map to store how many times a material is being used in scene
     std::map<int, int> materialCounter;
 
     // gets the mat's index from the vec
     // if vec doesnt have mat then pushes the mat onto the vec
     auto findMat = [&](const Material* mat) {
-        auto it = std::find(materials.begin(), materials.end(), mat);
-        if (it == materials.end()) {
+        auto [it, inserted] = materialIndices.emplace(mat, (int) materials.size());
+        if (inserted) {
             materials.push_back(mat);
-            int index = materials.size() - 1;
-            materialCounter[index] = 0;
-            return index;
+            materialCounter[it->second] = 0;
         }
-        return (int) (it - materials.begin());
+        return it->second;
     };
 
     // converts and sets the mat index of the spheres
+    m_spheres.reserve(scene.spheres.size());
     for (const Sphere& obj : scene.spheres) {
         internal::Sphere iObj = obj.convert();
         int matIdx = findMat(obj.material.get());
@@ -52,6 +51,7 @@ CompiledScene::CompiledScene(const Scene& scene, Vector2 packedMatTexSize)
     }
 
     // converts and sets the mat index of the triangles
+    m_triangles.reserve(scene.triangles.size());
     for (const Triangle& obj : scene.triangles) {
         internal::Triangle iObj = obj.convert();
         int matIdx = findMat(obj.material.get());
@@ -65,21 +65,159 @@ CompiledScene::CompiledScene(const Scene& scene, Vector2 packedMatTexSize)
         TRACE("    Material[ID: %u] is referenced by %u objects", materials[pair.first]->getId(), pair.second);
     }
 
+    packMaterials(materials);
+}
+
+
+CompiledScene::CompiledScene(SceneBuilder&& builder)
+    : m_id(++currentId) {
+    PROFILE_SCOPE("CompiledScene::CompiledScene");
+    INFO("Compiling scene [ID: %u] from a builder", m_id);
+    setLighting(builder.m_backgroundColor, std::move(builder.m_environment), builder.m_environmentIntensity);
+
+    // handles are unique already, only the referenced ones are packed
+    std::vector<const Material*> materials;
+    std::vector<int> materialIndices(builder.m_materials.size(), -1);
+    uint32_t invalidHandles = 0;
+    auto findMat = [&](MaterialHandle handle) {
+        if (handle >= materialIndices.size()) {
+            invalidHandles++;
+            return -1;
+        }
+        if (materialIndices[handle] < 0) {
+            materialIndices[handle] = materials.size();
+            materials.push_back(builder.m_materials[handle].get());
+        }
+        return materialIndices[handle];
+    };
+
+    // converted straight into the gpu layout, each builder array is freed as soon as it is done
+    const size_t numSpheres = builder.getSphereCount();
+    m_spheres.resize(numSpheres);
+    for (size_t i = 0; i < numSpheres; i++) {
+        internal::Sphere& obj = m_spheres[i];
+        obj.position = builder.m_spherePositions[i];
+        obj.radius = builder.m_sphereRadii[i];
+        obj.materialIndex = findMat(builder.m_sphereMaterials[i]);
+    }
+    builder.m_spherePositions = {};
+    builder.m_sphereRadii = {};
+    builder.m_sphereMaterials = {};
+
+    const size_t numTriangles = builder.getTriangleCount();
+    m_triangles.resize(numTriangles);
+    for (size_t i = 0; i < numTriangles; i++) {
+        const Vector3* vertices = &builder.m_triangleVertices[3 * i];
+        const Vector2* uvs = &builder.m_triangleUVs[3 * i];
+        internal::Triangle& obj = m_triangles[i];
+        obj.v0 = vertices[0];
+        obj.v1 = vertices[1];
+        obj.v2 = vertices[2];
+        obj.uv0 = uvs[0];
+        obj.uv1 = uvs[1];
+        obj.uv2 = uvs[2];
+        obj.materialIndex = findMat(builder.m_triangleMaterials[i]);
+    }
+    builder.m_triangleVertices = {};
+    builder.m_triangleUVs = {};
+    builder.m_triangleMaterials = {};
+
+    if (invalidHandles > 0) {
+        // they would index past the atlas, so they get a material of their own
+        INFO("    %u primitives have material handles not added to the builder, using a default material", invalidHandles);
+        builder.m_materials.push_back(std::make_shared<Material>());
+        const int defaultIndex = materials.size();
+        materials.push_back(builder.m_materials.back().get());
+        for (internal::Sphere& obj : m_spheres) {
+            obj.materialIndex = obj.materialIndex < 0 ? defaultIndex : obj.materialIndex;
+        }
+        for (internal::Triangle& obj : m_triangles) {
+            obj.materialIndex = obj.materialIndex < 0 ? defaultIndex : obj.materialIndex;
+        }
+    }
+
+    packMaterials(materials);
+    // the atlas holds what the scene needs of them now
+    builder.m_materials = {};
+}
+
+
+void CompiledScene::setLighting(Color backgroundColor, std::shared_ptr<EnvironmentMap> environment, float environmentIntensity) {
+    // normalizing background color
+    m_backgroundColor = {
+        backgroundColor.r / 255.0f,
+        backgroundColor.g / 255.0f,
+        backgroundColor.b / 255.0f,
+    };
+    TRACE("    BackgroundColor = (%f %f %f)", m_backgroundColor.x, m_backgroundColor.y, m_backgroundColor.z);
+
+    m_environment = std::move(environment);
+    m_environmentIntensity = environmentIntensity;
+    if (m_environment) {
+        INFO("    Scene is lit by environment map '%s' (intensity %f)", m_environment->getName().c_str(), m_environmentIntensity);
+    }
+}
+
+
+void CompiledScene::packMaterials(const std::vector<const Material*>& materials) {
     INFO("    Scene has %u unique materials", materials.size());
     INFO("    Scene has %u spheres", m_spheres.size());
     INFO("    Scene has %u triangles", m_triangles.size());
 
-    // creating the material data
-    m_materialData = new PackedMaterialData(materials.size(), packedMatTexSize);
+    const std::string owner = TextFormat("scene %u", m_id);
+    memtrack::add(memtrack::Kind::Host, (uint64_t) m_spheres.data(), owner, m_spheres.capacity() * sizeof(internal::Sphere));
+    memtrack::add(memtrack::Kind::Host, (uint64_t) m_triangles.data(), owner, m_triangles.capacity() * sizeof(internal::Triangle));
+
+    // packing the materials, or finding them in the registry
+    PROFILE_SCOPE("CompiledScene::packMaterials");
+    MaterialRegistry& registry = MaterialRegistry::get();
+    const unsigned packCountBefore = registry.getPackCount();
+    for (const Material* mat : materials) {
+        const int cell = registry.acquire(*mat);
+        m_missingMaterials += cell < 0;
+        m_materialCells.push_back(cell);
+    }
+    registry.finishPacking();
+    m_materialData = &registry.getPackedData();
+    INFO("    Packed %u new materials", registry.getPackCount() - packCountBefore);
+    if (m_missingMaterials > 0) {
+        INFO("    %u materials did not fit in the material atlas", m_missingMaterials);
+    }
+
+    const auto getCell = [&](float materialIndex) { return (float) std::max(m_materialCells[(int) materialIndex], 0); };
+    for (internal::Sphere& obj : m_spheres) {
+        obj.materialIndex = getCell(obj.materialIndex);
+    }
+    for (internal::Triangle& obj : m_triangles) {
+        obj.materialIndex = getCell(obj.materialIndex);
+    }
+
     for (int i = 0; i < materials.size(); i++) {
-        m_materialData->setMaterial(i, *materials[i]);
+        Vector4 value;
+        if (m_materialCells[i] < 0 || !materials[i]->getConstantValue(value)) {
+            m_constantMaterials.clear();
+            break;
+        }
+        const int cell = m_materialCells[i];
+        m_constantMaterials.resize(std::max((int) m_constantMaterials.size(), cell + 1));
+        m_constantMaterials[cell] = value;
+    }
+    if (!m_constantMaterials.empty()) {
+        INFO("    Scene materials are constant");
     }
 }
 
 
 CompiledScene::~CompiledScene() {
     TRACE("Unloading scene [ID: %u]", m_id);
-    delete m_materialData;
+    memtrack::remove(memtrack::Kind::Host, (uint64_t) m_spheres.data());
+    memtrack::remove(memtrack::Kind::Host, (uint64_t) m_triangles.data());
+    // the cells stay packed for scenes compiled later
+    for (int cell : m_materialCells) {
+        if (cell >= 0) {
+            MaterialRegistry::get().release(cell);
+        }
+    }
 }
 
 
@@ -1,8 +1,10 @@
 
 #pragma once
 
+#include "src/environmentmap.h"
 #include "src/packedmaterialdata.h"
 #include "src/scene.h"
+#include "src/scenebuilder.h"
 #include "src/structs/objects.h"
 #include <string>
 
@@ -17,16 +19,34 @@ namespace rt {
 class CompiledScene {
 
 public:
-    CompiledScene(const Scene& scene, Vector2 packedMatTexSize);
+    CompiledScene(const Scene& scene);
+    // takes the builder's materials and primitives, freeing each array once it is converted (its cameras stay)
+    CompiledScene(SceneBuilder&& builder);
     ~CompiledScene();
     unsigned getId() const { return m_id; }
+    // false when the material atlas had no room for some of the materials, which then render as the first cell
+    bool hasAllMaterials() const { return m_missingMaterials == 0; }
+
+private:
+    void setLighting(Color backgroundColor, std::shared_ptr<EnvironmentMap> environment, float environmentIntensity);
+    // the primitives' material indices refer to `materials` until this replaces them by atlas cells
+    void packMaterials(const std::vector<const Material*>& materials);
 
 private:
     unsigned m_id;
     Vector3 m_backgroundColor;
+    // null when the background color lights the scene
+    std::shared_ptr<EnvironmentMap> m_environment;
+    float m_environmentIntensity;
     std::vector<internal::Sphere> m_spheres;
     std::vector<internal::Triangle> m_triangles;
-    PackedMaterialData* m_materialData = nullptr;
+    // the registry's atlas, primitives index its cells
+    const PackedMaterialData* m_materialData = nullptr;
+    // registry cells held by the scene, one per unique material (-1 when it did not fit)
+    std::vector<int> m_materialCells;
+    unsigned m_missingMaterials = 0;
+    // albedo and roughness per atlas cell, empty unless every material is constant
+    std::vector<Vector4> m_constantMaterials;
 
     friend class ::Raytracer;
 };
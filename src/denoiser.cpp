@@ -0,0 +1,205 @@
+#include "src/denoiser.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
+#include "src/logger.h"
+#include "src/memtrack.h"
+#include <raylib/rlgl.h>
+#include <cmath>
+
+
+#define getUniLoc(fmt, ...) \
+    rlGetLocationUniform(m_computeShaderProgram, TextFormat(fmt, ##__VA_ARGS__));
+
+
+// 1D kernel of the B3 spline, indexed by distance from the center
+static const float kernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+static const uint32_t workgroupSize = 8;
+
+
+Denoiser::Denoiser(Vector2 textureSize, const DenoiserParams& params)
+    : m_textureSize(textureSize), m_params(params) {
+
+    makeTextures();
+    compileComputeShader();
+}
+
+
+Denoiser::~Denoiser() {
+    rlUnloadShaderProgram(m_computeShaderProgram);
+    TRACE("Unloaded denoiser program [ID: %u]", m_computeShaderProgram);
+
+    unloadTextures();
+}
+
+
+void Denoiser::resize(Vector2 textureSize) {
+    if (textureSize.x == m_textureSize.x && textureSize.y == m_textureSize.y) {
+        return;
+    }
+
+    unloadTextures();
+    m_textureSize = textureSize;
+    makeTextures();
+}
+
+
+void Denoiser::run(const Raytracer& raytracer) {
+    if (!raytracer.m_shaderParams.writeAOVs) {
+        return;
+    }
+
+    GPU_TIMER_SCOPE("denoise");
+
+    static int stepWidth_uniLoc = getUniLoc("stepWidth");
+    static int colorPhi_uniLoc = getUniLoc("colorPhi");
+    static int normalPhi_uniLoc = getUniLoc("normalPhi");
+    static int depthPhi_uniLoc = getUniLoc("depthPhi");
+    static int albedoPhi_uniLoc = getUniLoc("albedoPhi");
+
+    rlEnableShader(m_computeShaderProgram);
+
+    rlSetUniform(normalPhi_uniLoc, &m_params.normalPhi, RL_SHADER_UNIFORM_FLOAT, 1);
+    rlSetUniform(depthPhi_uniLoc, &m_params.depthPhi, RL_SHADER_UNIFORM_FLOAT, 1);
+    rlSetUniform(albedoPhi_uniLoc, &m_params.albedoPhi, RL_SHADER_UNIFORM_FLOAT, 1);
+
+    rlBindImageTexture(raytracer.m_normalDepthTexture.id, 2, raytracer.m_normalDepthTexture.format, true);
+    rlBindImageTexture(raytracer.m_albedoTexture.id, 3, raytracer.m_albedoTexture.format, true);
+
+    const int groupX = (m_textureSize.x + workgroupSize - 1) / workgroupSize;
+    const int groupY = (m_textureSize.y + workgroupSize - 1) / workgroupSize;
+
+    for (int i = 0; i < m_params.iterations; i++) {
+        const Texture& input = i == 0 ? raytracer.m_outTexture : m_pingPongTextures[(i - 1) % 2];
+        const Texture& output = m_pingPongTextures[i % 2];
+
+        // color weight gets stricter as the filter footprint grows
+        const int stepWidth = 1 << i;
+        const float colorPhi = m_params.colorPhi / (float) stepWidth;
+        rlSetUniform(stepWidth_uniLoc, &stepWidth, RL_SHADER_UNIFORM_INT, 1);
+        rlSetUniform(colorPhi_uniLoc, &colorPhi, RL_SHADER_UNIFORM_FLOAT, 1);
+
+        rlBindImageTexture(input.id, 0, input.format, true);
+        rlBindImageTexture(output.id, 1, output.format, false);
+
+        glext::memoryBarrier(glext::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        rlComputeShaderDispatch(groupX, groupY, 1);
+    }
+
+    glext::memoryBarrier(glext::TEXTURE_FETCH_BARRIER_BIT);
+}
+
+
+void Denoiser::denoiseHost(
+    std::vector<Vector4>& color,
+    const std::vector<Vector4>& normalDepth,
+    const std::vector<Vector4>& albedo,
+    int width, int height,
+    const DenoiserParams& params
+) {
+    float startTime = GetTime();
+
+    auto sqDist = [](Vector4 a, Vector4 b) {
+        return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z);
+    };
+
+    std::vector<Vector4> temp(color.size());
+
+    for (int i = 0; i < params.iterations; i++) {
+        const int stepWidth = 1 << i;
+        const float colorPhi = params.colorPhi / (float) stepWidth;
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const int p = y * width + x;
+                Vector4 sum = {0, 0, 0, 0};
+                float weightSum = 0.0f;
+
+                for (int ky = -2; ky <= 2; ky++) {
+                    for (int kx = -2; kx <= 2; kx++) {
+                        const int sx = std::min(std::max(x + kx * stepWidth, 0), width - 1);
+                        const int sy = std::min(std::max(y + ky * stepWidth, 0), height - 1);
+                        const int q = sy * width + sx;
+
+                        const float colorWeight = std::min(std::exp(-sqDist(color[p], color[q]) / colorPhi), 1.0f);
+                        const float normalDist = sqDist(normalDepth[p], normalDepth[q]) / (stepWidth * stepWidth);
+                        const float normalWeight = std::min(std::exp(-normalDist / params.normalPhi), 1.0f);
+                        const float dt = normalDepth[p].w - normalDepth[q].w;
+                        const float depthWeight = std::min(std::exp(-(dt * dt) / params.depthPhi), 1.0f);
+                        const float albedoWeight = std::min(std::exp(-sqDist(albedo[p], albedo[q]) / params.albedoPhi), 1.0f);
+
+                        float weight = colorWeight * normalWeight * depthWeight * albedoWeight;
+                        weight *= kernel[std::abs(kx)] * kernel[std::abs(ky)];
+
+                        sum.x += color[q].x * weight;
+                        sum.y += color[q].y * weight;
+                        sum.z += color[q].z * weight;
+                        weightSum += weight;
+                    }
+                }
+
+                temp[p] = {sum.x / weightSum, sum.y / weightSum, sum.z / weightSum, color[p].w};
+            }
+        }
+
+        color.swap(temp);
+    }
+
+    float stopTime = GetTime();
+    INFO("Denoised %d x %d image on host in %f seconds", width, height, stopTime - startTime);
+}
+
+
+std::vector<Vector4> Denoiser::readTexture(Texture texture) {
+    Image img = LoadImageFromTexture(texture);
+    ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32);
+
+    const Vector4* pixels = (const Vector4*) img.data;
+    std::vector<Vector4> out(pixels, pixels + img.width * img.height);
+    UnloadImage(img);
+
+    return out;
+}
+
+
+void Denoiser::makeTextures() {
+    const int sizeX = m_textureSize.x;
+    const int sizeY = m_textureSize.y;
+    const int format = PIXELFORMAT_UNCOMPRESSED_R16G16B16A16;
+
+    for (Texture& texture : m_pingPongTextures) {
+        texture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+        SetTextureFilter(texture, TEXTURE_FILTER_BILINEAR);
+        memtrack::add(memtrack::Kind::Texture, texture.id, "denoiser", memtrack::getTextureSize(sizeX, sizeY, format, 1));
+    }
+
+    INFO("Created denoiser textures of size = %d x %d [ID: %u %u]", sizeX, sizeY, m_pingPongTextures[0].id, m_pingPongTextures[1].id);
+}
+
+
+void Denoiser::unloadTextures() {
+    UnloadTexture(m_pingPongTextures[0]);
+    UnloadTexture(m_pingPongTextures[1]);
+    memtrack::remove(memtrack::Kind::Texture, m_pingPongTextures[0].id);
+    memtrack::remove(memtrack::Kind::Texture, m_pingPongTextures[1].id);
+    TRACE("Unloaded denoiser textures [ID: %u %u]", m_pingPongTextures[0].id, m_pingPongTextures[1].id);
+}
+
+
+void Denoiser::compileComputeShader() {
+    char* fileContents = LoadFileText("shaders/denoise.glsl");
+
+    const uint64_t cacheKey = shadercache::makeKey(fileContents, {});
+    m_computeShaderProgram = shadercache::loadProgram(cacheKey);
+
+    if (m_computeShaderProgram == 0) {
+        const uint32_t shaderId = rlCompileShader(fileContents, RL_COMPUTE_SHADER);
+        m_computeShaderProgram = rlLoadComputeShaderProgram(shaderId);
+        shadercache::storeProgram(cacheKey, m_computeShaderProgram);
+    }
+
+    if (m_computeShaderProgram != 0) {
+        TRACE("Loaded denoiser program successfully [ID: %u]", m_computeShaderProgram);
+    }
+
+    UnloadFileText(fileContents);
+}
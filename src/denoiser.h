@@ -0,0 +1,53 @@
+#pragma once
+
+#include "src/raytracer.h"
+#include <vector>
+
+
+struct DenoiserParams {
+    // at least 1
+    int iterations = 5;
+    // edge stopping parameters, larger values blur more across edges
+    float colorPhi = 0.5f;
+    float normalPhi = 0.1f;
+    float depthPhi = 0.5f;
+    float albedoPhi = 0.05f;
+};
+
+
+class Denoiser {
+
+public:
+    Denoiser(Vector2 textureSize, const DenoiserParams& params);
+    ~Denoiser();
+    const Vector2& getTextureSize() const { return m_textureSize; }
+    DenoiserParams& getParams() { return m_params; }
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enabled) { m_enabled = enabled; }
+    void resize(Vector2 textureSize);
+    void run(const Raytracer& raytracer);
+    Texture getOutTexture() const { return m_pingPongTextures[(m_params.iterations - 1) % 2]; }
+
+    // same filter on the cpu, all buffers are rgba float and of size width * height
+    static void denoiseHost(
+        std::vector<Vector4>& color,
+        const std::vector<Vector4>& normalDepth,
+        const std::vector<Vector4>& albedo,
+        int width, int height,
+        const DenoiserParams& params
+    );
+    static std::vector<Vector4> readTexture(Texture texture);
+
+private:
+    void makeTextures();
+    void unloadTextures();
+    void compileComputeShader();
+
+private:
+    Vector2 m_textureSize;
+    DenoiserParams m_params;
+    bool m_enabled = true;
+
+    Texture m_pingPongTextures[2];
+    uint32_t m_computeShaderProgram = 0;
+};
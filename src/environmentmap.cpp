@@ -0,0 +1,208 @@
+#include "src/environmentmap.h"
+#include "src/logger.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
+#include "src/threadpool.h"
+#include <raylib/rlgl.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <math.h>
+
+
+namespace rt {
+
+
+struct CachedMap {
+    long modTime;
+    std::weak_ptr<EnvironmentMap> map;
+};
+
+
+// loaded maps by file name, scenes only ever load on the main thread
+static std::map<std::string, CachedMap> loadedMaps;
+
+
+static float luminance(const float* rgb) {
+    // negative and nan pixels are never sampled
+    return std::max(0.0f, 0.2126f * rgb[0] + 0.7152f * rgb[1] + 0.0722f * rgb[2]);
+}
+
+
+// weights need not be normalized, all zero weights are sampled uniformly
+static void buildAliasTable(const float* weights, int count, AliasEntry* table) {
+    double total = 0.0;
+    for (int i = 0; i < count; i++) {
+        total += weights[i];
+    }
+
+    std::vector<double> scaled(count);
+    std::vector<int> small;
+    std::vector<int> large;
+    for (int i = 0; i < count; i++) {
+        const double probability = total > 0.0 ? weights[i] / total : 1.0 / count;
+        table[i].probability = probability;
+        scaled[i] = probability * count;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+
+    // every small entry is topped up by a large one, which shrinks by as much
+    while (!small.empty() && !large.empty()) {
+        const int s = small.back();
+        const int l = large.back();
+        small.pop_back();
+
+        table[s].threshold = scaled[s];
+        table[s].alias = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // what is left is 1 up to rounding
+    for (const std::vector<int>* rest : {&small, &large}) {
+        for (int i : *rest) {
+            table[i].threshold = 1.0f;
+            table[i].alias = i;
+        }
+    }
+}
+
+
+std::shared_ptr<EnvironmentMap> EnvironmentMap::load(const char* fileName) {
+    const long modTime = GetFileModTime(fileName);
+    auto it = loadedMaps.find(fileName);
+    if (it != loadedMaps.end() && it->second.modTime == modTime) {
+        if (std::shared_ptr<EnvironmentMap> map = it->second.map.lock()) {
+            TRACE("Reusing environment map '%s'", fileName);
+            return map;
+        }
+    }
+
+    PROFILE_SCOPE("load environment map");
+    Image image = LoadImage(fileName);
+    if (image.data == nullptr) {
+        INFO("Failed to load environment map '%s'", fileName);
+        return nullptr;
+    }
+    // hdr files load as floats, anything else is taken as linear
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R32G32B32);
+
+    std::shared_ptr<EnvironmentMap> map(new EnvironmentMap(fileName, image));
+    loadedMaps[fileName] = {modTime, map};
+    return map;
+}
+
+
+EnvironmentMap::EnvironmentMap(std::string name, Image image)
+    : m_name(std::move(name)), m_width(image.width), m_height(image.height), m_image(image) {
+
+    memtrack::add(memtrack::Kind::Host, (uint64_t) m_image.data, "environment", memtrack::getTextureSize(m_width, m_height, m_image.format, 1));
+
+    const auto start = std::chrono::steady_clock::now();
+    buildTables();
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    memtrack::add(memtrack::Kind::Host, (uint64_t) m_table.data(), "environment", m_table.size() * sizeof(AliasEntry));
+
+    INFO("Loaded environment map '%s' of size = %d x %d, sampling tables built in %f seconds", m_name.c_str(), m_width, m_height, seconds);
+}
+
+
+EnvironmentMap::~EnvironmentMap() {
+    if (m_uploaded) {
+        UnloadTexture(m_texture);
+        rlUnloadShaderBuffer(m_tableBuffer);
+        memtrack::remove(memtrack::Kind::Texture, m_texture.id);
+        memtrack::remove(memtrack::Kind::Buffer, m_tableBuffer);
+        TRACE("Unloaded environment map '%s' [ID: %u %u]", m_name.c_str(), m_texture.id, m_tableBuffer);
+    } else {
+        memtrack::remove(memtrack::Kind::Host, (uint64_t) m_image.data);
+        memtrack::remove(memtrack::Kind::Host, (uint64_t) m_table.data());
+        UnloadImage(m_image);
+    }
+}
+
+
+Texture EnvironmentMap::getTexture() {
+    if (!m_uploaded) {
+        upload();
+    }
+    return m_texture;
+}
+
+
+uint32_t EnvironmentMap::getTableBuffer() {
+    if (!m_uploaded) {
+        upload();
+    }
+    return m_tableBuffer;
+}
+
+
+void EnvironmentMap::buildTables() {
+    PROFILE_FUNCTION();
+    const int width = m_width;
+    const int height = m_height;
+    const float* pixels = (const float*) m_image.data;
+
+    m_table.resize(height + (size_t) width * height);
+    AliasEntry* rowTables = m_table.data() + height;
+    std::vector<float> rowWeights(height);
+
+    // rows are independent, a few tasks per thread even out rows of different cost
+    ThreadPool& pool = ThreadPool::get();
+    const int rowsPerTask = std::max(1, height / (int) (pool.getThreadCount() * 4));
+    std::vector<std::future<void>> tasks;
+
+    for (int firstRow = 0; firstRow < height; firstRow += rowsPerTask) {
+        const int lastRow = std::min(firstRow + rowsPerTask, height);
+        tasks.push_back(pool.submit([=, &rowWeights]() {
+            std::vector<float> weights(width);
+            for (int y = firstRow; y < lastRow; y++) {
+                const float* row = pixels + (size_t) y * width * 3;
+                double sum = 0.0;
+                for (int x = 0; x < width; x++) {
+                    weights[x] = luminance(row + 3 * x);
+                    sum += weights[x];
+                }
+                buildAliasTable(weights.data(), width, rowTables + (size_t) y * width);
+
+                // rows towards the poles cover less of the sphere
+                const float sinTheta = sinf(PI * (y + 0.5f) / height);
+                rowWeights[y] = sum * sinTheta;
+            }
+        }));
+    }
+
+    for (std::future<void>& task : tasks) {
+        task.get();
+    }
+    buildAliasTable(rowWeights.data(), height, m_table.data());
+}
+
+
+void EnvironmentMap::upload() {
+    PROFILE_SCOPE("upload environment map");
+    m_uploaded = true;
+
+    m_texture = LoadTextureFromImage(m_image);
+    // wraps around horizontally, which is raylib's default
+    SetTextureFilter(m_texture, TEXTURE_FILTER_BILINEAR);
+    memtrack::remove(memtrack::Kind::Host, (uint64_t) m_image.data);
+    memtrack::add(memtrack::Kind::Texture, m_texture.id, "environment", memtrack::getTextureSize(m_width, m_height, m_texture.format, 1));
+    UnloadImage(m_image);
+    m_image = {};
+
+    const uint32_t tableBytes = m_table.size() * sizeof(AliasEntry);
+    m_tableBuffer = rlLoadShaderBuffer(tableBytes, m_table.data(), RL_STATIC_DRAW);
+    memtrack::add(memtrack::Kind::Buffer, m_tableBuffer, "environment", tableBytes);
+    memtrack::remove(memtrack::Kind::Host, (uint64_t) m_table.data());
+    m_table = std::vector<AliasEntry>();
+
+    INFO("Uploaded environment map '%s' and its sampling tables (%f KB) [ID: %u %u]", m_name.c_str(), tableBytes / 1024.0f, m_texture.id, m_tableBuffer);
+}
+
+
+} // namespace rt
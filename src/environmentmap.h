@@ -0,0 +1,60 @@
+#pragma once
+
+#include <raylib/raylib.h>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace rt {
+
+
+// one entry of an alias table (Vose's method), layout matches AliasEntry in the shader
+struct AliasEntry {
+    // a uniform pick landing on this entry keeps it below the threshold, and takes the alias above it
+    float threshold;
+    uint32_t alias;
+    // chance of sampling the entry, normalized within its table
+    float probability;
+};
+
+static_assert(sizeof(AliasEntry) == 12);
+
+
+// equirectangular hdr image lighting a scene, with tables for sampling its directions by luminance
+// the tables are an alias table over the rows followed by one per row over its pixels,
+// the rows are built in parallel on the thread pool
+// loading a file again returns the map already loaded from it, as long as the file is unchanged
+class EnvironmentMap {
+
+public:
+    // returns nullptr when the image fails to load, must not be called from a pool task
+    static std::shared_ptr<EnvironmentMap> load(const char* fileName);
+    ~EnvironmentMap();
+    const std::string& getName() const { return m_name; }
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    // both are uploaded the first time either is used, on the thread owning the GL context
+    Texture getTexture();
+    uint32_t getTableBuffer();
+
+private:
+    EnvironmentMap(std::string name, Image image);
+    void buildTables();
+    void upload();
+
+private:
+    std::string m_name;
+    int m_width;
+    int m_height;
+    // rgb32f pixels, freed by the upload
+    Image m_image;
+    std::vector<AliasEntry> m_table;
+    Texture m_texture = {};
+    uint32_t m_tableBuffer = 0;
+    bool m_uploaded = false;
+};
+
+
+} // namespace rt
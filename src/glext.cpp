@@ -0,0 +1,507 @@
+#include "src/glext.h"
+#include "src/logger.h"
+#include <string.h>
+
+
+// raylib links glfw statically, so its loader is available to us
+typedef void (*GLFWglproc)(void);
+extern "C" GLFWglproc glfwGetProcAddress(const char* procname);
+
+
+#if defined(_WIN32)
+    #define GLEXT_APIENTRY __stdcall
+#else
+    #define GLEXT_APIENTRY
+#endif
+
+
+namespace glext {
+
+
+typedef void (GLEXT_APIENTRY *PFN_glMemoryBarrier)(uint32_t barriers);
+typedef void (GLEXT_APIENTRY *PFN_glFinish)(void);
+typedef void (GLEXT_APIENTRY *PFN_glCopyImageSubData)(
+    uint32_t srcName, uint32_t srcTarget, int srcLevel, int srcX, int srcY, int srcZ,
+    uint32_t dstName, uint32_t dstTarget, int dstLevel, int dstX, int dstY, int dstZ,
+    int srcWidth, int srcHeight, int srcDepth
+);
+typedef void (GLEXT_APIENTRY *PFN_glGenTextures)(int n, uint32_t* textures);
+typedef void (GLEXT_APIENTRY *PFN_glCompressedTexImage2D)(uint32_t target, int level, uint32_t internalformat, int width, int height, int border, int imageSize, const void* data);
+typedef void (GLEXT_APIENTRY *PFN_glBindTexture)(uint32_t target, uint32_t texture);
+typedef void (GLEXT_APIENTRY *PFN_glTexStorage2D)(uint32_t target, int levels, uint32_t internalformat, int width, int height);
+typedef void (GLEXT_APIENTRY *PFN_glTexStorage3D)(uint32_t target, int levels, uint32_t internalformat, int width, int height, int depth);
+typedef void (GLEXT_APIENTRY *PFN_glBindImageTexture)(uint32_t unit, uint32_t texture, int level, unsigned char layered, int layer, uint32_t access, uint32_t format);
+typedef void (GLEXT_APIENTRY *PFN_glGetTexImage)(uint32_t target, int level, uint32_t format, uint32_t type, void* pixels);
+typedef const unsigned char* (GLEXT_APIENTRY *PFN_glGetString)(uint32_t name);
+typedef void (GLEXT_APIENTRY *PFN_glGetIntegerv)(uint32_t pname, int* data);
+typedef void (GLEXT_APIENTRY *PFN_glGetProgramiv)(uint32_t program, uint32_t pname, int* params);
+typedef uint32_t (GLEXT_APIENTRY *PFN_glCreateProgram)(void);
+typedef void (GLEXT_APIENTRY *PFN_glGetProgramBinary)(uint32_t program, int bufSize, int* length, uint32_t* binaryFormat, void* binary);
+typedef void (GLEXT_APIENTRY *PFN_glProgramBinary)(uint32_t program, uint32_t binaryFormat, const void* binary, int length);
+typedef const unsigned char* (GLEXT_APIENTRY *PFN_glGetStringi)(uint32_t name, uint32_t index);
+typedef uint32_t (GLEXT_APIENTRY *PFN_glCreateShader)(uint32_t type);
+typedef void (GLEXT_APIENTRY *PFN_glShaderSource)(uint32_t shader, int count, const char* const* string, const int* length);
+typedef void (GLEXT_APIENTRY *PFN_glCompileShader)(uint32_t shader);
+typedef void (GLEXT_APIENTRY *PFN_glGetShaderiv)(uint32_t shader, uint32_t pname, int* params);
+typedef void (GLEXT_APIENTRY *PFN_glGetShaderInfoLog)(uint32_t shader, int bufSize, int* length, char* infoLog);
+typedef void (GLEXT_APIENTRY *PFN_glGetProgramInfoLog)(uint32_t program, int bufSize, int* length, char* infoLog);
+typedef void (GLEXT_APIENTRY *PFN_glAttachShader)(uint32_t program, uint32_t shader);
+typedef void (GLEXT_APIENTRY *PFN_glDetachShader)(uint32_t program, uint32_t shader);
+typedef void (GLEXT_APIENTRY *PFN_glDeleteShader)(uint32_t shader);
+typedef void (GLEXT_APIENTRY *PFN_glLinkProgram)(uint32_t program);
+typedef void (GLEXT_APIENTRY *PFN_glMaxShaderCompilerThreads)(uint32_t count);
+typedef void (GLEXT_APIENTRY *PFN_glGenQueries)(int n, uint32_t* ids);
+typedef void (GLEXT_APIENTRY *PFN_glDeleteQueries)(int n, const uint32_t* ids);
+typedef void (GLEXT_APIENTRY *PFN_glQueryCounter)(uint32_t id, uint32_t target);
+typedef void (GLEXT_APIENTRY *PFN_glGetQueryObjectiv)(uint32_t id, uint32_t pname, int* params);
+typedef void (GLEXT_APIENTRY *PFN_glGetQueryObjectui64v)(uint32_t id, uint32_t pname, uint64_t* params);
+typedef void (GLEXT_APIENTRY *PFN_glGenBuffers)(int n, uint32_t* buffers);
+typedef void (GLEXT_APIENTRY *PFN_glDeleteBuffers)(int n, const uint32_t* buffers);
+typedef void (GLEXT_APIENTRY *PFN_glBindBuffer)(uint32_t target, uint32_t buffer);
+typedef void (GLEXT_APIENTRY *PFN_glBufferData)(uint32_t target, intptr_t size, const void* data, uint32_t usage);
+typedef void* (GLEXT_APIENTRY *PFN_glMapBufferRange)(uint32_t target, intptr_t offset, intptr_t length, uint32_t access);
+typedef unsigned char (GLEXT_APIENTRY *PFN_glUnmapBuffer)(uint32_t target);
+typedef void* (GLEXT_APIENTRY *PFN_glFenceSync)(uint32_t condition, uint32_t flags);
+typedef uint32_t (GLEXT_APIENTRY *PFN_glClientWaitSync)(void* sync, uint32_t flags, uint64_t timeout);
+typedef void (GLEXT_APIENTRY *PFN_glDeleteSync)(void* sync);
+
+
+constexpr uint32_t SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+constexpr uint32_t SYNC_FLUSH_COMMANDS_BIT = 0x00000001;
+constexpr uint32_t ALREADY_SIGNALED = 0x911A;
+constexpr uint32_t CONDITION_SATISFIED = 0x911C;
+
+
+static PFN_glMemoryBarrier p_glMemoryBarrier = nullptr;
+static PFN_glFinish p_glFinish = nullptr;
+static PFN_glCopyImageSubData p_glCopyImageSubData = nullptr;
+static PFN_glGenTextures p_glGenTextures = nullptr;
+static PFN_glCompressedTexImage2D p_glCompressedTexImage2D = nullptr;
+static PFN_glBindTexture p_glBindTexture = nullptr;
+static PFN_glTexStorage2D p_glTexStorage2D = nullptr;
+static PFN_glTexStorage3D p_glTexStorage3D = nullptr;
+static PFN_glBindImageTexture p_glBindImageTexture = nullptr;
+static PFN_glGetTexImage p_glGetTexImage = nullptr;
+static PFN_glGetString p_glGetString = nullptr;
+static PFN_glGetIntegerv p_glGetIntegerv = nullptr;
+static PFN_glGetProgramiv p_glGetProgramiv = nullptr;
+static PFN_glCreateProgram p_glCreateProgram = nullptr;
+static PFN_glGetProgramBinary p_glGetProgramBinary = nullptr;
+static PFN_glProgramBinary p_glProgramBinary = nullptr;
+static PFN_glGetStringi p_glGetStringi = nullptr;
+static PFN_glCreateShader p_glCreateShader = nullptr;
+static PFN_glShaderSource p_glShaderSource = nullptr;
+static PFN_glCompileShader p_glCompileShader = nullptr;
+static PFN_glGetShaderiv p_glGetShaderiv = nullptr;
+static PFN_glGetShaderInfoLog p_glGetShaderInfoLog = nullptr;
+static PFN_glGetProgramInfoLog p_glGetProgramInfoLog = nullptr;
+static PFN_glAttachShader p_glAttachShader = nullptr;
+static PFN_glDetachShader p_glDetachShader = nullptr;
+static PFN_glDeleteShader p_glDeleteShader = nullptr;
+static PFN_glLinkProgram p_glLinkProgram = nullptr;
+static PFN_glMaxShaderCompilerThreads p_glMaxShaderCompilerThreads = nullptr;
+static PFN_glGenQueries p_glGenQueries = nullptr;
+static PFN_glDeleteQueries p_glDeleteQueries = nullptr;
+static PFN_glQueryCounter p_glQueryCounter = nullptr;
+static PFN_glGetQueryObjectiv p_glGetQueryObjectiv = nullptr;
+static PFN_glGetQueryObjectui64v p_glGetQueryObjectui64v = nullptr;
+static PFN_glGenBuffers p_glGenBuffers = nullptr;
+static PFN_glDeleteBuffers p_glDeleteBuffers = nullptr;
+static PFN_glBindBuffer p_glBindBuffer = nullptr;
+static PFN_glBufferData p_glBufferData = nullptr;
+static PFN_glMapBufferRange p_glMapBufferRange = nullptr;
+static PFN_glUnmapBuffer p_glUnmapBuffer = nullptr;
+static PFN_glFenceSync p_glFenceSync = nullptr;
+static PFN_glClientWaitSync p_glClientWaitSync = nullptr;
+static PFN_glDeleteSync p_glDeleteSync = nullptr;
+
+
+template <typename T>
+static bool loadProc(T& proc, const char* name) {
+    proc = (T) glfwGetProcAddress(name);
+    if (proc == nullptr) {
+        INFO("Failed to load GL entry point '%s'", name);
+    }
+    return proc != nullptr;
+}
+
+
+bool load() {
+    bool loaded = true;
+    loaded &= loadProc(p_glMemoryBarrier, "glMemoryBarrier");
+    loaded &= loadProc(p_glFinish, "glFinish");
+    loaded &= loadProc(p_glCopyImageSubData, "glCopyImageSubData");
+    loaded &= loadProc(p_glGenTextures, "glGenTextures");
+    loaded &= loadProc(p_glCompressedTexImage2D, "glCompressedTexImage2D");
+    loaded &= loadProc(p_glBindTexture, "glBindTexture");
+    loaded &= loadProc(p_glTexStorage2D, "glTexStorage2D");
+    loaded &= loadProc(p_glTexStorage3D, "glTexStorage3D");
+    loaded &= loadProc(p_glBindImageTexture, "glBindImageTexture");
+    loaded &= loadProc(p_glGetTexImage, "glGetTexImage");
+    loaded &= loadProc(p_glGetString, "glGetString");
+    loaded &= loadProc(p_glGetIntegerv, "glGetIntegerv");
+    loaded &= loadProc(p_glGetProgramiv, "glGetProgramiv");
+    loaded &= loadProc(p_glCreateProgram, "glCreateProgram");
+    loaded &= loadProc(p_glGetProgramBinary, "glGetProgramBinary");
+    loaded &= loadProc(p_glProgramBinary, "glProgramBinary");
+    loaded &= loadProc(p_glGetStringi, "glGetStringi");
+    loaded &= loadProc(p_glCreateShader, "glCreateShader");
+    loaded &= loadProc(p_glShaderSource, "glShaderSource");
+    loaded &= loadProc(p_glCompileShader, "glCompileShader");
+    loaded &= loadProc(p_glGetShaderiv, "glGetShaderiv");
+    loaded &= loadProc(p_glGetShaderInfoLog, "glGetShaderInfoLog");
+    loaded &= loadProc(p_glGetProgramInfoLog, "glGetProgramInfoLog");
+    loaded &= loadProc(p_glAttachShader, "glAttachShader");
+    loaded &= loadProc(p_glDetachShader, "glDetachShader");
+    loaded &= loadProc(p_glDeleteShader, "glDeleteShader");
+    loaded &= loadProc(p_glLinkProgram, "glLinkProgram");
+    loaded &= loadProc(p_glGenQueries, "glGenQueries");
+    loaded &= loadProc(p_glDeleteQueries, "glDeleteQueries");
+    loaded &= loadProc(p_glQueryCounter, "glQueryCounter");
+    loaded &= loadProc(p_glGetQueryObjectiv, "glGetQueryObjectiv");
+    loaded &= loadProc(p_glGetQueryObjectui64v, "glGetQueryObjectui64v");
+    loaded &= loadProc(p_glGenBuffers, "glGenBuffers");
+    loaded &= loadProc(p_glDeleteBuffers, "glDeleteBuffers");
+    loaded &= loadProc(p_glBindBuffer, "glBindBuffer");
+    loaded &= loadProc(p_glBufferData, "glBufferData");
+    loaded &= loadProc(p_glMapBufferRange, "glMapBufferRange");
+    loaded &= loadProc(p_glUnmapBuffer, "glUnmapBuffer");
+    loaded &= loadProc(p_glFenceSync, "glFenceSync");
+    loaded &= loadProc(p_glClientWaitSync, "glClientWaitSync");
+    loaded &= loadProc(p_glDeleteSync, "glDeleteSync");
+
+    if (loaded) {
+        TRACE("Loaded GL extension entry points");
+    }
+
+    // optional, without it compiles finish on the first status query
+    if (hasExtension("GL_KHR_parallel_shader_compile")) {
+        loadProc(p_glMaxShaderCompilerThreads, "glMaxShaderCompilerThreadsKHR");
+    } else if (hasExtension("GL_ARB_parallel_shader_compile")) {
+        loadProc(p_glMaxShaderCompilerThreads, "glMaxShaderCompilerThreadsARB");
+    }
+    if (p_glMaxShaderCompilerThreads) {
+        // let the driver pick the number of threads
+        p_glMaxShaderCompilerThreads(0xFFFFFFFF);
+        INFO("Parallel shader compilation is supported");
+    }
+
+    return loaded;
+}
+
+
+void memoryBarrier(uint32_t barriers) {
+    if (p_glMemoryBarrier) {
+        p_glMemoryBarrier(barriers);
+    }
+}
+
+
+void finish() {
+    if (p_glFinish) {
+        p_glFinish();
+    }
+}
+
+
+void copyTexture(uint32_t srcId, uint32_t dstId, int width, int height) {
+    if (p_glCopyImageSubData) {
+        p_glCopyImageSubData(srcId, TEXTURE_2D, 0, 0, 0, 0, dstId, TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+    }
+}
+
+
+uint32_t genTexture() {
+    uint32_t id = 0;
+    if (p_glGenTextures) {
+        p_glGenTextures(1, &id);
+    }
+    return id;
+}
+
+
+void bindTexture(uint32_t target, uint32_t id) {
+    if (p_glBindTexture) {
+        p_glBindTexture(target, id);
+    }
+}
+
+
+void compressedTexImage2D(int level, uint32_t internalFormat, int width, int height, int imageSize, const void* data) {
+    if (p_glCompressedTexImage2D) {
+        p_glCompressedTexImage2D(TEXTURE_2D, level, internalFormat, width, height, 0, imageSize, data);
+    }
+}
+
+
+void texStorage2D(int levels, uint32_t internalFormat, int width, int height) {
+    if (p_glTexStorage2D) {
+        p_glTexStorage2D(TEXTURE_2D, levels, internalFormat, width, height);
+    }
+}
+
+
+void texStorage3D(int levels, uint32_t internalFormat, int width, int height, int depth) {
+    if (p_glTexStorage3D) {
+        p_glTexStorage3D(TEXTURE_2D_ARRAY, levels, internalFormat, width, height, depth);
+    }
+}
+
+
+void bindImageTexture(uint32_t unit, uint32_t id, uint32_t access, uint32_t format, bool layered) {
+    if (p_glBindImageTexture) {
+        p_glBindImageTexture(unit, id, 0, layered, 0, access, format);
+    }
+}
+
+
+void getTexImage(int level, uint32_t format, uint32_t type, void* pixels, uint32_t target) {
+    if (p_glGetTexImage) {
+        p_glGetTexImage(target, level, format, type, pixels);
+    }
+}
+
+
+const char* getString(uint32_t name) {
+    const unsigned char* str = p_glGetString ? p_glGetString(name) : nullptr;
+    return str ? (const char*) str : "";
+}
+
+
+int getInteger(uint32_t name) {
+    int value = 0;
+    if (p_glGetIntegerv) {
+        p_glGetIntegerv(name, &value);
+    }
+    return value;
+}
+
+
+int getProgramInteger(uint32_t program, uint32_t name) {
+    int value = 0;
+    if (p_glGetProgramiv) {
+        p_glGetProgramiv(program, name, &value);
+    }
+    return value;
+}
+
+
+uint32_t createProgram() {
+    return p_glCreateProgram ? p_glCreateProgram() : 0;
+}
+
+
+bool hasExtension(const char* name) {
+    if (!p_glGetStringi) {
+        return false;
+    }
+
+    const int count = getInteger(NUM_EXTENSIONS);
+    for (int i = 0; i < count; i++) {
+        const unsigned char* extension = p_glGetStringi(EXTENSIONS, i);
+        if (extension && strcmp((const char*) extension, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+uint32_t createShader(uint32_t type) {
+    return p_glCreateShader ? p_glCreateShader(type) : 0;
+}
+
+
+void shaderSource(uint32_t shader, const char* source) {
+    if (p_glShaderSource) {
+        p_glShaderSource(shader, 1, &source, nullptr);
+    }
+}
+
+
+void compileShader(uint32_t shader) {
+    if (p_glCompileShader) {
+        p_glCompileShader(shader);
+    }
+}
+
+
+int getShaderInteger(uint32_t shader, uint32_t name) {
+    int value = 0;
+    if (p_glGetShaderiv) {
+        p_glGetShaderiv(shader, name, &value);
+    }
+    return value;
+}
+
+
+void getShaderInfoLog(uint32_t shader, int bufSize, char* log) {
+    log[0] = '\0';
+    if (p_glGetShaderInfoLog) {
+        p_glGetShaderInfoLog(shader, bufSize, nullptr, log);
+    }
+}
+
+
+void getProgramInfoLog(uint32_t program, int bufSize, char* log) {
+    log[0] = '\0';
+    if (p_glGetProgramInfoLog) {
+        p_glGetProgramInfoLog(program, bufSize, nullptr, log);
+    }
+}
+
+
+void attachShader(uint32_t program, uint32_t shader) {
+    if (p_glAttachShader) {
+        p_glAttachShader(program, shader);
+    }
+}
+
+
+void detachShader(uint32_t program, uint32_t shader) {
+    if (p_glDetachShader) {
+        p_glDetachShader(program, shader);
+    }
+}
+
+
+void deleteShader(uint32_t shader) {
+    if (p_glDeleteShader) {
+        p_glDeleteShader(shader);
+    }
+}
+
+
+void linkProgram(uint32_t program) {
+    if (p_glLinkProgram) {
+        p_glLinkProgram(program);
+    }
+}
+
+
+bool hasParallelShaderCompile() {
+    return p_glMaxShaderCompilerThreads != nullptr;
+}
+
+
+void getProgramBinary(uint32_t program, int bufSize, int* length, uint32_t* binaryFormat, void* binary) {
+    if (p_glGetProgramBinary) {
+        p_glGetProgramBinary(program, bufSize, length, binaryFormat, binary);
+    } else {
+        *length = 0;
+    }
+}
+
+
+void programBinary(uint32_t program, uint32_t binaryFormat, const void* binary, int length) {
+    if (p_glProgramBinary) {
+        p_glProgramBinary(program, binaryFormat, binary, length);
+    }
+}
+
+
+void genQueries(int n, uint32_t* ids) {
+    if (p_glGenQueries) {
+        p_glGenQueries(n, ids);
+    }
+}
+
+
+void deleteQueries(int n, const uint32_t* ids) {
+    if (p_glDeleteQueries) {
+        p_glDeleteQueries(n, ids);
+    }
+}
+
+
+void queryCounter(uint32_t id, uint32_t target) {
+    if (p_glQueryCounter) {
+        p_glQueryCounter(id, target);
+    }
+}
+
+
+int getQueryObjectInteger(uint32_t id, uint32_t name) {
+    int value = 0;
+    if (p_glGetQueryObjectiv) {
+        p_glGetQueryObjectiv(id, name, &value);
+    }
+    return value;
+}
+
+
+uint64_t getQueryObjectUint64(uint32_t id, uint32_t name) {
+    uint64_t value = 0;
+    if (p_glGetQueryObjectui64v) {
+        p_glGetQueryObjectui64v(id, name, &value);
+    }
+    return value;
+}
+
+
+uint32_t genBuffer() {
+    uint32_t id = 0;
+    if (p_glGenBuffers) {
+        p_glGenBuffers(1, &id);
+    }
+    return id;
+}
+
+
+void deleteBuffer(uint32_t id) {
+    if (p_glDeleteBuffers) {
+        p_glDeleteBuffers(1, &id);
+    }
+}
+
+
+void bindBuffer(uint32_t target, uint32_t id) {
+    if (p_glBindBuffer) {
+        p_glBindBuffer(target, id);
+    }
+}
+
+
+void bufferData(uint32_t target, size_t size, const void* data, uint32_t usage) {
+    if (p_glBufferData) {
+        p_glBufferData(target, size, data, usage);
+    }
+}
+
+
+void* mapBufferRange(uint32_t target, size_t offset, size_t length, uint32_t access) {
+    return p_glMapBufferRange ? p_glMapBufferRange(target, offset, length, access) : nullptr;
+}
+
+
+void unmapBuffer(uint32_t target) {
+    if (p_glUnmapBuffer) {
+        p_glUnmapBuffer(target);
+    }
+}
+
+
+void* fenceSync() {
+    return p_glFenceSync ? p_glFenceSync(SYNC_GPU_COMMANDS_COMPLETE, 0) : nullptr;
+}
+
+
+bool waitSync(void* sync, uint64_t timeout) {
+    if (sync == nullptr || p_glClientWaitSync == nullptr) {
+        return true;
+    }
+
+    // flushing makes sure the fence is submitted, otherwise waiting on it could never end
+    const uint32_t status = p_glClientWaitSync(sync, SYNC_FLUSH_COMMANDS_BIT, timeout);
+    return status == ALREADY_SIGNALED || status == CONDITION_SATISFIED;
+}
+
+
+void deleteSync(void* sync) {
+    if (sync && p_glDeleteSync) {
+        p_glDeleteSync(sync);
+    }
+}
+
+
+} // namespace glext
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// small subset of OpenGL 4.3 that rlgl does not expose
+// entry points are resolved from the current context, so load() must be called after the window is created
+
+
+namespace glext {
+
+
+constexpr uint32_t SHADER_IMAGE_ACCESS_BARRIER_BIT = 0x00000020;
+constexpr uint32_t TEXTURE_FETCH_BARRIER_BIT = 0x00000008;
+constexpr uint32_t TEXTURE_UPDATE_BARRIER_BIT = 0x00000100;
+constexpr uint32_t BUFFER_UPDATE_BARRIER_BIT = 0x00000200;
+constexpr uint32_t ALL_BARRIER_BITS = 0xFFFFFFFF;
+
+constexpr uint32_t TEXTURE_2D = 0x0DE1;
+constexpr uint32_t TEXTURE_2D_ARRAY = 0x8C1A;
+// BC1 needs GL_EXT_texture_compression_s3tc, BC4 (RGTC1) is core
+constexpr uint32_t COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+constexpr uint32_t COMPRESSED_RED_RGTC1 = 0x8DBB;
+// raylib has no integer formats
+constexpr uint32_t R32UI = 0x8236;
+constexpr uint32_t RGBA16F = 0x881A;
+
+constexpr uint32_t RGBA = 0x1908;
+constexpr uint32_t UNSIGNED_BYTE = 0x1401;
+constexpr uint32_t FLOAT = 0x1406;
+
+constexpr uint32_t READ_ONLY = 0x88B8;
+constexpr uint32_t WRITE_ONLY = 0x88B9;
+constexpr uint32_t READ_WRITE = 0x88BA;
+
+constexpr uint32_t VENDOR = 0x1F00;
+constexpr uint32_t RENDERER = 0x1F01;
+constexpr uint32_t VERSION = 0x1F02;
+constexpr uint32_t EXTENSIONS = 0x1F03;
+constexpr uint32_t NUM_EXTENSIONS = 0x821D;
+constexpr uint32_t MAX_TEXTURE_SIZE = 0x0D33;
+
+constexpr uint32_t COMPUTE_SHADER = 0x91B9;
+constexpr uint32_t COMPILE_STATUS = 0x8B81;
+// GL_KHR_parallel_shader_compile / GL_ARB_parallel_shader_compile
+constexpr uint32_t COMPLETION_STATUS = 0x91B1;
+
+constexpr uint32_t LINK_STATUS = 0x8B82;
+constexpr uint32_t PROGRAM_BINARY_LENGTH = 0x8741;
+constexpr uint32_t NUM_PROGRAM_BINARY_FORMATS = 0x87FE;
+
+constexpr uint32_t PIXEL_PACK_BUFFER = 0x88EB;
+constexpr uint32_t STREAM_READ = 0x88E1;
+constexpr uint32_t MAP_READ_BIT = 0x0001;
+
+constexpr uint32_t TIMESTAMP = 0x8E28;
+constexpr uint32_t QUERY_RESULT = 0x8866;
+constexpr uint32_t QUERY_RESULT_AVAILABLE = 0x8867;
+
+
+bool load();
+void memoryBarrier(uint32_t barriers);
+// blocks until all submitted GL work has completed
+void finish();
+// copies level 0 of one 2D texture into another of the same format
+void copyTexture(uint32_t srcId, uint32_t dstId, int width, int height);
+uint32_t genTexture();
+// 0 unbinds, rlEnableTexture() only binds 2D textures
+void bindTexture(uint32_t target, uint32_t id);
+// uploads one level of the bound 2D texture
+void compressedTexImage2D(int level, uint32_t internalFormat, int width, int height, int imageSize, const void* data);
+// immutable storage for the bound 2D texture
+void texStorage2D(int levels, uint32_t internalFormat, int width, int height);
+// immutable storage for the bound 2D array texture
+void texStorage3D(int levels, uint32_t internalFormat, int width, int height, int depth);
+// rlBindImageTexture() only knows raylib's pixel formats, layered binds every layer of an array
+void bindImageTexture(uint32_t unit, uint32_t id, uint32_t access, uint32_t format, bool layered = false);
+// reads one level of the bound texture, converting to format and type (layers of an array follow each other)
+void getTexImage(int level, uint32_t format, uint32_t type, void* pixels, uint32_t target = TEXTURE_2D);
+
+const char* getString(uint32_t name);
+int getInteger(uint32_t name);
+int getProgramInteger(uint32_t program, uint32_t name);
+uint32_t createProgram();
+bool hasExtension(const char* name);
+
+uint32_t createShader(uint32_t type);
+void shaderSource(uint32_t shader, const char* source);
+void compileShader(uint32_t shader);
+int getShaderInteger(uint32_t shader, uint32_t name);
+void getShaderInfoLog(uint32_t shader, int bufSize, char* log);
+void getProgramInfoLog(uint32_t program, int bufSize, char* log);
+void attachShader(uint32_t program, uint32_t shader);
+void detachShader(uint32_t program, uint32_t shader);
+void deleteShader(uint32_t shader);
+void linkProgram(uint32_t program);
+// true when the driver compiles in the background and COMPLETION_STATUS can be polled
+bool hasParallelShaderCompile();
+void getProgramBinary(uint32_t program, int bufSize, int* length, uint32_t* binaryFormat, void* binary);
+void programBinary(uint32_t program, uint32_t binaryFormat, const void* binary, int length);
+
+void genQueries(int n, uint32_t* ids);
+void deleteQueries(int n, const uint32_t* ids);
+void queryCounter(uint32_t id, uint32_t target);
+int getQueryObjectInteger(uint32_t id, uint32_t name);
+uint64_t getQueryObjectUint64(uint32_t id, uint32_t name);
+
+uint32_t genBuffer();
+void deleteBuffer(uint32_t id);
+// 0 unbinds
+void bindBuffer(uint32_t target, uint32_t id);
+void bufferData(uint32_t target, size_t size, const void* data, uint32_t usage);
+void* mapBufferRange(uint32_t target, size_t offset, size_t length, uint32_t access);
+void unmapBuffer(uint32_t target);
+
+// fence after the commands submitted so far, nullptr when unsupported
+void* fenceSync();
+// true once the commands before the fence have completed, waits at most timeout nanoseconds (0 only polls)
+bool waitSync(void* sync, uint64_t timeout);
+void deleteSync(void* sync);
+
+
+} // namespace glext
@@ -0,0 +1,87 @@
+#include "src/governor.h"
+#include "src/logger.h"
+#include <algorithm>
+#include <cmath>
+
+
+ResolutionGovernor::ResolutionGovernor(Vector2 fullSize, const ResolutionGovernorParams& params)
+    : m_fullSize(fullSize), m_params(params), m_scale(params.maxScale) {
+
+    if (isEnabled()) {
+        INFO("Resolution governor targeting %f ms per frame", m_params.targetFrameTime * 1000.0f);
+    }
+}
+
+
+void ResolutionGovernor::setFullSize(Vector2 fullSize) {
+    m_fullSize = fullSize;
+    m_framesSinceChange = 0;
+    m_renderTime = 0.0f;
+}
+
+
+bool ResolutionGovernor::update(float renderTime, bool cameraMoved) {
+    if (!isEnabled()) {
+        return false;
+    }
+
+    m_framesSinceMove = cameraMoved ? 0 : m_framesSinceMove + 1;
+
+    // converged still frames are rendered at full resolution regardless of the budget
+    const bool still = m_framesSinceMove >= m_params.stillFrames;
+    if (still != m_still) {
+        m_still = still;
+        m_framesSinceChange = 0;
+        m_renderTime = 0.0f;
+        TRACE("Resolution governor: %s, scale = %f", m_still ? "still" : "moving", getScale());
+        return m_scale != m_params.maxScale;
+    }
+    if (m_still) {
+        return false;
+    }
+
+    // exponential moving average, seeded with the first measurement after a change
+    m_renderTime = m_renderTime == 0.0f ? renderTime : m_renderTime * 0.8f + renderTime * 0.2f;
+
+    if (++m_framesSinceChange < m_params.settleFrames) {
+        return false;
+    }
+
+    const float ratio = m_params.targetFrameTime / m_renderTime;
+    if (ratio > 0.9f && ratio < 1.1f) {
+        return false;
+    }
+
+    // render cost is roughly proportional to the pixel count, quantized to avoid reallocating on tiny changes
+    float scale = std::clamp(m_scale * std::sqrt(ratio), m_params.minScale, m_params.maxScale);
+    scale = std::clamp(std::round(scale * 16.0f) / 16.0f, m_params.minScale, m_params.maxScale);
+
+    float numSamples = m_numSamples;
+    if (m_params.adjustSamples) {
+        if (scale == m_params.minScale && ratio < 1.0f) {
+            numSamples = std::max(m_params.minSamples, std::floor(m_numSamples / 2.0f));
+        } else if (scale == m_params.maxScale && ratio > 2.0f) {
+            numSamples = std::min(m_params.maxSamples, m_numSamples * 2.0f);
+        }
+    }
+
+    if (scale == m_scale && numSamples == m_numSamples) {
+        return false;
+    }
+
+    TRACE("Resolution governor: render time = %f ms, scale %f -> %f, samples %d -> %d", m_renderTime * 1000.0f, m_scale, scale, (int) m_numSamples, (int) numSamples);
+    m_scale = scale;
+    m_numSamples = numSamples;
+    m_framesSinceChange = 0;
+    m_renderTime = 0.0f;
+    return true;
+}
+
+
+Vector2 ResolutionGovernor::getRenderSize() const {
+    const float scale = getScale();
+    return {
+        std::max(1.0f, std::floor(m_fullSize.x * scale)),
+        std::max(1.0f, std::floor(m_fullSize.y * scale)),
+    };
+}
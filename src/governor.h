@@ -0,0 +1,49 @@
+#pragma once
+
+#include <raylib/raylib.h>
+
+
+struct ResolutionGovernorParams {
+    // render time budget in seconds, 0 disables the governor
+    float targetFrameTime = 0.025f;
+    // per axis fraction of the full resolution
+    float minScale = 0.25f;
+    float maxScale = 1.0f;
+    // frames between two resolution changes
+    int settleFrames = 10;
+    // still frames after which the full resolution is restored
+    int stillFrames = 15;
+    // trade samples per frame when the resolution is already at a limit
+    bool adjustSamples = false;
+    float minSamples = 1.0f;
+    float maxSamples = 32.0f;
+};
+
+
+// picks the internal render resolution (and optionally the sample count) so that the
+// measured render time stays close to a budget
+class ResolutionGovernor {
+
+public:
+    ResolutionGovernor(Vector2 fullSize, const ResolutionGovernorParams& params);
+    bool isEnabled() const { return m_params.targetFrameTime > 0.0f; }
+    void setFullSize(Vector2 fullSize);
+    void setNumSamples(float numSamples) { m_numSamples = numSamples; }
+    // returns true when the render size or the sample count changed
+    bool update(float renderTime, bool cameraMoved);
+    Vector2 getRenderSize() const;
+    float getScale() const { return m_still ? m_params.maxScale : m_scale; }
+    float getNumSamples() const { return m_numSamples; }
+
+private:
+    Vector2 m_fullSize;
+    ResolutionGovernorParams m_params;
+
+    float m_scale;
+    float m_numSamples = 1.0f;
+    // smoothed render time
+    float m_renderTime = 0.0f;
+    int m_framesSinceChange = 0;
+    int m_framesSinceMove = 0;
+    bool m_still = false;
+};
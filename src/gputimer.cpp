@@ -0,0 +1,154 @@
+#include "src/gputimer.h"
+#include "src/glext.h"
+#include "src/logger.h"
+#include <algorithm>
+
+
+namespace gputimer {
+
+
+// frames a query may stay in flight before its pass stops being measured
+static const int queryRingSize = 8;
+// measurements used for the rolling statistics
+static const int historySize = 64;
+
+
+struct Pass {
+    std::string name;
+    uint32_t startQueries[queryRingSize];
+    uint32_t endQueries[queryRingSize];
+    bool pending[queryRingSize] = {};
+    // slot used by the next begin(), and the slot between begin() and end()
+    int next = 0;
+    int open = -1;
+
+    float history[historySize];
+    int historyCount = 0;
+    int historyNext = 0;
+    float last = 0.0f;
+};
+
+
+// passes are few, kept in order of first use so the overlay is stable
+static std::vector<Pass> passes;
+
+
+static Pass& getPass(const char* name) {
+    for (Pass& pass : passes) {
+        if (pass.name == name) {
+            return pass;
+        }
+    }
+
+    Pass& pass = passes.emplace_back();
+    pass.name = name;
+    glext::genQueries(queryRingSize, pass.startQueries);
+    glext::genQueries(queryRingSize, pass.endQueries);
+    TRACE("Created GPU timer for pass '%s'", name);
+    return pass;
+}
+
+
+void begin(const char* name) {
+    Pass& pass = getPass(name);
+
+    // results of this slot are not back yet, skip the measurement instead of waiting
+    if (pass.pending[pass.next]) {
+        pass.open = -1;
+        return;
+    }
+
+    glext::queryCounter(pass.startQueries[pass.next], glext::TIMESTAMP);
+    pass.open = pass.next;
+}
+
+
+void end(const char* name) {
+    Pass& pass = getPass(name);
+    if (pass.open < 0) {
+        return;
+    }
+
+    glext::queryCounter(pass.endQueries[pass.open], glext::TIMESTAMP);
+    pass.pending[pass.open] = true;
+    pass.next = (pass.open + 1) % queryRingSize;
+    pass.open = -1;
+}
+
+
+void update() {
+    for (Pass& pass : passes) {
+        // oldest slot first
+        for (int i = 0; i < queryRingSize; i++) {
+            const int slot = (pass.next + i) % queryRingSize;
+            if (!pass.pending[slot]) {
+                continue;
+            }
+            if (!glext::getQueryObjectInteger(pass.endQueries[slot], glext::QUERY_RESULT_AVAILABLE)) {
+                break;
+            }
+
+            const uint64_t start = glext::getQueryObjectUint64(pass.startQueries[slot], glext::QUERY_RESULT);
+            const uint64_t end = glext::getQueryObjectUint64(pass.endQueries[slot], glext::QUERY_RESULT);
+            pass.pending[slot] = false;
+
+            pass.last = (end - start) / 1000000.0f;
+            pass.history[pass.historyNext] = pass.last;
+            pass.historyNext = (pass.historyNext + 1) % historySize;
+            pass.historyCount = std::min(pass.historyCount + 1, historySize);
+        }
+    }
+}
+
+
+std::vector<PassStats> getStats() {
+    std::vector<PassStats> out;
+
+    for (const Pass& pass : passes) {
+        PassStats stats = {pass.name, pass.last, 0.0f, 0.0f, 0.0f, pass.historyCount};
+
+        if (pass.historyCount > 0) {
+            stats.min = stats.max = pass.history[0];
+            for (int i = 0; i < pass.historyCount; i++) {
+                stats.average += pass.history[i];
+                stats.min = std::min(stats.min, pass.history[i]);
+                stats.max = std::max(stats.max, pass.history[i]);
+            }
+            stats.average /= pass.historyCount;
+        }
+
+        out.push_back(stats);
+    }
+
+    return out;
+}
+
+
+float getLast(const char* name) {
+    for (const Pass& pass : passes) {
+        if (pass.name == name) {
+            return pass.last;
+        }
+    }
+    return 0.0f;
+}
+
+
+void logStats() {
+    INFO("GPU pass timings (ms, last %d samples):", historySize);
+    for (const PassStats& stats : getStats()) {
+        INFO("    %-16s avg: %8.3f | min: %8.3f | max: %8.3f | samples: %d", stats.name.c_str(), stats.average, stats.min, stats.max, stats.samples);
+    }
+}
+
+
+void shutdown() {
+    for (Pass& pass : passes) {
+        glext::deleteQueries(queryRingSize, pass.startQueries);
+        glext::deleteQueries(queryRingSize, pass.endQueries);
+    }
+    passes.clear();
+}
+
+
+} // namespace gputimer
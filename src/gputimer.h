@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// asynchronous GPU timing of named passes using timestamp queries
+// results are read a few frames later, so measuring never stalls the pipeline
+
+
+#define GPU_TIMER_CONCAT_(a, b) a##b
+#define GPU_TIMER_CONCAT(a, b) GPU_TIMER_CONCAT_(a, b)
+#define GPU_TIMER_SCOPE(name) gputimer::Scope GPU_TIMER_CONCAT(gpuTimerScope_, __LINE__)(name)
+
+
+namespace gputimer {
+
+
+// all times in milliseconds, over the last `samples` measurements
+struct PassStats {
+    std::string name;
+    float last;
+    float average;
+    float min;
+    float max;
+    int samples;
+};
+
+
+void begin(const char* pass);
+void end(const char* pass);
+// reads back finished queries, call once per frame
+void update();
+std::vector<PassStats> getStats();
+// milliseconds of the pass' latest result (a few frames old), 0 before the first one
+float getLast(const char* pass);
+void logStats();
+void shutdown();
+
+
+class Scope {
+
+public:
+    Scope(const char* pass) : m_pass(pass) { begin(m_pass); }
+    ~Scope() { end(m_pass); }
+
+private:
+    const char* m_pass;
+};
+
+
+} // namespace gputimer
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+// FNV-1a, chained by passing the previous result as `hash`
+constexpr uint64_t hashSeed = 0xcbf29ce484222325ull;
+
+
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = hashSeed) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+
+template <typename T>
+uint64_t hashValue(const T& value, uint64_t hash = hashSeed) {
+    return hashBytes(&value, sizeof(T), hash);
+}
@@ -0,0 +1,39 @@
+#include "src/headless.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
+#include "src/logger.h"
+#include "src/materialregistry.h"
+#include <raylib/raylib.h>
+
+
+namespace headless {
+
+
+bool createContext() {
+    SetTraceLogLevel(LOG_WARNING);
+    SetConfigFlags(FLAG_WINDOW_HIDDEN);
+    // the window size does not limit what is rendered
+    InitWindow(64, 64, "Raytracing");
+    if (!IsWindowReady()) {
+        INFO("Failed to create a hidden window for the GL context");
+        return false;
+    }
+
+    if (!glext::load()) {
+        CloseWindow();
+        return false;
+    }
+
+    INFO("Created headless GL context");
+    return true;
+}
+
+
+void destroyContext() {
+    gputimer::shutdown();
+    rt::MaterialRegistry::shutdown();
+    CloseWindow();
+}
+
+
+} // namespace headless
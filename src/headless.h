@@ -0,0 +1,14 @@
+#pragma once
+
+
+// GL context for rendering without a visible window (C API, render server, tiled renders)
+// raylib only creates contexts with a window, so the window is hidden
+namespace headless {
+
+
+bool createContext();
+// also shuts down what outlives the raytracers (gpu timers, material registry), scenes must be gone by then
+void destroyContext();
+
+
+} // namespace headless
@@ -0,0 +1,315 @@
+#include "src/ipc.h"
+#include "src/logger.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #include <winsock2.h>
+    #include <afunix.h>
+    typedef SOCKET socket_t;
+    static const socket_t invalidSocket = INVALID_SOCKET;
+    #define poll WSAPoll
+    #define closeSocket closesocket
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+    typedef int socket_t;
+    static const socket_t invalidSocket = -1;
+    #define closeSocket ::close
+#endif
+
+
+namespace ipc {
+
+
+// bytes read from or written to a socket per call
+static const size_t chunkSize = 64 * 1024;
+// sent data is only compacted once this much has gone out
+static const size_t compactSize = 1024 * 1024;
+
+
+static bool setNonBlocking(socket_t socket) {
+#if defined(_WIN32)
+    u_long mode = 1;
+    return ioctlsocket(socket, FIONBIO, &mode) == 0;
+#else
+    const int flags = fcntl(socket, F_GETFL, 0);
+    return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+
+static bool wouldBlock() {
+#if defined(_WIN32)
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+
+// true when nothing is at the path, or only the socket of a server that is gone (which is removed)
+// regular files and the sockets of running servers are left alone
+static bool clearSocketPath(const sockaddr_un& address) {
+    const char* path = address.sun_path;
+#if defined(_WIN32)
+    // unix domain sockets are reparse points on windows
+    const DWORD attributes = GetFileAttributesA(path);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        return true;
+    }
+    const bool isSocket = (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+#else
+    struct stat info;
+    if (stat(path, &info) != 0) {
+        return errno == ENOENT;
+    }
+    const bool isSocket = S_ISSOCK(info.st_mode);
+#endif
+    if (!isSocket) {
+        INFO("'%s' exists and is not a socket", path);
+        return false;
+    }
+
+    const socket_t probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe == invalidSocket) {
+        return false;
+    }
+    const bool live = ::connect(probe, (const sockaddr*) &address, sizeof(address)) == 0;
+    closeSocket(probe);
+    if (live) {
+        INFO("A server is already listening on '%s'", path);
+        return false;
+    }
+
+    TRACE("Removing stale socket '%s'", path);
+    return remove(path) == 0;
+}
+
+
+Connection::Connection(intptr_t socket)
+    : m_socket(socket) {
+
+    setNonBlocking(m_socket);
+}
+
+
+std::unique_ptr<Connection> Connection::connect(const char* path) {
+#if defined(_WIN32)
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        INFO("Socket path '%s' is too long", path);
+        return nullptr;
+    }
+    strcpy(address.sun_path, path);
+
+    const socket_t socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (socket == invalidSocket) {
+        INFO("Failed to create a unix domain socket");
+        return nullptr;
+    }
+
+    // blocking, a local connect either succeeds or fails right away
+    if (::connect(socket, (const sockaddr*) &address, sizeof(address)) != 0) {
+        INFO("Failed to connect to '%s'", path);
+        closeSocket(socket);
+        return nullptr;
+    }
+    return std::make_unique<Connection>((intptr_t) socket);
+}
+
+
+Connection::~Connection() {
+    close();
+}
+
+
+void Connection::close() {
+    if (m_socket >= 0) {
+        closeSocket(m_socket);
+        m_socket = -1;
+    }
+}
+
+
+void Connection::receive() {
+    char buffer[chunkSize];
+
+    while (isOpen()) {
+        const auto received = recv(m_socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            m_inBuffer.append(buffer, received);
+            continue;
+        }
+        if (received < 0 && wouldBlock()) {
+            return;
+        }
+        // closed by the peer, or failed
+        close();
+    }
+}
+
+
+bool Connection::nextLine(std::string& line) {
+    const size_t end = m_inBuffer.find('\n');
+    if (end == std::string::npos) {
+        return false;
+    }
+
+    line.assign(m_inBuffer, 0, end);
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    m_inBuffer.erase(0, end + 1);
+    return true;
+}
+
+
+bool Connection::nextBytes(size_t size, void* data) {
+    if (m_inBuffer.size() < size) {
+        return false;
+    }
+
+    memcpy(data, m_inBuffer.data(), size);
+    m_inBuffer.erase(0, size);
+    return true;
+}
+
+
+void Connection::send(const void* data, size_t size) {
+    const char* bytes = (const char*) data;
+    m_outBuffer.insert(m_outBuffer.end(), bytes, bytes + size);
+}
+
+
+void Connection::sendLine(const std::string& line) {
+    send(line.data(), line.size());
+    send("\n", 1);
+}
+
+
+void Connection::flush() {
+    while (isOpen() && hasPendingOutput()) {
+        const size_t size = std::min(chunkSize, m_outBuffer.size() - m_outOffset);
+#if defined(MSG_NOSIGNAL)
+        // a client that went away must not kill the server with SIGPIPE
+        const auto sent = ::send(m_socket, m_outBuffer.data() + m_outOffset, size, MSG_NOSIGNAL);
+#else
+        const auto sent = ::send(m_socket, m_outBuffer.data() + m_outOffset, size, 0);
+#endif
+        if (sent > 0) {
+            m_outOffset += sent;
+            continue;
+        }
+        if (sent < 0 && wouldBlock()) {
+            break;
+        }
+        close();
+    }
+
+    if (!hasPendingOutput()) {
+        m_outBuffer.clear();
+        m_outOffset = 0;
+    } else if (m_outOffset >= compactSize) {
+        m_outBuffer.erase(m_outBuffer.begin(), m_outBuffer.begin() + m_outOffset);
+        m_outOffset = 0;
+    }
+}
+
+
+Listener::~Listener() {
+    if (m_socket >= 0) {
+        closeSocket(m_socket);
+        remove(m_path.c_str());
+    }
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+
+bool Listener::open(const char* path) {
+#if defined(_WIN32)
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        INFO("Socket path '%s' is too long", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    if (!clearSocketPath(address)) {
+        INFO("Failed to listen on '%s'", path);
+        return false;
+    }
+
+    const socket_t listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == invalidSocket) {
+        INFO("Failed to create a unix domain socket");
+        return false;
+    }
+
+    if (bind(listener, (const sockaddr*) &address, sizeof(address)) != 0 || listen(listener, 16) != 0 || !setNonBlocking(listener)) {
+        INFO("Failed to listen on '%s'", path);
+        closeSocket(listener);
+        return false;
+    }
+
+    m_socket = (intptr_t) listener;
+    m_path = path;
+    INFO("Listening on '%s'", path);
+    return true;
+}
+
+
+std::unique_ptr<Connection> Listener::accept() {
+    const socket_t socket = ::accept(m_socket, nullptr, nullptr);
+    if (socket == invalidSocket) {
+        return nullptr;
+    }
+    return std::make_unique<Connection>((intptr_t) socket);
+}
+
+
+static void addPollFd(std::vector<pollfd>& fds, const Connection& connection) {
+    if (connection.isOpen()) {
+        const short events = POLLIN | (connection.hasPendingOutput() ? POLLOUT : 0);
+        fds.push_back({(socket_t) connection.getSocket(), events, 0});
+    }
+}
+
+
+void Listener::wait(const std::vector<std::unique_ptr<Connection>>& connections, int timeoutMs) const {
+    std::vector<pollfd> fds;
+    fds.push_back({(socket_t) m_socket, POLLIN, 0});
+    for (const auto& connection : connections) {
+        addPollFd(fds, *connection);
+    }
+    poll(fds.data(), fds.size(), timeoutMs);
+}
+
+
+void wait(const std::vector<Connection*>& connections, int timeoutMs) {
+    std::vector<pollfd> fds;
+    for (const Connection* connection : connections) {
+        addPollFd(fds, *connection);
+    }
+    poll(fds.data(), fds.size(), timeoutMs);
+}
+
+
+} // namespace ipc
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// non-blocking unix domain sockets carrying newline-terminated text, optionally followed by binary payloads
+// (AF_UNIX is also available on windows 10 and later)
+
+
+namespace ipc {
+
+
+class Connection {
+
+public:
+    explicit Connection(intptr_t socket);
+    // nullptr when nothing listens at path
+    static std::unique_ptr<Connection> connect(const char* path);
+    ~Connection();
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    bool isOpen() const { return m_socket >= 0; }
+    intptr_t getSocket() const { return m_socket; }
+    // reads whatever has arrived, closes the connection when the peer has
+    void receive();
+    // next complete line, without the newline
+    bool nextLine(std::string& line);
+    // the next size bytes, once all of them have arrived
+    bool nextBytes(size_t size, void* data);
+    // queued, then written by flush() as far as the socket accepts it
+    void send(const void* data, size_t size);
+    void sendLine(const std::string& line);
+    void flush();
+    bool hasPendingOutput() const { return m_outOffset < m_outBuffer.size(); }
+    void close();
+
+private:
+    intptr_t m_socket;
+    std::string m_inBuffer;
+    std::vector<char> m_outBuffer;
+    size_t m_outOffset = 0;
+};
+
+
+class Listener {
+
+public:
+    Listener() = default;
+    ~Listener();
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    // a stale socket file at path (left by a crashed server) is replaced
+    bool open(const char* path);
+    // nullptr when nobody is waiting
+    std::unique_ptr<Connection> accept();
+    // blocks until a connection or data arrives, or the timeout passes
+    void wait(const std::vector<std::unique_ptr<Connection>>& connections, int timeoutMs) const;
+
+private:
+    intptr_t m_socket = -1;
+    std::string m_path;
+};
+
+
+// blocks until one of the connections has data or can take more, or the timeout passes
+void wait(const std::vector<Connection*>& connections, int timeoutMs);
+
+
+} // namespace ipc
@@ -1,7 +1,8 @@
-
 #include "logger.h"
-#include <cstdarg>
-#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
 
 
 namespace logger {
@@ -10,31 +11,152 @@ namespace logger {
 LogLevel currentLogLevel = LogLevel::INFO;
 
 
-void setLogLevel(LogLevel level) { currentLogLevel = level; }
+namespace internal {
+
+
+// bounded MPSC ring (Vyukov), every slot carries a sequence number telling whose turn it is
+// memory use is fixed at ringSize * sizeof(Slot)
+constexpr size_t ringSize = 8192;
+
 
+struct Slot {
+    std::atomic<size_t> sequence;
+    Record record;
+};
 
-void trace(const char* format, ...) {
-    if (currentLogLevel > LogLevel::TRACE) {
-        return;
+
+class Backend {
+
+public:
+    Backend() {
+        for (size_t i = 0; i < ringSize; i++) {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_thread = std::thread([this]() { run(); });
     }
 
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
-}
+    ~Backend() {
+        m_running.store(false, std::memory_order_release);
+        m_thread.join();
+    }
 
+    Record* acquire() {
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
 
-void info(const char* format, ...) {
-    if (currentLogLevel > LogLevel::INFO) {
-        return;
+        while (true) {
+            Slot& slot = m_slots[pos % ringSize];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+
+            if (diff == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return &slot.record;
+                }
+            } else if (diff < 0) {
+                // the consumer has not freed this slot yet
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void commit(Record* record) {
+        // the slot still holds the sequence it was acquired with
+        Slot* slot = (Slot*) ((char*) record - offsetof(Slot, record));
+        const size_t pos = slot->sequence.load(std::memory_order_relaxed);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void countDropped() { m_dropped.fetch_add(1, std::memory_order_relaxed); }
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+    void setOutput(FILE* file) { flush(); m_output.store(file, std::memory_order_release); }
+
+    void flush() {
+        const size_t target = m_enqueuePos.load(std::memory_order_acquire);
+        while (m_written.load(std::memory_order_acquire) < target) {
+            std::this_thread::yield();
+        }
     }
 
-    va_list args;
-    va_start(args, format);
-    vprintf(format, args);
-    va_end(args);
+private:
+    bool consumeOne(FILE* output) {
+        Slot& slot = m_slots[m_dequeuePos % ringSize];
+        if (slot.sequence.load(std::memory_order_acquire) != m_dequeuePos + 1) {
+            return false;
+        }
+
+        char buffer[1024];
+        const Record& record = slot.record;
+        record.formatFn(buffer, sizeof(buffer), record.format, record.args);
+        fputs(buffer, output);
+
+        slot.sequence.store(m_dequeuePos + ringSize, std::memory_order_release);
+        m_dequeuePos++;
+        m_written.store(m_dequeuePos, std::memory_order_release);
+        return true;
+    }
+
+    void run() {
+        uint64_t reportedDrops = 0;
+
+        while (true) {
+            FILE* output = m_output.load(std::memory_order_acquire);
+            bool consumed = false;
+            while (consumeOne(output)) {
+                consumed = true;
+            }
+
+            const uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+            if (dropped != reportedDrops) {
+                fprintf(output, "LOG [ WARN  ]: logger dropped %llu messages\n", (unsigned long long) (dropped - reportedDrops));
+                reportedDrops = dropped;
+            }
+
+            if (consumed) {
+                fflush(output);
+            } else if (!m_running.load(std::memory_order_acquire)) {
+                break;
+            } else {
+                // idle polling keeps producers free of any syscall
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+private:
+    Slot m_slots[ringSize];
+    std::atomic<size_t> m_enqueuePos = 0;
+    // only touched by the consumer thread
+    size_t m_dequeuePos = 0;
+    std::atomic<size_t> m_written = 0;
+    std::atomic<uint64_t> m_dropped = 0;
+    std::atomic<FILE*> m_output = stdout;
+    std::atomic<bool> m_running = true;
+    std::thread m_thread;
+};
+
+
+static Backend& getBackend() {
+    // started on first use, drained and joined at exit
+    static Backend backend;
+    return backend;
 }
 
 
+Record* acquire() { return getBackend().acquire(); }
+void commit(Record* record) { getBackend().commit(record); }
+void countDropped() { getBackend().countDropped(); }
+
+
+} // namespace internal
+
+
+void setLogLevel(LogLevel level) { currentLogLevel = level; }
+void setOutput(FILE* file) { internal::getBackend().setOutput(file); }
+void flush() { internal::getBackend().flush(); }
+uint64_t getDroppedCount() { return internal::getBackend().getDroppedCount(); }
+
+
 } // namespace logger
@@ -1,9 +1,32 @@
-
 #pragma once
 
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <tuple>
+#include <type_traits>
+
+
+// the calling thread only copies the format pointer and the raw arguments into a lock-free ring,
+// formatting and printing happen on a background thread
+// when the ring is full messages are dropped (and counted) instead of blocking the caller
 
-#define TRACE(format, ...) logger::trace("LOG [ TRACE ]: " format "\n", ##__VA_ARGS__)
-#define INFO(format, ...) logger::info("LOG [ INFO  ]: " format "\n", ##__VA_ARGS__)
+// levels below LOGGER_MIN_LEVEL are compiled out (0: trace, 1: info, 2: nothing)
+#ifndef LOGGER_MIN_LEVEL
+    #define LOGGER_MIN_LEVEL 0
+#endif
+
+#if LOGGER_MIN_LEVEL <= 0
+    #define TRACE(format, ...) logger::log(logger::LogLevel::TRACE, "LOG [ TRACE ]: " format "\n", ##__VA_ARGS__)
+#else
+    #define TRACE(format, ...) ((void) 0)
+#endif
+
+#if LOGGER_MIN_LEVEL <= 1
+    #define INFO(format, ...) logger::log(logger::LogLevel::INFO, "LOG [ INFO  ]: " format "\n", ##__VA_ARGS__)
+#else
+    #define INFO(format, ...) ((void) 0)
+#endif
 
 
 namespace logger {
@@ -15,9 +38,136 @@ enum class LogLevel {
 };
 
 
+extern LogLevel currentLogLevel;
+
+
 void setLogLevel(LogLevel level);
-void trace(const char* format, ...);
-void info(const char* format, ...);
+// defaults to stdout, the file must stay open while the logger runs
+void setOutput(FILE* file);
+// blocks until every message logged so far has been written
+void flush();
+uint64_t getDroppedCount();
+
+
+namespace internal {
+
+
+constexpr size_t maxArgsSize = 192;
+// longer string arguments are truncated
+constexpr size_t maxStringSize = 128;
+
+typedef int (*FormatFn)(char* out, size_t outSize, const char* format, const unsigned char* args);
+
+
+struct Record {
+    FormatFn formatFn;
+    const char* format;
+    unsigned char args[maxArgsSize];
+};
+
+
+// returns a slot to write into, or nullptr (and counts a drop) when the ring is full
+Record* acquire();
+void commit(Record* record);
+void countDropped();
+
+
+// arithmetic values and pointers are copied as-is
+template <typename T>
+struct Arg {
+    using Decoded = T;
+
+    static size_t size(const T&) { return sizeof(T); }
+
+    static void encode(unsigned char*& cursor, const T& value) {
+        memcpy(cursor, &value, sizeof(T));
+        cursor += sizeof(T);
+    }
+
+    static T decode(const unsigned char*& cursor) {
+        T value;
+        memcpy(&value, cursor, sizeof(T));
+        cursor += sizeof(T);
+        return value;
+    }
+};
+
+
+// strings are copied since they rarely outlive the call
+template <>
+struct Arg<const char*> {
+    using Decoded = const char*;
+
+    static size_t size(const char* value) { return 1 + length(value) + 1; }
+
+    static void encode(unsigned char*& cursor, const char* value) {
+        const size_t len = length(value);
+        *cursor++ = (unsigned char) len;
+        memcpy(cursor, value, len);
+        cursor[len] = '\0';
+        cursor += len + 1;
+    }
+
+    static const char* decode(const unsigned char*& cursor) {
+        const size_t len = *cursor++;
+        const char* value = (const char*) cursor;
+        cursor += len + 1;
+        return value;
+    }
+
+    static size_t length(const char* value) {
+        size_t len = 0;
+        while (value && len < maxStringSize && value[len] != '\0') {
+            len++;
+        }
+        return len;
+    }
+};
+
+template <>
+struct Arg<char*> : Arg<const char*> {};
+
+
+template <typename T>
+using ArgOf = Arg<std::decay_t<T>>;
+
+
+template <typename... Args>
+int format(char* out, size_t outSize, const char* format, [[maybe_unused]] const unsigned char* args) {
+    // braced initialization decodes the arguments in order
+    const std::tuple<typename Arg<Args>::Decoded...> values{Arg<Args>::decode(args)...};
+    return std::apply([&](auto... value) { return snprintf(out, outSize, format, value...); }, values);
+}
+
+
+} // namespace internal
+
+
+template <typename... Args>
+void log(LogLevel level, const char* format, const Args&... args) {
+    if (level < currentLogLevel) {
+        return;
+    }
+
+    // messages with too much argument data are dropped rather than truncated
+    const size_t argsSize = (internal::ArgOf<Args>::size(args) + ... + 0);
+    if (argsSize > internal::maxArgsSize) {
+        internal::countDropped();
+        return;
+    }
+
+    internal::Record* record = internal::acquire();
+    if (record == nullptr) {
+        return;
+    }
+
+    record->formatFn = internal::format<std::decay_t<Args>...>;
+    record->format = format;
+    [[maybe_unused]] unsigned char* cursor = record->args;
+    (internal::ArgOf<Args>::encode(cursor, args), ...);
+
+    internal::commit(record);
+}
 
 
 } // namespace logger
@@ -1,5 +1,6 @@
 
 #include "src/material.h"
+#include "src/hash.h"
 
 
 namespace rt {
@@ -21,88 +22,77 @@ Material::Material()
 }
 
 
-Material::~Material() {
-    Image* image;
+void Material::setAlbedo(RGB_ChannelInfo info) {
+    m_albedoData = info;
+}
 
-    image = std::get_if<Image>(&m_albedoData);
-    if (image) {
-        UnloadImage(*image);
-        image = nullptr;
-    }
 
-    image = std::get_if<Image>(&m_roughnessData);
-    if (image) {
-        UnloadImage(*image);
-        image = nullptr;
-    }
+void Material::setAlbedo(const char* fileName, const TextureOptions& options) {
+    m_albedoData = MaterialTexture::load(fileName, TextureChannels::RGB, options);
 }
 
 
-void Material::setAlbedo(RGB_ChannelInfo info) {
-    if (Image* img = std::get_if<Image>(&m_albedoData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
-    }
-
-    m_albedoData = info;
+void Material::setAlbedo(Image image, const TextureOptions& options) {
+    m_albedoData = MaterialTexture::fromImage(image, TextureChannels::RGB, options);
 }
 
 
-void Material::setAlbedo(const char* fileName) {
-    if (Image* img = std::get_if<Image>(&m_albedoData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
-    }
-
-    setAlbedo(LoadImage(fileName));
+void Material::setRoughness(A_ChannelInfo info) {
+    m_roughnessData = info;
 }
 
 
-void Material::setAlbedo(Image image) {
-    if (Image* img = std::get_if<Image>(&m_albedoData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
-    }
-
-    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8);
-    m_albedoData = image;
+void Material::setRoughness(const char* fileName, const TextureOptions& options) {
+    m_roughnessData = MaterialTexture::load(fileName, TextureChannels::R, options);
 }
 
 
-void Material::setRoughness(A_ChannelInfo info) {
-    if (Image* img = std::get_if<Image>(&m_roughnessData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
-    }
-
-    m_roughnessData = info;
+void Material::setRoughness(Image image, const TextureOptions& options) {
+    m_roughnessData = MaterialTexture::fromImage(image, TextureChannels::R, options);
 }
 
 
-void Material::setRoughness(const char* fileName) {
-    if (Image* img = std::get_if<Image>(&m_roughnessData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
+bool Material::getConstantValue(Vector4& value) const {
+    const RGB_ChannelInfo* albedo = std::get_if<RGB_ChannelInfo>(&m_albedoData);
+    const A_ChannelInfo* roughness = std::get_if<A_ChannelInfo>(&m_roughnessData);
+
+    if (!albedo || !roughness || albedo->deviation != 0.0f || roughness->deviation != 0.0f) {
+        return false;
     }
 
-    setRoughness(LoadImage(fileName));
+    value = {albedo->value.x, albedo->value.y, albedo->value.z, roughness->value};
+    return true;
 }
 
 
-void Material::setRoughness(Image image) {
-    if (Image* img = std::get_if<Image>(&m_roughnessData)) {
-        UnloadImage(*img);
-        img->data = nullptr;
+uint64_t Material::getContentHash() const {
+    // which alternative is held is hashed too, so a value never collides with a texture
+    uint64_t hash = hashValue(m_albedoData.index());
+    hash = hashValue(m_roughnessData.index(), hash);
+
+    if (auto info = std::get_if<RGB_ChannelInfo>(&m_albedoData)) {
+        hash = hashValue(info->value.x, hash);
+        hash = hashValue(info->value.y, hash);
+        hash = hashValue(info->value.z, hash);
+        hash = hashValue(info->deviation, hash);
+    } else if (auto texture = std::get_if<std::shared_ptr<MaterialTexture>>(&m_albedoData)) {
+        hash = hashValue((*texture)->getContentHash(), hash);
+    }
+
+    if (auto info = std::get_if<A_ChannelInfo>(&m_roughnessData)) {
+        hash = hashValue(info->value, hash);
+        hash = hashValue(info->deviation, hash);
+    } else if (auto texture = std::get_if<std::shared_ptr<MaterialTexture>>(&m_roughnessData)) {
+        hash = hashValue((*texture)->getContentHash(), hash);
     }
 
-    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
-    m_roughnessData = image;
+    return hash;
 }
 
 
 Material::BlockInfo Material::getBlockInfo(int blockIndex) const {
-    const std::variant<RGB_ChannelInfo, Image>* variant_RGB = nullptr;
-    const std::variant<A_ChannelInfo, Image>* variant_A = nullptr;
+    const std::variant<RGB_ChannelInfo, std::shared_ptr<MaterialTexture>>* variant_RGB = nullptr;
+    const std::variant<A_ChannelInfo, std::shared_ptr<MaterialTexture>>* variant_A = nullptr;
 
     switch (blockIndex) {
 
@@ -120,8 +110,8 @@ Material::BlockInfo Material::getBlockInfo(int blockIndex) const {
         res.mean = {info->value.x, info->value.y, info->value.z, 0.0};
         res.deviation.x = info->deviation;
         res.useTextures.x = 0.0;
-    } else if (auto image = std::get_if<Image>(variant_RGB)) {
-        res.textures[0] = LoadTextureFromImage(*image);
+    } else if (auto texture = std::get_if<std::shared_ptr<MaterialTexture>>(variant_RGB)) {
+        res.textures[0] = (*texture)->getTexture();
         res.useTextures.x = 1.0;
     }
 
@@ -129,8 +119,8 @@ Material::BlockInfo Material::getBlockInfo(int blockIndex) const {
         res.mean.w = info->value;
         res.deviation.y = info->deviation;
         res.useTextures.y = 0.0;
-    } else if (auto image = std::get_if<Image>(variant_A)) {
-        res.textures[1] = LoadTextureFromImage(*image);
+    } else if (auto texture = std::get_if<std::shared_ptr<MaterialTexture>>(variant_A)) {
+        res.textures[1] = (*texture)->getTexture();
         res.useTextures.y = 1.0;
     }
 
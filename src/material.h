@@ -2,7 +2,9 @@
 #pragma once
 
 
+#include "src/materialtexture.h"
 #include <raylib/raylib.h>
+#include <memory>
 #include <variant>
 #include <string>
 
@@ -26,14 +28,18 @@ class Material {
 
 public:
     Material();
-    ~Material();
     unsigned getId() const { return m_id; }
     void setAlbedo(RGB_ChannelInfo info);
-    void setAlbedo(const char* fileName);
-    void setAlbedo(Image image);
+    // images are decoded and prepared in the background
+    void setAlbedo(const char* fileName, const TextureOptions& options = {});
+    void setAlbedo(Image image, const TextureOptions& options = {});
     void setRoughness(A_ChannelInfo info);
-    void setRoughness(const char* fileName);
-    void setRoughness(Image image);
+    void setRoughness(const char* fileName, const TextureOptions& options = {});
+    void setRoughness(Image image, const TextureOptions& options = {});
+    // albedo and roughness, only when the material looks the same everywhere (no images, no deviation)
+    bool getConstantValue(Vector4& value) const;
+    // equal for materials that pack to the same texels, waits for their images if needed
+    uint64_t getContentHash() const;
 
 private:
     struct BlockInfo {
@@ -48,8 +54,8 @@ private:
 
 private:
     unsigned m_id;
-    std::variant<RGB_ChannelInfo, Image> m_albedoData;
-    std::variant<A_ChannelInfo, Image> m_roughnessData;
+    std::variant<RGB_ChannelInfo, std::shared_ptr<MaterialTexture>> m_albedoData;
+    std::variant<A_ChannelInfo, std::shared_ptr<MaterialTexture>> m_roughnessData;
 
     friend class PackedMaterialData;
 };
@@ -0,0 +1,137 @@
+#include "src/materialregistry.h"
+#include "src/glext.h"
+#include "src/logger.h"
+#include "src/profiler.h"
+#include <algorithm>
+#include <memory>
+
+
+namespace rt {
+
+
+// 8 x 8 cells of 512 x 512 texels, more rows are added when they are all in use
+static constexpr Vector2 atlasSize = {4096, 4096};
+static constexpr Vector2 atlasGridSize = {8, 8};
+static constexpr int cellHeight = atlasSize.y / atlasGridSize.y;
+static_assert(atlasGridSize.x * atlasGridSize.y == MaterialRegistry::initialCellCount);
+
+static std::unique_ptr<MaterialRegistry> instance;
+
+
+MaterialRegistry& MaterialRegistry::get() {
+    if (!instance) {
+        instance.reset(new MaterialRegistry());
+    }
+    return *instance;
+}
+
+
+void MaterialRegistry::shutdown() {
+    instance.reset();
+}
+
+
+MaterialRegistry::MaterialRegistry()
+    : m_packedData(atlasSize, atlasGridSize) {
+    m_cells.resize(m_packedData.getCellCount());
+}
+
+
+MaterialRegistry::~MaterialRegistry() {
+    for (int i = 0; i < (int) m_cells.size(); i++) {
+        if (m_cells[i].refCount > 0) {
+            INFO("Material cell %d is still referenced %d times at shutdown", i, m_cells[i].refCount);
+        }
+    }
+    INFO("Material registry packed %u materials", m_packCount);
+}
+
+
+int MaterialRegistry::acquire(const Material& material) {
+    PROFILE_FUNCTION();
+    const uint64_t hash = material.getContentHash();
+
+    auto it = m_cellsByHash.find(hash);
+    if (it != m_cellsByHash.end()) {
+        Cell& cell = m_cells[it->second];
+        cell.refCount++;
+        TRACE("    Material[ID: %u] reuses cell %d (%d references)", material.getId(), it->second, cell.refCount);
+        return it->second;
+    }
+
+    int index = findFreeCell();
+    if (index < 0 && grow()) {
+        index = findFreeCell();
+    }
+    if (index < 0) {
+        INFO("Material atlas is full (%d cells), Material[ID: %u] cannot be packed", (int) m_cells.size(), material.getId());
+        return -1;
+    }
+
+    Cell& cell = m_cells[index];
+    if (cell.occupied) {
+        TRACE("    Evicting material %016llx from cell %d", (unsigned long long) cell.hash, index);
+        m_cellsByHash.erase(cell.hash);
+    }
+
+    cell.hash = hash;
+    cell.occupied = true;
+    cell.refCount = 1;
+    m_cellsByHash[hash] = index;
+
+    m_packedData.setMaterial(index, material);
+    m_packCount++;
+    m_mipmapsDirty = true;
+    return index;
+}
+
+
+void MaterialRegistry::release(int index) {
+    Cell& cell = m_cells[index];
+    cell.refCount--;
+    cell.lastUse = ++m_useCounter;
+}
+
+
+void MaterialRegistry::finishPacking() {
+    if (m_mipmapsDirty) {
+        m_packedData.generateMipmaps();
+        m_mipmapsDirty = false;
+    }
+}
+
+
+int MaterialRegistry::findFreeCell() const {
+    int best = -1;
+
+    for (int i = 0; i < (int) m_cells.size(); i++) {
+        const Cell& cell = m_cells[i];
+        if (!cell.occupied) {
+            return i;
+        }
+        if (cell.refCount == 0 && (best < 0 || cell.lastUse < m_cells[best].lastUse)) {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+
+bool MaterialRegistry::grow() {
+    const int rows = m_packedData.getGridSize().y;
+    const int maxRows = glext::getInteger(glext::MAX_TEXTURE_SIZE) / cellHeight;
+    const int addedRows = std::min(rows, maxRows - rows);
+    if (addedRows <= 0) {
+        return false;
+    }
+
+    m_packedData.addRows(addedRows);
+    m_cells.resize(m_packedData.getCellCount());
+    // the copy has no mips yet
+    m_mipmapsDirty = true;
+    return true;
+}
+
+
+} // namespace rt
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "src/material.h"
+#include "src/packedmaterialdata.h"
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+
+namespace rt {
+
+
+// one material atlas shared by every compiled scene, materials are keyed by their content
+// so identical materials are packed once, and switching between scenes packs nothing
+// cells nobody references keep their contents until another material needs the space
+class MaterialRegistry {
+
+public:
+    // cells before the atlas first grows
+    static constexpr int initialCellCount = 64;
+
+public:
+    static MaterialRegistry& get();
+    // frees the atlas, every scene has to be unloaded before
+    static void shutdown();
+    ~MaterialRegistry();
+    // returns the material's cell, packing it unless an identical material is already there
+    // the atlas grows when every cell is in use, -1 once it has reached the largest texture size
+    int acquire(const Material& material);
+    void release(int cell);
+    // regenerates the mips if anything was packed since the last call
+    void finishPacking();
+    const PackedMaterialData& getPackedData() const { return m_packedData; }
+    // materials packed so far, reused ones not included
+    unsigned getPackCount() const { return m_packCount; }
+
+private:
+    struct Cell {
+        uint64_t hash = 0;
+        bool occupied = false;
+        int refCount = 0;
+        // for evicting the least recently released cell first
+        uint64_t lastUse = 0;
+    };
+
+private:
+    MaterialRegistry();
+    int findFreeCell() const;
+    // false when the texture cannot get any taller
+    bool grow();
+
+private:
+    PackedMaterialData m_packedData;
+    std::vector<Cell> m_cells;
+    std::unordered_map<uint64_t, int> m_cellsByHash;
+    uint64_t m_useCounter = 0;
+    unsigned m_packCount = 0;
+    bool m_mipmapsDirty = false;
+};
+
+
+} // namespace rt
@@ -0,0 +1,202 @@
+#include "src/materialtexture.h"
+#include "src/blockcompress.h"
+#include "src/glext.h"
+#include "src/hash.h"
+#include "src/logger.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
+#include "src/threadpool.h"
+#include <raylib/rlgl.h>
+#include <algorithm>
+
+
+namespace rt {
+
+
+static bool supportsBC1() {
+    static const bool supported = glext::hasExtension("GL_EXT_texture_compression_s3tc");
+    return supported;
+}
+
+
+std::shared_ptr<MaterialTexture> MaterialTexture::load(const char* fileName, TextureChannels channels, const TextureOptions& options) {
+    TextureOptions usedOptions = options;
+    usedOptions.compress &= channels != TextureChannels::RGB || supportsBC1();
+
+    std::string name = fileName;
+    auto prepared = ThreadPool::get().submit([name, channels, usedOptions]() {
+        PROFILE_SCOPE("decode texture");
+        Image image = LoadImage(name.c_str());
+        if (image.data == nullptr) {
+            INFO("Failed to load texture '%s'", name.c_str());
+        }
+        return prepare(name, image, channels, usedOptions);
+    });
+
+    return std::shared_ptr<MaterialTexture>(new MaterialTexture(std::move(prepared)));
+}
+
+
+std::shared_ptr<MaterialTexture> MaterialTexture::fromImage(Image image, TextureChannels channels, const TextureOptions& options) {
+    TextureOptions usedOptions = options;
+    usedOptions.compress &= channels != TextureChannels::RGB || supportsBC1();
+
+    auto prepared = ThreadPool::get().submit([image, channels, usedOptions]() {
+        return prepare("<image>", image, channels, usedOptions);
+    });
+
+    return std::shared_ptr<MaterialTexture>(new MaterialTexture(std::move(prepared)));
+}
+
+
+MaterialTexture::MaterialTexture(std::future<Prepared> prepared)
+    : m_prepared(std::move(prepared)) {}
+
+
+MaterialTexture::~MaterialTexture() {
+    if (m_uploaded) {
+        UnloadTexture(m_texture);
+        memtrack::remove(memtrack::Kind::Texture, m_texture.id);
+        TRACE("Unloaded material texture [ID: %u]", m_texture.id);
+    } else {
+        // never used, the worker's result still has to be freed
+        Prepared& prepared = wait();
+        memtrack::remove(memtrack::Kind::Host, getHostHandle(prepared));
+        UnloadImage(prepared.image);
+    }
+}
+
+
+Texture MaterialTexture::getTexture() {
+    if (!m_uploaded) {
+        PROFILE_SCOPE("upload texture");
+        upload(wait());
+        m_uploaded = true;
+    }
+    return m_texture;
+}
+
+
+uint64_t MaterialTexture::getContentHash() {
+    return wait().contentHash;
+}
+
+
+MaterialTexture::Prepared& MaterialTexture::wait() {
+    if (m_prepared.valid()) {
+        m_data = m_prepared.get();
+    }
+    return m_data;
+}
+
+
+MaterialTexture::Prepared MaterialTexture::prepare(std::string name, Image image, TextureChannels channels, TextureOptions options) {
+    PROFILE_SCOPE("prepare texture");
+    Prepared prepared;
+    prepared.name = std::move(name);
+
+    if (image.data == nullptr) {
+        return prepared;
+    }
+
+    ImageFormat(&image, channels == TextureChannels::RGB ? PIXELFORMAT_UNCOMPRESSED_R8G8B8 : PIXELFORMAT_UNCOMPRESSED_GRAYSCALE);
+
+    // the same file loaded twice (or two identical images) hash the same, whatever their names
+    prepared.contentHash = hashBytes(image.data, GetPixelDataSize(image.width, image.height, image.format));
+    prepared.contentHash = hashValue(image.width, prepared.contentHash);
+    prepared.contentHash = hashValue(image.height, prepared.contentHash);
+    prepared.contentHash = hashValue(image.format, prepared.contentHash);
+    prepared.contentHash = hashValue(options.mipmaps, prepared.contentHash);
+    prepared.contentHash = hashValue(options.compress, prepared.contentHash);
+
+    if (options.mipmaps) {
+        ImageMipmaps(&image);
+    }
+
+    prepared.width = image.width;
+    prepared.height = image.height;
+
+    if (!options.compress) {
+        prepared.image = image;
+        memtrack::add(memtrack::Kind::Host, getHostHandle(prepared), "material textures", memtrack::getTextureSize(image.width, image.height, image.format, image.mipmaps));
+        return prepared;
+    }
+
+    // levels are stored one after the other
+    const uint8_t* level = (const uint8_t*) image.data;
+    for (int i = 0; i < image.mipmaps; i++) {
+        const int width = std::max(1, image.width >> i);
+        const int height = std::max(1, image.height >> i);
+
+        std::vector<uint8_t>& out = prepared.levels.emplace_back();
+        if (channels == TextureChannels::RGB) {
+            blockcompress::encodeBC1(level, width, height, out);
+        } else {
+            blockcompress::encodeBC4(level, width, height, out);
+        }
+        level += GetPixelDataSize(width, height, image.format);
+    }
+
+    prepared.compressedFormat = channels == TextureChannels::RGB ? glext::COMPRESSED_RGB_S3TC_DXT1 : glext::COMPRESSED_RED_RGTC1;
+    UnloadImage(image);
+
+    size_t compressedBytes = 0;
+    for (const std::vector<uint8_t>& level : prepared.levels) {
+        compressedBytes += level.size();
+    }
+    memtrack::add(memtrack::Kind::Host, getHostHandle(prepared), "material textures", compressedBytes);
+    return prepared;
+}
+
+
+uint64_t MaterialTexture::getHostHandle(const Prepared& prepared) {
+    return prepared.levels.empty() ? (uint64_t) prepared.image.data : (uint64_t) prepared.levels[0].data();
+}
+
+
+void MaterialTexture::upload(Prepared& prepared) {
+    // the pixels are freed or handed to the gpu below
+    memtrack::remove(memtrack::Kind::Host, getHostHandle(prepared));
+    size_t gpuBytes = 0;
+
+    if (prepared.levels.empty()) {
+        if (prepared.image.data == nullptr) {
+            return;
+        }
+        m_texture = LoadTextureFromImage(prepared.image);
+        gpuBytes = memtrack::getTextureSize(m_texture.width, m_texture.height, m_texture.format, m_texture.mipmaps);
+        UnloadImage(prepared.image);
+        prepared.image = {};
+    } else {
+        // raylib has no BC4 format and sizes small BC1 levels differently, so the levels are uploaded here
+        m_texture.id = glext::genTexture();
+        m_texture.width = prepared.width;
+        m_texture.height = prepared.height;
+        m_texture.mipmaps = prepared.levels.size();
+        // closest raylib formats, only used for bookkeeping
+        m_texture.format = prepared.compressedFormat == glext::COMPRESSED_RGB_S3TC_DXT1 ? PIXELFORMAT_COMPRESSED_DXT1_RGB : PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+
+        rlEnableTexture(m_texture.id);
+        for (int i = 0; i < (int) prepared.levels.size(); i++) {
+            const std::vector<uint8_t>& level = prepared.levels[i];
+            const int width = std::max(1, prepared.width >> i);
+            const int height = std::max(1, prepared.height >> i);
+            glext::compressedTexImage2D(i, prepared.compressedFormat, width, height, level.size(), level.data());
+            gpuBytes += level.size();
+        }
+        rlDisableTexture();
+    }
+
+    memtrack::add(memtrack::Kind::Texture, m_texture.id, "material textures", gpuBytes);
+    SetTextureFilter(m_texture, m_texture.mipmaps > 1 ? TEXTURE_FILTER_TRILINEAR : TEXTURE_FILTER_BILINEAR);
+    INFO(
+        "Uploaded material texture '%s' of size = %d x %d with %d mips (%s) [ID: %u]",
+        prepared.name.c_str(), m_texture.width, m_texture.height, m_texture.mipmaps, prepared.levels.empty() ? "uncompressed" : "block compressed", m_texture.id
+    );
+
+    // only the hash is kept around
+    prepared.levels = {};
+}
+
+
+} // namespace rt
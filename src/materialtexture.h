@@ -0,0 +1,71 @@
+#pragma once
+
+#include <raylib/raylib.h>
+#include <future>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace rt {
+
+
+struct TextureOptions {
+    bool mipmaps = true;
+    // BC1 for rgb, BC4 for single channel, encoded on the cpu
+    // (rgb stays uncompressed when the gpu lacks BC1)
+    bool compress = false;
+};
+
+
+enum class TextureChannels {
+    RGB,
+    R,
+};
+
+
+// material image decoded, mipmapped and optionally compressed on the thread pool
+// it is uploaded the first time it is used and then shared by every material and scene holding it
+class MaterialTexture {
+
+public:
+    static std::shared_ptr<MaterialTexture> load(const char* fileName, TextureChannels channels, const TextureOptions& options);
+    // takes ownership of the image
+    static std::shared_ptr<MaterialTexture> fromImage(Image image, TextureChannels channels, const TextureOptions& options);
+    ~MaterialTexture();
+    // waits for the worker if needed, must be called on the thread owning the GL context
+    Texture getTexture();
+    // hash of the decoded pixels and the options, waits for the worker if needed
+    uint64_t getContentHash();
+
+private:
+    struct Prepared {
+        std::string name;
+        int width = 0;
+        int height = 0;
+        // uncompressed data with all the levels, or the compressed levels
+        Image image = {};
+        uint32_t compressedFormat = 0;
+        std::vector<std::vector<uint8_t>> levels;
+        uint64_t contentHash = 0;
+    };
+
+private:
+    MaterialTexture(std::future<Prepared> prepared);
+    static Prepared prepare(std::string name, Image image, TextureChannels channels, TextureOptions options);
+    Prepared& wait();
+    // identifies the prepared pixels to the memory tracker
+    static uint64_t getHostHandle(const Prepared& prepared);
+    void upload(Prepared& prepared);
+
+private:
+    std::future<Prepared> m_prepared;
+    // the worker's result once waited for, its pixels are freed by the upload
+    Prepared m_data;
+    Texture m_texture = {};
+    bool m_uploaded = false;
+};
+
+
+} // namespace rt
@@ -0,0 +1,171 @@
+#include "src/memtrack.h"
+#include "src/logger.h"
+#include <raylib/raylib.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+
+namespace memtrack {
+
+
+struct Allocation {
+    std::string owner;
+    size_t bytes;
+};
+
+
+struct Owner {
+    size_t gpuBytes = 0;
+    size_t hostBytes = 0;
+    size_t peakBytes = 0;
+    int allocations = 0;
+};
+
+
+static std::mutex mutex;
+// keyed by kind too, texture and buffer ids overlap
+static std::map<std::pair<Kind, uint64_t>, Allocation> allocations;
+// ordered by name so the log is stable
+static std::map<std::string, Owner> owners;
+static Totals totals = {};
+static size_t gpuBudget = 0;
+
+
+static double toMegabytes(size_t bytes) {
+    return bytes / (1024.0 * 1024.0);
+}
+
+
+static void account(Kind kind, const std::string& owner, size_t bytes, bool adding) {
+    Owner& stats = owners[owner];
+    size_t& ownerBytes = kind == Kind::Host ? stats.hostBytes : stats.gpuBytes;
+    size_t& totalBytes = kind == Kind::Host ? totals.hostBytes : totals.gpuBytes;
+
+    if (adding) {
+        ownerBytes += bytes;
+        totalBytes += bytes;
+        stats.allocations++;
+    } else {
+        ownerBytes -= bytes;
+        totalBytes -= bytes;
+        stats.allocations--;
+    }
+
+    stats.peakBytes = std::max(stats.peakBytes, stats.gpuBytes + stats.hostBytes);
+    totals.gpuPeak = std::max(totals.gpuPeak, totals.gpuBytes);
+    totals.hostPeak = std::max(totals.hostPeak, totals.hostBytes);
+}
+
+
+static void checkBudget() {
+    if (gpuBudget == 0) {
+        return;
+    }
+
+    if (!totals.overBudget && totals.gpuBytes > gpuBudget) {
+        totals.overBudget = true;
+        INFO("GPU memory budget exceeded: %.1f MB live, budget is %.1f MB", toMegabytes(totals.gpuBytes), toMegabytes(gpuBudget));
+        for (const auto& [name, owner] : owners) {
+            if (owner.gpuBytes > 0) {
+                INFO("    %-24s %8.1f MB", name.c_str(), toMegabytes(owner.gpuBytes));
+            }
+        }
+    } else if (totals.overBudget && totals.gpuBytes <= gpuBudget) {
+        totals.overBudget = false;
+        INFO("GPU memory back within budget: %.1f MB live", toMegabytes(totals.gpuBytes));
+    }
+}
+
+
+void add(Kind kind, uint64_t handle, const std::string& owner, size_t bytes) {
+    if (handle == 0) {
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    auto [it, inserted] = allocations.try_emplace({kind, handle}, Allocation{owner, bytes});
+    if (!inserted) {
+        account(kind, it->second.owner, it->second.bytes, false);
+        it->second = {owner, bytes};
+    }
+    account(kind, owner, bytes, true);
+    TRACE("Tracking %.2f MB for '%s' [ID: %llu]", toMegabytes(bytes), owner.c_str(), (unsigned long long) handle);
+
+    if (kind != Kind::Host) {
+        checkBudget();
+    }
+}
+
+
+void remove(Kind kind, uint64_t handle) {
+    std::lock_guard lock(mutex);
+    auto it = allocations.find({kind, handle});
+    if (it == allocations.end()) {
+        return;
+    }
+
+    account(kind, it->second.owner, it->second.bytes, false);
+    allocations.erase(it);
+
+    if (kind != Kind::Host) {
+        checkBudget();
+    }
+}
+
+
+void setGpuBudget(size_t bytes) {
+    std::lock_guard lock(mutex);
+    gpuBudget = bytes;
+    totals.overBudget = false;
+    checkBudget();
+}
+
+
+Totals getTotals() {
+    std::lock_guard lock(mutex);
+    return totals;
+}
+
+
+std::vector<OwnerStats> getOwners() {
+    std::vector<OwnerStats> out;
+    {
+        std::lock_guard lock(mutex);
+        for (const auto& [name, owner] : owners) {
+            out.push_back({name, owner.gpuBytes, owner.hostBytes, owner.peakBytes, owner.allocations});
+        }
+    }
+
+    std::stable_sort(out.begin(), out.end(), [](const OwnerStats& a, const OwnerStats& b) {
+        return a.gpuBytes + a.hostBytes > b.gpuBytes + b.hostBytes;
+    });
+    return out;
+}
+
+
+void logStats() {
+    const Totals current = getTotals();
+    INFO(
+        "Memory (MB): gpu %.1f (peak %.1f) | host %.1f (peak %.1f)",
+        toMegabytes(current.gpuBytes), toMegabytes(current.gpuPeak), toMegabytes(current.hostBytes), toMegabytes(current.hostPeak)
+    );
+    for (const OwnerStats& owner : getOwners()) {
+        INFO(
+            "    %-24s gpu: %8.1f | host: %8.1f | peak: %8.1f | allocations: %d",
+            owner.owner.c_str(), toMegabytes(owner.gpuBytes), toMegabytes(owner.hostBytes), toMegabytes(owner.peakBytes), owner.allocations
+        );
+    }
+}
+
+
+size_t getTextureSize(int width, int height, int format, int mipmaps) {
+    size_t bytes = 0;
+    for (int i = 0; i < std::max(mipmaps, 1); i++) {
+        bytes += GetPixelDataSize(std::max(1, width >> i), std::max(1, height >> i), format);
+    }
+    return bytes;
+}
+
+
+} // namespace memtrack
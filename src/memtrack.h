@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// live and peak memory per owner ("raytracer", "scene 2", ...)
+// allocations are registered by the code making them, nothing is hooked
+// thread safe, textures can be prepared on the thread pool
+
+
+namespace memtrack {
+
+
+enum class Kind {
+    Texture,
+    Buffer,
+    Host,
+};
+
+
+struct OwnerStats {
+    std::string owner;
+    size_t gpuBytes;
+    size_t hostBytes;
+    // gpu and host together
+    size_t peakBytes;
+    int allocations;
+};
+
+
+struct Totals {
+    size_t gpuBytes;
+    size_t gpuPeak;
+    size_t hostBytes;
+    size_t hostPeak;
+    bool overBudget;
+};
+
+
+// `handle` is the gl id for textures and buffers, the address for host memory
+// adding a handle again replaces its size (e.g. after generating mipmaps)
+void add(Kind kind, uint64_t handle, const std::string& owner, size_t bytes);
+void remove(Kind kind, uint64_t handle);
+// warns once every time gpu usage goes over it, 0 disables the warning
+void setGpuBudget(size_t bytes);
+Totals getTotals();
+// largest live usage first
+std::vector<OwnerStats> getOwners();
+void logStats();
+
+// bytes of a texture with its mip chain (raylib pixel formats)
+size_t getTextureSize(int width, int height, int format, int mipmaps);
+
+
+} // namespace memtrack
@@ -1,6 +1,11 @@
 
 #include "src/packedmaterialdata.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
 #include "src/logger.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
+#include <raylib/rlgl.h>
 
 
 namespace rt {
@@ -9,9 +14,9 @@ namespace rt {
 static unsigned currentId = 0;
 
 
-PackedMaterialData::PackedMaterialData(int materialCount, Vector2 textureSize)
-    : m_id(++currentId), m_materialCount(materialCount), m_textureSize(textureSize) {
-    INFO("Creating materialData with %d materials and of size = %d x %d [ID: %u]", materialCount, (int) m_textureSize.x, (int) m_textureSize.y, m_id);
+PackedMaterialData::PackedMaterialData(Vector2 textureSize, Vector2 gridSize)
+    : m_id(++currentId), m_textureSize(textureSize), m_gridSize(gridSize) {
+    INFO("Creating materialData with %d x %d cells and of size = %d x %d [ID: %u]", (int) m_gridSize.x, (int) m_gridSize.y, (int) m_textureSize.x, (int) m_textureSize.y, m_id);
 
     createFrameBuffer();
     createShader();
@@ -21,59 +26,51 @@ PackedMaterialData::PackedMaterialData(int materialCount, Vector2 textureSize)
 PackedMaterialData::~PackedMaterialData() {
     TRACE("Unloading materialData [ID: %u]", m_id);
     UnloadRenderTexture(m_renderTexture);
+    memtrack::remove(memtrack::Kind::Texture, m_renderTexture.texture.id);
     UnloadShader(m_shader);
 }
 
 
-void PackedMaterialData::setMaterial(int index, const Material& material) {
-    const Vector2 uGridSize = {1.0, (float)m_materialCount};
+void PackedMaterialData::setMaterial(int cell, const Material& material) {
+    PROFILE_FUNCTION();
+    GPU_TIMER_SCOPE("material packing");
+    const int column = cell % (int) m_gridSize.x;
+    const int row = cell / (int) m_gridSize.x;
+    const int cellWidth = m_textureSize.x / m_gridSize.x;
+    const int cellHeight = m_textureSize.y / m_gridSize.y;
 
     BeginShaderMode(m_shader);
-
-    static int uResolution_uniLoc = GetShaderLocation(m_shader, "uResolution");
-    static int uGridSize_uniLoc = GetShaderLocation(m_shader, "uGridSize");
-    static int uCurrent_uniLoc = GetShaderLocation(m_shader, "uCurrent");
-    static int mean_uniLoc = GetShaderLocation(m_shader, "mean");
-    static int deviation_uniLoc = GetShaderLocation(m_shader, "deviation");
-    static int useTextures_uniLoc = GetShaderLocation(m_shader, "useTextures");
-    static int uTextureRGB_uniLoc = GetShaderLocation(m_shader, "uTextureRGB");
-    static int uTextureA_uniLoc = GetShaderLocation(m_shader, "uTextureA");
-
-    SetShaderValue(m_shader, uResolution_uniLoc, &m_textureSize, SHADER_UNIFORM_VEC2);
-    SetShaderValue(m_shader, uGridSize_uniLoc, &uGridSize, SHADER_UNIFORM_VEC2);
-
+    SetShaderValue(m_shader, m_uResolution_uniLoc, &m_textureSize, SHADER_UNIFORM_VEC2);
+    SetShaderValue(m_shader, m_uGridSize_uniLoc, &m_gridSize, SHADER_UNIFORM_VEC2);
     EndShaderMode();
 
     BeginTextureMode(m_renderTexture);
-    BeginBlendMode(BLEND_ADD_COLORS);
+    // replacing instead of adding, cells get reused for other materials
+    rlSetBlendFactors(RL_ONE, RL_ZERO, RL_FUNC_ADD);
+    BeginBlendMode(BLEND_CUSTOM);
 
     for (int i = 0; i < 1; i++) {
         const Material::BlockInfo info = material.getBlockInfo(i);
-        const Vector2 uCurrent = {(float) i, (float) index};
+        const Vector2 uCurrent = {(float) column, (float) row};
 
         BeginShaderMode(m_shader);
-        SetShaderValue(m_shader, uCurrent_uniLoc, &uCurrent, SHADER_UNIFORM_VEC2);
-        SetShaderValue(m_shader, mean_uniLoc, &info.mean, SHADER_UNIFORM_VEC4);
-        SetShaderValue(m_shader, deviation_uniLoc, &info.deviation, SHADER_UNIFORM_VEC2);
-        SetShaderValue(m_shader, useTextures_uniLoc, &info.useTextures, SHADER_UNIFORM_VEC2);
-        SetShaderValueTexture(m_shader, uTextureRGB_uniLoc, info.textures[0]);
-        SetShaderValueTexture(m_shader, uTextureA_uniLoc, info.textures[1]);
-
-        TRACE("    Setting materialIndex = %d with Material[ID: %u]", index, material.getId());
-        TRACE("        Uniform vec2 set [index = %d | uCurrent = (%f %f)]", uCurrent_uniLoc, uCurrent.x, uCurrent.y);
-        TRACE("        Uniform vec4 set [index = %d | mean = (%f %f %f %f)]", mean_uniLoc, info.mean.x, info.mean.y, info.mean.z, info.mean.w);
-        TRACE("        Uniform vec2 set [index = %d | deviation = (%f %f)]", deviation_uniLoc, info.deviation.x, info.deviation.y);
-        TRACE("        Uniform vec2 set [index = %d | useTextures = (%f %f)]", useTextures_uniLoc, info.useTextures.x, info.useTextures.y);
-
-        DrawRectangle(0, 0, m_textureSize.x, m_textureSize.y, RED);
+        SetShaderValue(m_shader, m_uCurrent_uniLoc, &uCurrent, SHADER_UNIFORM_VEC2);
+        SetShaderValue(m_shader, m_mean_uniLoc, &info.mean, SHADER_UNIFORM_VEC4);
+        SetShaderValue(m_shader, m_deviation_uniLoc, &info.deviation, SHADER_UNIFORM_VEC2);
+        SetShaderValue(m_shader, m_useTextures_uniLoc, &info.useTextures, SHADER_UNIFORM_VEC2);
+        SetShaderValueTexture(m_shader, m_uTextureRGB_uniLoc, info.textures[0]);
+        SetShaderValueTexture(m_shader, m_uTextureA_uniLoc, info.textures[1]);
+
+        TRACE("    Setting cell = %d with Material[ID: %u]", cell, material.getId());
+        TRACE("        Uniform vec2 set [index = %d | uCurrent = (%f %f)]", m_uCurrent_uniLoc, uCurrent.x, uCurrent.y);
+        TRACE("        Uniform vec4 set [index = %d | mean = (%f %f %f %f)]", m_mean_uniLoc, info.mean.x, info.mean.y, info.mean.z, info.mean.w);
+        TRACE("        Uniform vec2 set [index = %d | deviation = (%f %f)]", m_deviation_uniLoc, info.deviation.x, info.deviation.y);
+        TRACE("        Uniform vec2 set [index = %d | useTextures = (%f %f)]", m_useTextures_uniLoc, info.useTextures.x, info.useTextures.y);
+
+        // the material keeps its textures, they are shared with every scene using it
+        // only the cell is drawn, raylib's y goes down while the shader's cell rows go up
+        DrawRectangle(column * cellWidth, m_textureSize.y - (row + 1) * cellHeight, cellWidth, cellHeight, RED);
         EndShaderMode();
-
-        if (info.useTextures.x == 1.0) {
-            UnloadTexture(info.textures[0]);
-        }
-        if (info.useTextures.y == 1.0) {
-            UnloadTexture(info.textures[1]);
-        }
     }
 
     EndBlendMode();
@@ -81,14 +78,59 @@ void PackedMaterialData::setMaterial(int index, const Material& material) {
 }
 
 
+void PackedMaterialData::generateMipmaps() {
+    PROFILE_FUNCTION();
+    // neighbouring cells blend in the smallest levels, the raytracer clamps the level it samples
+    GenTextureMipmaps(&m_renderTexture.texture);
+    SetTextureFilter(m_renderTexture.texture, TEXTURE_FILTER_TRILINEAR);
+    trackMemory();
+    TRACE("    Generated %d mips for materialData [ID: %u]", m_renderTexture.texture.mipmaps, m_id);
+}
+
+
+void PackedMaterialData::addRows(int rows) {
+    PROFILE_FUNCTION();
+    const RenderTexture oldTexture = m_renderTexture;
+    const float cellHeight = m_textureSize.y / m_gridSize.y;
+    m_gridSize.y += rows;
+    m_textureSize.y = m_gridSize.y * cellHeight;
+    INFO("Growing materialData to %d x %d cells and of size = %d x %d [ID: %u]", (int) m_gridSize.x, (int) m_gridSize.y, (int) m_textureSize.x, (int) m_textureSize.y, m_id);
+
+    createFrameBuffer();
+    // rows count up from the bottom of the texture, so the old cells land at the same texels
+    glext::copyTexture(oldTexture.texture.id, m_renderTexture.texture.id, oldTexture.texture.width, oldTexture.texture.height);
+    memtrack::remove(memtrack::Kind::Texture, oldTexture.texture.id);
+    UnloadRenderTexture(oldTexture);
+    m_generation++;
+}
+
+
 void PackedMaterialData::createFrameBuffer() {
     m_renderTexture = LoadRenderTexture(m_textureSize.x, m_textureSize.y);
+    trackMemory();
     TRACE("    Created texture for materialData [ID: %u]", m_id);
 }
 
 
+void PackedMaterialData::trackMemory() {
+    const Texture& texture = m_renderTexture.texture;
+    // the color texture and its 24 bit depth buffer (stored as 32 bits) are counted together
+    const size_t bytes = memtrack::getTextureSize(texture.width, texture.height, texture.format, texture.mipmaps) + (size_t) texture.width * texture.height * 4;
+    memtrack::add(memtrack::Kind::Texture, texture.id, TextFormat("materialData %u", m_id), bytes);
+}
+
+
 void PackedMaterialData::createShader() {
     m_shader = LoadShader(nullptr, "shaders/packedmaterialgen.glsl");
+
+    m_uResolution_uniLoc = GetShaderLocation(m_shader, "uResolution");
+    m_uGridSize_uniLoc = GetShaderLocation(m_shader, "uGridSize");
+    m_uCurrent_uniLoc = GetShaderLocation(m_shader, "uCurrent");
+    m_mean_uniLoc = GetShaderLocation(m_shader, "mean");
+    m_deviation_uniLoc = GetShaderLocation(m_shader, "deviation");
+    m_useTextures_uniLoc = GetShaderLocation(m_shader, "useTextures");
+    m_uTextureRGB_uniLoc = GetShaderLocation(m_shader, "uTextureRGB");
+    m_uTextureA_uniLoc = GetShaderLocation(m_shader, "uTextureA");
 }
 
 
@@ -1,3 +1,4 @@
+#pragma once
 
 #include "src/material.h"
 #include <raylib/raylib.h>
@@ -6,26 +7,45 @@
 namespace rt {
 
 
+// materials packed into cells of a single texture, one material per cell
 class PackedMaterialData {
 
 public:
-    PackedMaterialData(int materialCount, Vector2 textureSize);
+    PackedMaterialData(Vector2 textureSize, Vector2 gridSize);
     ~PackedMaterialData();
     unsigned getId() const { return m_id; }
-    void setMaterial(int index, const Material& material);
+    // overwrites whatever the cell held before
+    void setMaterial(int cell, const Material& material);
+    // call once the materials are set
+    void generateMipmaps();
+    // adds rows of cells above the existing ones, which keep their index and contents (mips have to be regenerated)
+    void addRows(int rows);
+    // changes whenever the texture is replaced
+    unsigned getGeneration() const { return m_generation; }
     int getTextureId() const { return m_renderTexture.texture.id; }
-    int getMaterialCount() const { return m_materialCount; }
+    Vector2 getGridSize() const { return m_gridSize; }
+    int getCellCount() const { return m_gridSize.x * m_gridSize.y; }
 
 private:
     void createFrameBuffer();
+    void trackMemory();
     void createShader();
 
 private:
     unsigned m_id;
-    int m_materialCount;
+    unsigned m_generation = 0;
     Vector2 m_textureSize;
+    Vector2 m_gridSize;
     RenderTexture m_renderTexture;
     Shader m_shader;
+    int m_uResolution_uniLoc;
+    int m_uGridSize_uniLoc;
+    int m_uCurrent_uniLoc;
+    int m_mean_uniLoc;
+    int m_deviation_uniLoc;
+    int m_useTextures_uniLoc;
+    int m_uTextureRGB_uniLoc;
+    int m_uTextureA_uniLoc;
 };
 
 
@@ -0,0 +1,158 @@
+#include "src/primitiveencoding.h"
+#include "src/profiler.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+
+namespace primitiveencoding {
+
+
+// largest finite half float
+static const uint16_t halfMax = 0x7bff;
+
+
+static uint32_t packHalf2(Vector2 value) {
+    return toHalf(value.x) | ((uint32_t) toHalf(value.y) << 16);
+}
+
+
+// material cells past 16 bits are clamped, the atlas never gets that large
+static uint32_t packRadiusMaterial(float radius, float materialIndex) {
+    const uint32_t cell = std::min<uint32_t>(materialIndex, 0xffff);
+    return toHalf(radius) | (cell << 16);
+}
+
+
+// x in bits 0 - 20 of the first word, y in bits 21 - 31 and 0 - 9, z in bits 10 - 30 of the second
+static void quantize(Vector3 position, const QuantizationBounds& bounds, uint32_t out[2]) {
+    const auto axis = [&](float value, float origin, float scale) {
+        const float steps = roundf((value - origin) / scale);
+        return (uint32_t) std::clamp(steps, 0.0f, (float) quantizedSteps);
+    };
+    const uint32_t x = axis(position.x, bounds.origin.x, bounds.scale.x);
+    const uint32_t y = axis(position.y, bounds.origin.y, bounds.scale.y);
+    const uint32_t z = axis(position.z, bounds.origin.z, bounds.scale.z);
+
+    out[0] = x | (y << 21);
+    out[1] = (y >> 11) | (z << 10);
+}
+
+
+static rt::internal::TriangleAttributes getAttributes(const rt::internal::Triangle& triangle) {
+    return {
+        .uvs = {packHalf2(triangle.uv0), packHalf2(triangle.uv1), packHalf2(triangle.uv2)},
+        .materialIndex = (uint32_t) triangle.materialIndex,
+    };
+}
+
+
+uint16_t toHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(float));
+    const uint16_t sign = (bits >> 16) & 0x8000;
+    const int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) {
+        // infinity stays one, nan stays nan
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {
+        return sign | halfMax;
+    }
+
+    if (exponent <= 0) {
+        // subnormal, or too small for one
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        const uint32_t half = (mantissa >> shift) + ((mantissa >> (shift - 1)) & 1);
+        return sign | half;
+    }
+
+    // rounded to nearest, a carry into the exponent is still the right value
+    const uint32_t half = ((uint32_t) exponent << 10 | (mantissa >> 13)) + ((mantissa >> 12) & 1);
+    return sign | std::min<uint32_t>(half, halfMax);
+}
+
+
+QuantizationBounds getBounds(const std::vector<rt::internal::Sphere>& spheres, const std::vector<rt::internal::Triangle>& triangles) {
+    Vector3 min = {FLT_MAX, FLT_MAX, FLT_MAX};
+    Vector3 max = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+    const auto add = [&](Vector3 point) {
+        min = {std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z)};
+        max = {std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z)};
+    };
+
+    for (const rt::internal::Sphere& sphere : spheres) {
+        add(sphere.position);
+    }
+    for (const rt::internal::Triangle& triangle : triangles) {
+        add(triangle.v0);
+        add(triangle.v1);
+        add(triangle.v2);
+    }
+
+    if (spheres.empty() && triangles.empty()) {
+        return {{0, 0, 0}, {1, 1, 1}};
+    }
+
+    // flat axes still need a non-zero step
+    const auto step = [](float extent) { return std::max(extent, 1e-6f) / quantizedSteps; };
+    return {min, {step(max.x - min.x), step(max.y - min.y), step(max.z - min.z)}};
+}
+
+
+void encode(const rt::internal::Sphere* spheres, size_t count, std::vector<rt::internal::CompactSphere>& out) {
+    PROFILE_FUNCTION();
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        out[i].position = spheres[i].position;
+        out[i].radiusMaterial = packRadiusMaterial(spheres[i].radius, spheres[i].materialIndex);
+    }
+}
+
+
+void encode(const rt::internal::Sphere* spheres, size_t count, const QuantizationBounds& bounds, std::vector<rt::internal::QuantizedSphere>& out) {
+    PROFILE_FUNCTION();
+    out.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        quantize(spheres[i].position, bounds, out[i].position);
+        out[i].radiusMaterial = packRadiusMaterial(spheres[i].radius, spheres[i].materialIndex);
+    }
+}
+
+
+void encode(const rt::internal::Triangle* triangles, size_t count, std::vector<rt::internal::CompactTriangle>& out, std::vector<rt::internal::TriangleAttributes>& attributes) {
+    PROFILE_FUNCTION();
+    out.resize(count);
+    attributes.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const rt::internal::Triangle& triangle = triangles[i];
+        out[i].v0 = triangle.v0;
+        out[i].edge1 = {triangle.v1.x - triangle.v0.x, triangle.v1.y - triangle.v0.y, triangle.v1.z - triangle.v0.z};
+        out[i].edge2 = {triangle.v2.x - triangle.v0.x, triangle.v2.y - triangle.v0.y, triangle.v2.z - triangle.v0.z};
+        attributes[i] = getAttributes(triangle);
+    }
+}
+
+
+void encode(const rt::internal::Triangle* triangles, size_t count, const QuantizationBounds& bounds, std::vector<rt::internal::QuantizedTriangle>& out, std::vector<rt::internal::TriangleAttributes>& attributes) {
+    PROFILE_FUNCTION();
+    out.resize(count);
+    attributes.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const rt::internal::Triangle& triangle = triangles[i];
+        quantize(triangle.v0, bounds, out[i].vertices[0]);
+        quantize(triangle.v1, bounds, out[i].vertices[1]);
+        quantize(triangle.v2, bounds, out[i].vertices[2]);
+        attributes[i] = getAttributes(triangle);
+    }
+}
+
+
+} // namespace primitiveencoding
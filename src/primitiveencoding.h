@@ -0,0 +1,37 @@
+#pragma once
+
+#include "src/structs/objects.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+// conversion of spheres and triangles into the smaller layouts of rt::internal
+// radii and uvs become half floats and material cells 16 bit, quantized positions are relative to the scene bounds
+
+
+namespace primitiveencoding {
+
+
+// steps per axis of a quantized position
+constexpr uint32_t quantizedSteps = (1u << 21) - 1;
+
+
+// position = origin + quantized * scale
+struct QuantizationBounds {
+    Vector3 origin;
+    Vector3 scale;
+};
+
+
+uint16_t toHalf(float value);
+// covers every sphere center and triangle vertex
+QuantizationBounds getBounds(const std::vector<rt::internal::Sphere>& spheres, const std::vector<rt::internal::Triangle>& triangles);
+
+void encode(const rt::internal::Sphere* spheres, size_t count, std::vector<rt::internal::CompactSphere>& out);
+void encode(const rt::internal::Sphere* spheres, size_t count, const QuantizationBounds& bounds, std::vector<rt::internal::QuantizedSphere>& out);
+void encode(const rt::internal::Triangle* triangles, size_t count, std::vector<rt::internal::CompactTriangle>& out, std::vector<rt::internal::TriangleAttributes>& attributes);
+void encode(const rt::internal::Triangle* triangles, size_t count, const QuantizationBounds& bounds, std::vector<rt::internal::QuantizedTriangle>& out, std::vector<rt::internal::TriangleAttributes>& attributes);
+
+
+} // namespace primitiveencoding
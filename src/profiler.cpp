@@ -0,0 +1,130 @@
+#include "src/profiler.h"
+#include "src/logger.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <vector>
+
+
+namespace profiler {
+
+
+#ifdef ENABLE_PROFILER
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    uint64_t end;
+};
+
+
+// every thread appends to its own buffer without locking
+// buffers are shared with the registry so they outlive their thread
+struct ThreadBuffer {
+    unsigned threadId;
+    const char* threadName = nullptr;
+    std::vector<Event> events;
+};
+
+
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<ThreadBuffer>> registry;
+static const auto startTime = std::chrono::steady_clock::now();
+
+
+static ThreadBuffer& getThreadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+
+    if (!buffer) {
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.reserve(1 << 14);
+
+        std::lock_guard lock(registryMutex);
+        buffer->threadId = registry.size() + 1;
+        registry.push_back(buffer);
+    }
+
+    return *buffer;
+}
+
+
+uint64_t now() {
+    const auto elapsed = std::chrono::steady_clock::now() - startTime;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+
+void record(const char* name, uint64_t start, uint64_t end) {
+    getThreadBuffer().events.push_back({name, start, end});
+}
+
+
+void setThreadName(const char* name) {
+    getThreadBuffer().threadName = name;
+}
+
+
+bool writeTrace(const char* fileName) {
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for writing the trace", fileName);
+        return false;
+    }
+
+    // buffers are read without their threads' cooperation, so this is meant to run when workers are idle (e.g. at exit)
+    std::lock_guard lock(registryMutex);
+    size_t numEvents = 0;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    bool first = true;
+
+    for (const auto& buffer : registry) {
+        if (buffer->threadName) {
+            fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer->threadId, buffer->threadName);
+            first = false;
+        }
+
+        const size_t count = buffer->events.size();
+        for (size_t i = 0; i < count; i++) {
+            const Event& event = buffer->events[i];
+            // timestamps are in microseconds, keeping the nanoseconds as fraction
+            fprintf(
+                file, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                first ? "" : ",\n", event.name, buffer->threadId, event.start / 1000.0, (event.end - event.start) / 1000.0
+            );
+            first = false;
+        }
+        numEvents += count;
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    INFO("Wrote %u profiler events to '%s'", (unsigned) numEvents, fileName);
+    return true;
+}
+
+#else
+
+// nothing is recorded, so no thread gets a buffer
+uint64_t now() {
+    return 0;
+}
+
+
+void record(const char*, uint64_t, uint64_t) {}
+
+
+void setThreadName(const char*) {}
+
+
+bool writeTrace(const char* fileName) {
+    INFO("Profiler is compiled out, not writing '%s' (build with -DENABLE_PROFILER)", fileName);
+    return false;
+}
+
+#endif
+
+
+} // namespace profiler
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+
+// scoped host profiler writing chrome trace-event json (chrome://tracing, ui.perfetto.dev)
+// compiled away unless ENABLE_PROFILER is defined, e.g. `make DEFINES=-DENABLE_PROFILER`
+// scope names must be string literals, only the pointer is stored
+
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#ifdef ENABLE_PROFILER
+    #define PROFILE_SCOPE(name) profiler::Scope PROFILER_CONCAT(profilerScope_, __LINE__)(name)
+    #define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+    #define PROFILE_THREAD_NAME(name) profiler::setThreadName(name)
+#else
+    #define PROFILE_SCOPE(name) ((void) 0)
+    #define PROFILE_FUNCTION() ((void) 0)
+    #define PROFILE_THREAD_NAME(name) ((void) 0)
+#endif
+
+
+namespace profiler {
+
+
+// nanoseconds since program start
+uint64_t now();
+void record(const char* name, uint64_t start, uint64_t end);
+void setThreadName(const char* name);
+// other threads should not be recording while the trace is written
+bool writeTrace(const char* fileName);
+
+
+class Scope {
+
+public:
+    Scope(const char* name) : m_name(name), m_start(now()) {}
+    ~Scope() { record(m_name, m_start, now()); }
+
+private:
+    const char* m_name;
+    uint64_t m_start;
+};
+
+
+} // namespace profiler
@@ -1,6 +1,12 @@
 
 #include "src/raytracer.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
 #include "src/logger.h"
+#include "src/materialregistry.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
+#include <raylib/raymath.h>
 #include <raylib/rlgl.h>
 
 
@@ -8,60 +14,435 @@
     rlGetLocationUniform(m_computeShaderProgram, TextFormat(fmt, ##__VA_ARGS__));
 
 
+// size of the uniform array used by constant-material variants, indexed by atlas cell
+// scenes with cells past the atlas' initial grid sample the texture instead
+static const int maxMaterialConstants = rt::MaterialRegistry::initialCellCount;
+// texture unit of the packed material texture during dispatch
+static const int materialTextureUnit = 1;
+// texture unit and buffer binding of the environment map and its sampling tables
+static const int environmentTextureUnit = 2;
+static const int environmentBufferBinding = 5;
+
+static const char* shaderPath = "shaders/raytracer.glsl";
+// bindings of the ray statistics, unused by everything else
+static const int statsImageUnit = 5;
+static const int statsBufferBinding = 4;
+// uvs and materials of compact and quantized triangles
+static const int triangleAttributesBinding = 6;
+// seconds between checks of the shader file for edits
+static const float shaderWatchInterval = 0.5f;
+
+
+// bytes per sphere and per triangle (attributes included) of a primitive format
+static uint32_t getSphereSize(PrimitiveFormat format) {
+    switch (format) {
+        case PrimitiveFormat::Compact: return sizeof(rt::internal::CompactSphere);
+        case PrimitiveFormat::Quantized: return sizeof(rt::internal::QuantizedSphere);
+        default: return sizeof(rt::internal::Sphere);
+    }
+}
+
+
+static uint32_t getTriangleSize(PrimitiveFormat format) {
+    switch (format) {
+        case PrimitiveFormat::Compact: return sizeof(rt::internal::CompactTriangle);
+        case PrimitiveFormat::Quantized: return sizeof(rt::internal::QuantizedTriangle);
+        default: return sizeof(rt::internal::Triangle);
+    }
+}
+
+
+static const char* getFormatName(PrimitiveFormat format) {
+    switch (format) {
+        case PrimitiveFormat::Compact: return "compact";
+        case PrimitiveFormat::Quantized: return "quantized";
+        default: return "full";
+    }
+}
+
+
+// what a multi-view render or the uniform buffers leave out
+static ComputeShaderParams getSupportedParams(const ComputeShaderParams& params) {
+    ComputeShaderParams supported = params;
+    supported.numViews = std::max(params.numViews, 1u);
+
+    if (supported.numViews > 1 && (params.writeAOVs || params.collectStats)) {
+        INFO("Rendering %u views without AOVs and ray statistics", supported.numViews);
+        supported.writeAOVs = false;
+        supported.collectStats = false;
+    }
+    if (supported.storageType == SceneStorageType::UBO && supported.primitiveFormat != PrimitiveFormat::Full) {
+        INFO("Uniform buffers only hold the full primitive format");
+        supported.primitiveFormat = PrimitiveFormat::Full;
+    }
+    return supported;
+}
+
+
+bool ShaderVariant::canRender(const ShaderVariant& other) const {
+    // the sample count only changes the convergence speed, the image stays the same
+    return (hasSpheres || !other.hasSpheres)
+        && (hasTriangles || !other.hasTriangles)
+        && (environmentMap || !other.environmentMap)
+        && (!constantMaterials || other.constantMaterials)
+        && (bounceLimit == 0 || bounceLimit == other.bounceLimit);
+}
+
+
+std::string ShaderVariant::getName() const {
+    std::string name;
+    name += hasSpheres ? "spheres " : "";
+    name += hasTriangles ? "triangles " : "";
+    name += environmentMap ? "env " : "";
+    name += constantMaterials ? "const-mat " : "";
+    name += bounceLimit > 0 ? TextFormat("b%d ", bounceLimit) : "";
+    name += numSamples > 0 ? TextFormat("s%d ", numSamples) : "";
+
+    if (name == "spheres triangles env ") {
+        return "generic";
+    }
+    return name.empty() ? "empty" : name.substr(0, name.size() - 1);
+}
+
+
 Raytracer::Raytracer(Vector2 textureSize, const ComputeShaderParams& shaderParams)
-    : m_textureSize(textureSize), m_shaderParams(shaderParams) {
+    : m_textureSize(textureSize), m_shaderParams(getSupportedParams(shaderParams)), m_specialized(shaderParams.specializeVariants) {
 
+    m_viewCameras.resize(m_shaderParams.numViews);
     makeTexture();
     makeBuffers();
-    compileComputeShader();
+    // the program is picked on the first dispatch, once the scene and config are known
+    m_shaderModTime = GetFileModTime(shaderPath);
 }
 
 
 Raytracer::~Raytracer() {
-    rlUnloadShaderProgram(m_computeShaderProgram);
-    TRACE("Unloaded compute shader program [ID: %u]", m_computeShaderProgram);
+    for (const auto& [name, program] : m_programs) {
+        rlUnloadShaderProgram(program);
+        TRACE("Unloaded compute shader program '%s' [ID: %u]", name.c_str(), program);
+    }
 
-    UnloadTexture(m_outTexture);
-    TRACE("Unloaded out texture [ID: %u]", m_outTexture.id);
+    unloadTextures();
+    unloadBuffers();
+}
+
+
+void Raytracer::resize(Vector2 textureSize) {
+    if (textureSize.x == m_textureSize.x && textureSize.y == m_textureSize.y) {
+        return;
+    }
+
+    INFO("Resizing raytracer from %d x %d to %d x %d", (int) m_textureSize.x, (int) m_textureSize.y, (int) textureSize.x, (int) textureSize.y);
+    unloadTextures();
+    m_textureSize = textureSize;
+    makeTexture();
+
+    // history of a different resolution cannot be reprojected
+    reset();
+}
+
+
+void Raytracer::setRegion(Vector2 offset, Vector2 fullSize) {
+    m_regionOffset = offset;
+    m_regionSize = fullSize;
+    // the history belongs to the previous region
+    reset();
 }
 
 
 void Raytracer::setCamera(const rt::Camera& camera) {
-    static int invViewMat_uniLoc = getUniLoc("camera.invViewMat");
-    static int invProjMat_uniLoc = getUniLoc("camera.invProjMat");
-    static int position_uniLoc = getUniLoc("camera.position");
+    m_camera = camera;
+    m_viewCameras[0] = camera;
+    m_cameraChanged = true;
+    m_cameraDirty = true;
+}
 
-    rlEnableShader(m_computeShaderProgram);
 
-    rlSetUniformMatrix(invViewMat_uniLoc, camera.invViewMat);
-    rlSetUniformMatrix(invProjMat_uniLoc, camera.invProjMat);
-    rlSetUniform(position_uniLoc, &camera.position, RL_SHADER_UNIFORM_VEC3, 1);
+void Raytracer::setCameras(const std::vector<rt::Camera>& cameras) {
+    const size_t numCameras = std::min(cameras.size(), m_viewCameras.size());
+    for (size_t i = 0; i < numCameras; i++) {
+        m_viewCameras[i] = cameras[i];
+    }
+
+    m_camera = m_viewCameras[0];
+    m_cameraChanged = true;
+    m_cameraDirty = true;
 }
 
 
 void Raytracer::setScene(const rt::CompiledScene& scene) {
     INFO("Setting scene [ID: %u]", scene.getId());
+    m_scene = &scene;
+    m_sceneDirty = true;
+}
+
+
+void Raytracer::clearScene() {
+    m_scene = nullptr;
+    m_sceneDirty = false;
+}
+
+
+void Raytracer::setConfig(const rt::Config& config) {
+    INFO("Setting configuration: {numSamples: %d, bounceLimit: %d}", (int) config.numSamples, (int) config.bounceLimit);
+    m_config = config;
+    m_configDirty = true;
+}
+
+
+void Raytracer::setSpecialized(bool specialized) {
+    INFO("Shader specialization %s", specialized ? "enabled" : "disabled");
+    m_specialized = specialized;
+}
+
+
+ShaderVariant Raytracer::chooseVariant(const ComputeShaderParams& params) const {
+    ShaderVariant variant;
+    if (!m_specialized || m_scene == nullptr) {
+        return variant;
+    }
+
+    const size_t numMaterialConstants = m_scene->m_constantMaterials.size();
+    variant.hasSpheres = !m_scene->m_spheres.empty() && params.maxSphereCount > 0;
+    variant.hasTriangles = !m_scene->m_triangles.empty() && params.maxTriangleCount > 0;
+    variant.environmentMap = m_scene->m_environment != nullptr;
+    variant.constantMaterials = numMaterialConstants > 0 && numMaterialConstants <= maxMaterialConstants;
+    variant.bounceLimit = m_config.bounceLimit;
+    variant.numSamples = m_config.numSamples;
+
+    // fall back to the generic shader when the specialized one does not compile
+    if (m_failedVariants.count(variant.getName()) != 0) {
+        return ShaderVariant{};
+    }
+    return variant;
+}
+
+
+bool Raytracer::updateProgram() {
+    watchShaderSource();
+
+    if (m_pendingRebuild && m_pendingRebuild->program->isReady()) {
+        finishRebuild();
+    }
+
+    for (auto it = m_pendingVariants.begin(); it != m_pendingVariants.end();) {
+        if (!it->second.program->isReady()) {
+            it++;
+            continue;
+        }
+
+        const uint32_t program = finishCompile(it->second);
+        if (program != 0) {
+            m_programs[it->first] = program;
+        } else {
+            m_failedVariants.insert(it->first);
+        }
+        it = m_pendingVariants.erase(it);
+    }
+
+    const ShaderVariant variant = chooseVariant(m_shaderParams);
+    const std::string name = variant.getName();
+    auto it = m_programs.find(name);
+
+    if (it == m_programs.end()) {
+        if (m_pendingVariants.count(name) == 0) {
+            m_pendingVariants.emplace(name, startCompile(m_shaderParams, variant));
+        }
+
+        if (m_computeShaderProgram == 0) {
+            // nothing to render with yet (first frame), so this one is waited for
+            const uint32_t program = finishCompile(m_pendingVariants.at(name));
+            m_pendingVariants.erase(name);
+            if (program == 0) {
+                m_failedVariants.insert(name);
+                return false;
+            }
+            it = m_programs.emplace(name, program).first;
+        } else if (!m_variant.canRender(variant)) {
+            // the current program would render a different image, the last frame stays on screen
+            return false;
+        }
+    }
+
+    if (it != m_programs.end() && name != m_variantName) {
+        useProgram(variant, it->second);
+    }
+
     rlEnableShader(m_computeShaderProgram);
 
+    // the atlas grew for a scene compiled since, its grid size changed
+    if (m_scene != nullptr && m_scene->m_materialData->getGeneration() != m_materialGeneration) {
+        m_sceneDirty = true;
+    }
+    if (m_cameraDirty) {
+        applyCamera();
+    }
+    if (m_sceneDirty) {
+        applyScene();
+    }
+    if (m_configDirty) {
+        applyConfig();
+    }
+    return true;
+}
+
+
+void Raytracer::useProgram(const ShaderVariant& variant, uint32_t program) {
+    m_computeShaderProgram = program;
+    m_variant = variant;
+    m_variantName = variant.getName();
+    m_variantTimerName = "variant: " + m_variantName;
+    INFO("Using compute shader variant '%s' [ID: %u]", m_variantName.c_str(), m_computeShaderProgram);
+
+    // uniforms belong to the program, a different one has none of them set
+    m_cameraDirty = true;
+    m_sceneDirty = m_scene != nullptr;
+    m_configDirty = true;
+}
+
+
+void Raytracer::setShaderParams(const ComputeShaderParams& params) {
+    INFO("Rebuilding compute shader for new parameters");
+    startRebuild(getSupportedParams(params));
+}
+
+
+void Raytracer::reloadShader() {
+    INFO("Reloading '%s'", shaderPath);
+    startRebuild(m_pendingRebuild ? m_pendingParams : m_shaderParams);
+}
+
+
+void Raytracer::watchShaderSource() {
+    const float now = GetTime();
+    if (now - m_lastWatchTime < shaderWatchInterval) {
+        return;
+    }
+    m_lastWatchTime = now;
+
+    const long modTime = GetFileModTime(shaderPath);
+    if (modTime != m_shaderModTime) {
+        m_shaderModTime = modTime;
+        reloadShader();
+    }
+}
+
+
+void Raytracer::startRebuild(const ComputeShaderParams& params) {
+    // a rebuild still in flight is superseded
+    m_pendingParams = params;
+    m_pendingRebuild = std::make_unique<PendingCompile>(startCompile(params, chooseVariant(params)));
+}
+
+
+void Raytracer::finishRebuild() {
+    const ShaderVariant variant = m_pendingRebuild->variant;
+    const uint32_t program = finishCompile(*m_pendingRebuild);
+    m_pendingRebuild.reset();
+
+    if (program == 0) {
+        INFO("Keeping the previous compute shader");
+        return;
+    }
+
+    // every other variant was built from the old source or parameters
+    for (const auto& [oldName, oldProgram] : m_programs) {
+        rlUnloadShaderProgram(oldProgram);
+        TRACE("Unloaded compute shader program '%s' [ID: %u]", oldName.c_str(), oldProgram);
+    }
+    m_programs.clear();
+    m_pendingVariants.clear();
+    m_failedVariants.clear();
+
+    applyShaderParams(m_pendingParams);
+
+    m_programs.emplace(variant.getName(), program);
+    useProgram(variant, program);
+}
+
+
+void Raytracer::applyShaderParams(const ComputeShaderParams& params) {
+    const ComputeShaderParams& old = m_shaderParams;
+    const bool buffersChanged = params.storageType != old.storageType || params.maxSphereCount != old.maxSphereCount || params.maxTriangleCount != old.maxTriangleCount
+        || params.primitiveFormat != old.primitiveFormat;
+    const bool texturesChanged = params.writeAOVs != old.writeAOVs || params.maxHistoryLength != old.maxHistoryLength || params.collectStats != old.collectStats
+        || params.numViews != old.numViews;
+
+    // unloading depends on the old parameters
+    if (texturesChanged) {
+        unloadTextures();
+    }
+    if (buffersChanged) {
+        unloadBuffers();
+    }
+
+    m_shaderParams = params;
+    // added views start out with the first view's camera
+    m_viewCameras.resize(params.numViews, m_camera);
+
+    if (texturesChanged) {
+        makeTexture();
+        reset();
+    }
+    if (buffersChanged) {
+        makeBuffers();
+    }
+}
+
+
+void Raytracer::applyCamera() {
+    const bool multiView = m_shaderParams.numViews > 1;
+
+    for (uint32_t i = 0; i < m_viewCameras.size(); i++) {
+        const rt::Camera& camera = m_viewCameras[i];
+        // copying the base, since textformat allocates internally
+        char base[64];
+        TextCopy(base, multiView ? TextFormat("cameras[%u]", i) : "camera");
+
+        const int invViewMat_uniLoc = getUniLoc("%s.invViewMat", base);
+        const int invProjMat_uniLoc = getUniLoc("%s.invProjMat", base);
+        const int position_uniLoc = getUniLoc("%s.position", base);
+
+        rlSetUniformMatrix(invViewMat_uniLoc, camera.invViewMat);
+        rlSetUniformMatrix(invProjMat_uniLoc, camera.invProjMat);
+        rlSetUniform(position_uniLoc, &camera.position, RL_SHADER_UNIFORM_VEC3, 1);
+    }
+
+    m_cameraDirty = false;
+}
+
+
+void Raytracer::applyScene() {
+    PROFILE_FUNCTION();
+    GPU_TIMER_SCOPE("scene upload");
+    const rt::CompiledScene& scene = *m_scene;
+    TRACE("Uploading scene [ID: %u] to compute shader [ID: %u]", scene.getId(), m_computeShaderProgram);
+
     setScene_materials(scene);
+    if (m_shaderParams.primitiveFormat == PrimitiveFormat::Quantized) {
+        setScene_quantization(scene);
+    }
     setScene_spheres(scene);
     setScene_triangles(scene);
+    setScene_environment(scene);
 
     const int backgroundColor_uniLoc = getUniLoc("sceneInfo.backgroundColor");
     rlSetUniform(backgroundColor_uniLoc, &scene.m_backgroundColor, RL_SHADER_UNIFORM_VEC3, 1);
     TRACE("    backgroundColor = (%f %f %f)", scene.m_backgroundColor.x, scene.m_backgroundColor.y, scene.m_backgroundColor.z);
-}
 
+    m_sceneDirty = false;
+}
 
-void Raytracer::setConfig(const rt::Config& config) {
-    INFO("Setting configuration: {numSamples: %d, bounceLimit: %d}", (int) config.numSamples, (int) config.bounceLimit);
-    rlEnableShader(m_computeShaderProgram);
 
+void Raytracer::applyConfig() {
+    // baked in by specialized variants, so these may not exist
     const int numSamples_uniLoc = getUniLoc("config.numSamples");
-    rlSetUniform(numSamples_uniLoc, &config.numSamples, RL_SHADER_UNIFORM_FLOAT, 1);
+    rlSetUniform(numSamples_uniLoc, &m_config.numSamples, RL_SHADER_UNIFORM_FLOAT, 1);
 
     const int bounceLimit_uniLoc = getUniLoc("config.bounceLimit");
-    rlSetUniform(bounceLimit_uniLoc, &config.bounceLimit, RL_SHADER_UNIFORM_FLOAT, 1);
+    rlSetUniform(bounceLimit_uniLoc, &m_config.bounceLimit, RL_SHADER_UNIFORM_FLOAT, 1);
+
+    m_configDirty = false;
 }
 
 
@@ -70,9 +451,19 @@ bool Raytracer::saveImage(const char* fileName) const {
 
     float startTime = GetTime();
 
-    Image img = LoadImageFromTexture(m_outTexture);
-    bool saved = ExportImage(img, fileName);
-    UnloadImage(img);
+    bool saved;
+    if (m_shaderParams.numViews > 1) {
+        // raylib cannot read array textures, the views are stacked top to bottom
+        const int height = m_textureSize.y * m_shaderParams.numViews;
+        std::vector<unsigned char> pixels((size_t) m_textureSize.x * height * 4);
+        readPixels(glext::UNSIGNED_BYTE, pixels.data());
+        const Image img = {pixels.data(), (int) m_textureSize.x, height, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+        saved = ExportImage(img, fileName);
+    } else {
+        Image img = LoadImageFromTexture(m_outTexture);
+        saved = ExportImage(img, fileName);
+        UnloadImage(img);
+    }
 
     float stopTime = GetTime();
 
@@ -83,18 +474,192 @@ bool Raytracer::saveImage(const char* fileName) const {
 }
 
 
+void Raytracer::readPixels(uint32_t type, void* pixels) const {
+    // the image was written by the compute shader, not through the texture api
+    glext::memoryBarrier(glext::TEXTURE_UPDATE_BARRIER_BIT);
+    const uint32_t target = m_shaderParams.numViews > 1 ? glext::TEXTURE_2D_ARRAY : glext::TEXTURE_2D;
+    glext::bindTexture(target, m_outTexture.id);
+    glext::getTexImage(0, glext::RGBA, type, pixels, target);
+    glext::bindTexture(target, 0);
+
+    // alpha holds the number of accumulated frames (which bytes already clamp to 1)
+    if (type == glext::FLOAT) {
+        float* values = (float*) pixels;
+        const size_t numPixels = (size_t) m_textureSize.x * m_textureSize.y * m_shaderParams.numViews;
+        for (size_t i = 0; i < numPixels; i++) {
+            values[4 * i + 3] = 1.0f;
+        }
+    }
+}
+
+
 void Raytracer::makeTexture() {
-    // creating a empty texture
-    Image temp = GenImageColor(m_textureSize.x, m_textureSize.y, RED);
-    ImageFormat(&temp, PIXELFORMAT_UNCOMPRESSED_R16G16B16A16);
-    m_outTexture = LoadTextureFromImage(temp);
-    UnloadImage(temp);
+    const int sizeX = m_textureSize.x;
+    const int sizeY = m_textureSize.y;
+    const int format = PIXELFORMAT_UNCOMPRESSED_R16G16B16A16;
+
+    const size_t textureBytes = memtrack::getTextureSize(sizeX, sizeY, format, 1);
+
+    if (m_shaderParams.numViews > 1) {
+        const uint32_t numViews = m_shaderParams.numViews;
+        // raylib has no array textures, so the storage is allocated directly
+        m_outTexture = {(unsigned int) glext::genTexture(), sizeX, sizeY, 1, format};
+        glext::bindTexture(glext::TEXTURE_2D_ARRAY, m_outTexture.id);
+        glext::texStorage3D(1, glext::RGBA16F, sizeX, sizeY, numViews);
+        glext::bindTexture(glext::TEXTURE_2D_ARRAY, 0);
+        memtrack::add(memtrack::Kind::Texture, m_outTexture.id, "raytracer", textureBytes * numViews);
+
+        if (m_outTexture.id != 0) {
+            INFO("Created out texture array of size = %d x %d x %u views [ID: %u]", sizeX, sizeY, numViews, m_outTexture.id);
+        }
+        // neither AOVs nor statistics exist per view
+        return;
+    }
+
+    // contents are undefined until the first frame, which ignores them
+    m_outTexture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+    // filtered since the display pass upscales it
+    SetTextureFilter(m_outTexture, TEXTURE_FILTER_BILINEAR);
+    memtrack::add(memtrack::Kind::Texture, m_outTexture.id, "raytracer", textureBytes);
 
     if (m_outTexture.id != 0) {
-        const int sizeX = m_textureSize.x;
-        const int sizeY = m_textureSize.y;
         INFO("Created out texture of size = %d x %d [ID: %u]", sizeX, sizeY, m_outTexture.id);
     }
+
+    if (m_shaderParams.collectStats) {
+        makeStats();
+    }
+
+    if (!m_shaderParams.writeAOVs) {
+        return;
+    }
+
+    m_normalDepthTexture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+    m_albedoTexture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+    memtrack::add(memtrack::Kind::Texture, m_normalDepthTexture.id, "raytracer", textureBytes);
+    memtrack::add(memtrack::Kind::Texture, m_albedoTexture.id, "raytracer", textureBytes);
+
+    if (m_normalDepthTexture.id != 0 && m_albedoTexture.id != 0) {
+        INFO("Created AOV textures of size = %d x %d [ID: %u %u]", sizeX, sizeY, m_normalDepthTexture.id, m_albedoTexture.id);
+    }
+
+    if (!usingReprojection()) {
+        return;
+    }
+
+    m_historyTexture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+    m_historyNormalDepthTexture = {rlLoadTexture(nullptr, sizeX, sizeY, format, 1), sizeX, sizeY, 1, format};
+    memtrack::add(memtrack::Kind::Texture, m_historyTexture.id, "raytracer", textureBytes);
+    memtrack::add(memtrack::Kind::Texture, m_historyNormalDepthTexture.id, "raytracer", textureBytes);
+
+    if (m_historyTexture.id != 0 && m_historyNormalDepthTexture.id != 0) {
+        INFO("Created history textures of size = %d x %d [ID: %u %u]", sizeX, sizeY, m_historyTexture.id, m_historyNormalDepthTexture.id);
+    }
+}
+
+
+void Raytracer::unloadTextures() {
+    UnloadTexture(m_outTexture);
+    memtrack::remove(memtrack::Kind::Texture, m_outTexture.id);
+    TRACE("Unloaded out texture [ID: %u]", m_outTexture.id);
+
+    if (m_shaderParams.collectStats) {
+        unloadStats();
+    }
+
+    if (m_shaderParams.writeAOVs) {
+        UnloadTexture(m_normalDepthTexture);
+        UnloadTexture(m_albedoTexture);
+        memtrack::remove(memtrack::Kind::Texture, m_normalDepthTexture.id);
+        memtrack::remove(memtrack::Kind::Texture, m_albedoTexture.id);
+        TRACE("Unloaded AOV textures [ID: %u %u]", m_normalDepthTexture.id, m_albedoTexture.id);
+    }
+
+    if (usingReprojection()) {
+        UnloadTexture(m_historyTexture);
+        UnloadTexture(m_historyNormalDepthTexture);
+        memtrack::remove(memtrack::Kind::Texture, m_historyTexture.id);
+        memtrack::remove(memtrack::Kind::Texture, m_historyNormalDepthTexture.id);
+        TRACE("Unloaded history textures [ID: %u %u]", m_historyTexture.id, m_historyNormalDepthTexture.id);
+    }
+}
+
+
+void Raytracer::makeStats() {
+    const int sizeX = m_textureSize.x;
+    const int sizeY = m_textureSize.y;
+
+    // raylib has no integer formats, so the storage is allocated directly
+    m_statsTexture = {(unsigned int) glext::genTexture(), sizeX, sizeY, 1, 0};
+    rlEnableTexture(m_statsTexture.id);
+    glext::texStorage2D(1, glext::R32UI, sizeX, sizeY);
+    // integer textures are incomplete with filtering
+    rlTextureParameters(m_statsTexture.id, RL_TEXTURE_MIN_FILTER, RL_TEXTURE_FILTER_NEAREST);
+    rlTextureParameters(m_statsTexture.id, RL_TEXTURE_MAG_FILTER, RL_TEXTURE_FILTER_NEAREST);
+    rlDisableTexture();
+    memtrack::add(memtrack::Kind::Texture, m_statsTexture.id, "raytracer", (size_t) sizeX * sizeY * sizeof(uint32_t));
+
+    for (uint32_t& buffer : m_statsBuffers) {
+        buffer = rlLoadShaderBuffer(sizeof(RayStats), nullptr, RL_DYNAMIC_READ);
+        memtrack::add(memtrack::Kind::Buffer, buffer, "raytracer", sizeof(RayStats));
+    }
+    m_statsFrame = 0;
+    m_rayStats = {};
+
+    INFO("Created ray statistics image of size = %d x %d and buffers [ID: %u %u %u]", sizeX, sizeY, m_statsTexture.id, m_statsBuffers[0], m_statsBuffers[1]);
+}
+
+
+void Raytracer::unloadStats() {
+    rlUnloadTexture(m_statsTexture.id);
+    memtrack::remove(memtrack::Kind::Texture, m_statsTexture.id);
+
+    for (uint32_t& buffer : m_statsBuffers) {
+        rlUnloadShaderBuffer(buffer);
+        memtrack::remove(memtrack::Kind::Buffer, buffer);
+    }
+
+    TRACE("Unloaded ray statistics image and buffers [ID: %u %u %u]", m_statsTexture.id, m_statsBuffers[0], m_statsBuffers[1]);
+    m_statsTexture = {};
+    m_statsBuffers[0] = 0;
+    m_statsBuffers[1] = 0;
+    m_rayStats = {};
+}
+
+
+void Raytracer::startStatsFrame() {
+    // last frame's buffer has finished by the time this one is submitted, so reading it rarely stalls
+    const uint32_t current = m_statsBuffers[m_statsFrame % 2];
+    const uint32_t previous = m_statsBuffers[(m_statsFrame + 1) % 2];
+    if (m_statsFrame > 0) {
+        rlReadShaderBuffer(previous, &m_rayStats, sizeof(RayStats), 0);
+    }
+    m_statsFrame++;
+
+    const RayStats zero = {};
+    rlUpdateShaderBuffer(current, &zero, sizeof(RayStats), 0);
+}
+
+
+void Raytracer::bindStats() {
+    // the buffer cleared by the last startStatsFrame()
+    const uint32_t current = m_statsBuffers[(m_statsFrame + 1) % 2];
+    rlBindShaderBuffer(current, statsBufferBinding);
+    glext::bindImageTexture(statsImageUnit, m_statsTexture.id, glext::WRITE_ONLY, glext::R32UI);
+}
+
+
+void Raytracer::logRayStats() const {
+    if (!m_shaderParams.collectStats) {
+        INFO("Ray statistics are not being collected");
+        return;
+    }
+
+    const RayStats& stats = m_rayStats;
+    INFO("Ray statistics of the last frame:");
+    INFO("    Paths: %u, Rays: %u (%.2f per path)", stats.paths, stats.rays, stats.getPathLength());
+    INFO("    Primitive tests: %u (%.1f per ray), Node visits: %u", stats.primitiveTests, stats.getTestsPerRay(), stats.nodeVisits);
+    INFO("    Costliest pixel: %u tests", stats.maxPixelCost);
 }
 
 
@@ -103,10 +668,20 @@ void Raytracer::makeBuffers() {
         return;
     }
 
-    const uint32_t sphereBufferSize = sizeof(rt::internal::Sphere) * m_shaderParams.maxSphereCount;
-    const uint32_t triangleBufferSize = sizeof(rt::internal::Triangle) * m_shaderParams.maxTriangleCount;
+    const PrimitiveFormat format = m_shaderParams.primitiveFormat;
+    const uint32_t sphereBufferSize = getSphereSize(format) * m_shaderParams.maxSphereCount;
+    const uint32_t triangleBufferSize = getTriangleSize(format) * m_shaderParams.maxTriangleCount;
     m_sceneSpheresBuffer = rlLoadShaderBuffer(sphereBufferSize, nullptr, RL_DYNAMIC_COPY);
     m_sceneTrianglesBuffer = rlLoadShaderBuffer(triangleBufferSize, nullptr, RL_DYNAMIC_COPY);
+    memtrack::add(memtrack::Kind::Buffer, m_sceneSpheresBuffer, "raytracer", sphereBufferSize);
+    memtrack::add(memtrack::Kind::Buffer, m_sceneTrianglesBuffer, "raytracer", triangleBufferSize);
+
+    if (format != PrimitiveFormat::Full) {
+        const uint32_t attributesBufferSize = sizeof(rt::internal::TriangleAttributes) * m_shaderParams.maxTriangleCount;
+        m_sceneTriangleAttributesBuffer = rlLoadShaderBuffer(attributesBufferSize, nullptr, RL_DYNAMIC_COPY);
+        memtrack::add(memtrack::Kind::Buffer, m_sceneTriangleAttributesBuffer, "raytracer", attributesBufferSize);
+        TRACE("Created buffer for scene-triangle attributes of size = %u bytes [ID: %u]", attributesBufferSize, m_sceneTriangleAttributesBuffer);
+    }
 
     if (m_sceneSpheresBuffer != 0) {
         TRACE("Created buffer for scene-spheres of size = %u bytes [ID: %u]", sphereBufferSize, m_sceneSpheresBuffer);
@@ -121,92 +696,333 @@ void Raytracer::makeBuffers() {
 }
 
 
-char* Raytracer::loadComputeShaderContents() {
-    const char* shaderPath = "shaders/raytracer.glsl";
-    char* fileContents = LoadFileText(shaderPath);
-    if (fileContents == nullptr) {
-        TRACE("'%s' loaded successfully", fileContents);
+void Raytracer::unloadBuffers() {
+    if (m_shaderParams.storageType != SceneStorageType::SSBO) {
+        return;
     }
 
-    // find and replace utility function
-    auto replaceFn = [&](const char* replaceStr, const char* byStr) {
-        char* temp = TextReplace(fileContents, replaceStr, byStr);
-        UnloadFileText(fileContents);
-        fileContents = temp;
-    };
+    rlUnloadShaderBuffer(m_sceneSpheresBuffer);
+    rlUnloadShaderBuffer(m_sceneTrianglesBuffer);
+    memtrack::remove(memtrack::Kind::Buffer, m_sceneSpheresBuffer);
+    memtrack::remove(memtrack::Kind::Buffer, m_sceneTrianglesBuffer);
+    TRACE("Unloaded buffers for scene's spheres and triangles [ID: %u %u]", m_sceneSpheresBuffer, m_sceneTrianglesBuffer);
+    m_sceneSpheresBuffer = 0;
+    m_sceneTrianglesBuffer = 0;
+
+    if (m_sceneTriangleAttributesBuffer != 0) {
+        rlUnloadShaderBuffer(m_sceneTriangleAttributesBuffer);
+        memtrack::remove(memtrack::Kind::Buffer, m_sceneTriangleAttributesBuffer);
+        m_sceneTriangleAttributesBuffer = 0;
+    }
+}
 
-    replaceFn("WG_SIZE", TextFormat("%u", m_shaderParams.workgroupSize));
-    replaceFn("MAX_SPHERE_COUNT", TextFormat("%u", m_shaderParams.maxSphereCount));
-    replaceFn("MAX_TRIANGLE_COUNT", TextFormat("%u", m_shaderParams.maxTriangleCount));
 
-    const int usingUniform = m_shaderParams.storageType == SceneStorageType::UBO;
-    replaceFn("USE_UNIFORM_OBJECTS", TextFormat("%d", usingUniform));
+char* Raytracer::loadComputeShaderContents() {
+    char* fileContents = LoadFileText(shaderPath);
+    if (fileContents != nullptr) {
+        TRACE("'%s' loaded successfully", shaderPath);
+    }
 
     return fileContents;
 }
 
 
-void Raytracer::compileComputeShader() {
-    char* fileContents = loadComputeShaderContents();
+shadercache::Defines Raytracer::getShaderDefines(const ComputeShaderParams& params, const ShaderVariant& variant) const {
+    const int usingUniform = params.storageType == SceneStorageType::UBO;
+
+    return {
+        {"WG_WIDTH", std::to_string(params.workgroupWidth)},
+        {"WG_HEIGHT", std::to_string(params.workgroupHeight)},
+        {"MAX_SPHERE_COUNT", std::to_string(params.maxSphereCount)},
+        {"MAX_TRIANGLE_COUNT", std::to_string(params.maxTriangleCount)},
+        {"USE_UNIFORM_OBJECTS", std::to_string(usingUniform)},
+        {"WRITE_AOVS", std::to_string((int) params.writeAOVs)},
+        {"REPROJECT_HISTORY", std::to_string((int) params.reprojects())},
+        {"MAX_HISTORY_LENGTH", std::to_string(params.maxHistoryLength)},
+        {"HAS_SPHERES", std::to_string((int) variant.hasSpheres)},
+        {"HAS_TRIANGLES", std::to_string((int) variant.hasTriangles)},
+        {"ENVIRONMENT_MAP", std::to_string((int) variant.environmentMap)},
+        {"CONSTANT_MATERIALS", std::to_string((int) variant.constantMaterials)},
+        {"MAX_MATERIAL_CONSTANTS", std::to_string(maxMaterialConstants)},
+        {"BOUNCE_LIMIT", std::to_string(variant.bounceLimit)},
+        {"NUM_SAMPLES", std::to_string(variant.numSamples)},
+        {"COLLECT_STATS", std::to_string((int) params.collectStats)},
+        {"NUM_VIEWS", std::to_string(params.numViews)},
+        {"PRIMITIVE_FORMAT", std::to_string((int) params.primitiveFormat)},
+    };
+}
 
-    INFO("Compiling compute shader with:");
-    INFO("    Workgroup Size: %u", m_shaderParams.workgroupSize);
-    INFO("    Buffer Type: %s", m_shaderParams.storageType == SceneStorageType::UBO ? "UBO" : "SSBO");
-    INFO("    Max Sphere Count: %u", m_shaderParams.maxSphereCount);
-    INFO("    Max Triangle Count: %u", m_shaderParams.maxTriangleCount);
 
-    const uint32_t shaderId = rlCompileShader(fileContents, RL_COMPUTE_SHADER);
-    m_computeShaderProgram = rlLoadComputeShaderProgram(shaderId);
-    if (m_computeShaderProgram != 0) {
-        TRACE("Loaded compute shader program successfully [ID: %u]", m_computeShaderProgram);
+Raytracer::PendingCompile Raytracer::startCompile(const ComputeShaderParams& params, const ShaderVariant& variant) {
+    PROFILE_FUNCTION();
+    PendingCompile pending;
+    pending.variant = variant;
+    pending.startTime = GetTime();
+
+    char* fileContents = loadComputeShaderContents();
+    const shadercache::Defines defines = getShaderDefines(params, variant);
+
+    INFO("Compiling compute shader variant '%s' with:", variant.getName().c_str());
+    INFO("    Workgroup Size: %u x %u", params.workgroupWidth, params.workgroupHeight);
+    INFO("    Buffer Type: %s", params.storageType == SceneStorageType::UBO ? "UBO" : "SSBO");
+    INFO("    Max Sphere Count: %u", params.maxSphereCount);
+    INFO("    Max Triangle Count: %u", params.maxTriangleCount);
+    INFO("    Write AOVs: %s", params.writeAOVs ? "true" : "false");
+    INFO("    Max History Length: %u", params.reprojects() ? params.maxHistoryLength : 0);
+    INFO("    Collect Stats: %s", params.collectStats ? "true" : "false");
+    INFO("    Views: %u", params.numViews);
+    INFO("    Primitive Format: %s", getFormatName(params.primitiveFormat));
+
+    // the cache key is built from the unsubstituted source, so a hit skips the text replacing too
+    pending.cacheKey = shadercache::makeKey(fileContents, defines);
+    const uint32_t cachedProgram = shadercache::loadProgram(pending.cacheKey);
+    pending.cached = cachedProgram != 0;
+
+    if (pending.cached) {
+        pending.program = std::make_unique<AsyncProgram>(cachedProgram);
+    } else {
+        // find and replace utility function
+        auto replaceFn = [&](const char* replaceStr, const char* byStr) {
+            char* temp = TextReplace(fileContents, replaceStr, byStr);
+            UnloadFileText(fileContents);
+            fileContents = temp;
+        };
+
+        for (const auto& [name, value] : defines) {
+            replaceFn(name.c_str(), value.c_str());
+        }
+
+        pending.program = std::make_unique<AsyncProgram>(fileContents);
     }
 
     UnloadFileText(fileContents);
+    return pending;
 }
 
 
-void Raytracer::runComputeShader() {
-    m_frameIndex++;
-    static int frameIndex_uniLoc = getUniLoc("frameIndex");
+uint32_t Raytracer::finishCompile(PendingCompile& pending) {
+    const uint32_t program = pending.program->take();
+    if (program == 0) {
+        INFO("Compute shader variant '%s' failed to build", pending.variant.getName().c_str());
+        return 0;
+    }
 
-    rlEnableShader(m_computeShaderProgram);
+    if (!pending.cached) {
+        shadercache::storeProgram(pending.cacheKey, program);
+    }
+
+    // includes the frames rendered while waiting in the background
+    const float stopTime = GetTime();
+    INFO("Compute shader variant '%s' ready in %f seconds (%s)", pending.variant.getName().c_str(), stopTime - pending.startTime, pending.cached ? "cached binary" : "compiled from source");
+    return program;
+}
+
+
+bool Raytracer::runComputeShader() {
+    if (!updateProgram()) {
+        return false;
+    }
+
+    GPU_TIMER_SCOPE("compute");
+    // kept per variant to compare them
+    gputimer::Scope variantTimer(m_variantTimerName.c_str());
+    const int frameIndex_uniLoc = getUniLoc("frameIndex");
+    const int imageRegion_uniLoc = getUniLoc("imageRegion");
+    const int dispatchOffset_uniLoc = getUniLoc("dispatchOffset");
+
+    // a moved camera restarts a frame split into tiles, the rest of it would not match
+    // without history textures the old samples can't be reprojected, so accumulation starts over
+    if (m_cameraChanged) {
+        m_tileIndex = 0;
+        if (!usingReprojection()) {
+            reset();
+        }
+    }
+
+    // per-frame state, every tile of a frame shares it
+    if (m_tileIndex == 0) {
+        m_frameIndex++;
+        if (usingReprojection()) {
+            prepareReprojection();
+        }
+        if (m_shaderParams.collectStats) {
+            startStatsFrame();
+        }
+        m_lastFrameCamera = m_camera;
+        m_cameraChanged = false;
+    }
 
     rlSetUniform(frameIndex_uniLoc, &m_frameIndex, RL_SHADER_UNIFORM_INT, 1);
-    rlBindImageTexture(m_outTexture.id, 0, m_outTexture.format, false);
+    const bool wholeImage = m_regionSize.x == 0 || m_regionSize.y == 0;
+    const Vector2 regionSize = wholeImage ? m_textureSize : m_regionSize;
+    const int imageRegion[4] = {(int) m_regionOffset.x, (int) m_regionOffset.y, (int) regionSize.x, (int) regionSize.y};
+    rlSetUniform(imageRegion_uniLoc, imageRegion, RL_SHADER_UNIFORM_IVEC4, 1);
+
+    // bindings are redone for every tile, the denoiser and display can run between the tiles of a frame
+    if (m_shaderParams.numViews > 1) {
+        glext::bindImageTexture(0, m_outTexture.id, glext::READ_WRITE, glext::RGBA16F, true);
+    } else {
+        rlBindImageTexture(m_outTexture.id, 0, m_outTexture.format, false);
+    }
+    if (m_shaderParams.writeAOVs) {
+        rlBindImageTexture(m_normalDepthTexture.id, 1, m_normalDepthTexture.format, false);
+        rlBindImageTexture(m_albedoTexture.id, 2, m_albedoTexture.format, false);
+    }
+    if (usingReprojection()) {
+        rlBindImageTexture(m_historyTexture.id, 3, m_historyTexture.format, true);
+        rlBindImageTexture(m_historyNormalDepthTexture.id, 4, m_historyNormalDepthTexture.format, true);
+    }
     rlBindShaderBuffer(m_sceneSpheresBuffer, 2);
     rlBindShaderBuffer(m_sceneTrianglesBuffer, 3);
+    if (m_sceneTriangleAttributesBuffer != 0) {
+        rlBindShaderBuffer(m_sceneTriangleAttributesBuffer, triangleAttributesBinding);
+    }
+    if (m_shaderParams.collectStats) {
+        bindStats();
+    }
+
+    // bound explicitly, rlgl's sampler bookkeeping is per batch rather than per program
+    const bool texturedMaterials = m_scene != nullptr && !m_variant.constantMaterials;
+    if (texturedMaterials) {
+        rlActiveTextureSlot(materialTextureUnit);
+        rlEnableTexture(m_scene->m_materialData->getTextureId());
+    }
+    const bool environmentLit = m_scene != nullptr && m_scene->m_environment && m_variant.environmentMap;
+    if (environmentLit) {
+        rlActiveTextureSlot(environmentTextureUnit);
+        rlEnableTexture(m_scene->m_environment->getTexture().id);
+        rlBindShaderBuffer(m_scene->m_environment->getTableBuffer(), environmentBufferBinding);
+    }
+
+    // tiles are whole workgroups, so only the last row and column of them can be smaller
+    const int workgroupWidth = m_shaderParams.workgroupWidth;
+    const int workgroupHeight = m_shaderParams.workgroupHeight;
+    const int tileWidth = m_dispatchTileSize > 0 ? (m_dispatchTileSize + workgroupWidth - 1) / workgroupWidth * workgroupWidth : 0;
+    const int tileHeight = m_dispatchTileSize > 0 ? (m_dispatchTileSize + workgroupHeight - 1) / workgroupHeight * workgroupHeight : 0;
+    const int tilesX = tileWidth > 0 ? ((int) m_textureSize.x + tileWidth - 1) / tileWidth : 1;
+    const int tilesY = tileHeight > 0 ? ((int) m_textureSize.y + tileHeight - 1) / tileHeight : 1;
+    if (m_tileIndex >= tilesX * tilesY) {
+        // the workgroup size changed since the frame started
+        m_tileIndex = tilesX * tilesY - 1;
+    }
 
-    const int groupX = m_textureSize.x / m_shaderParams.workgroupSize;
-    const int groupY = m_textureSize.y / m_shaderParams.workgroupSize;
-    rlComputeShaderDispatch(groupX, groupY, 1);
+    const int offset[2] = {
+        tileWidth > 0 ? (m_tileIndex % tilesX) * tileWidth : 0,
+        tileHeight > 0 ? (m_tileIndex / tilesX) * tileHeight : 0,
+    };
+    const int width = tileWidth > 0 ? std::min(tileWidth, (int) m_textureSize.x - offset[0]) : m_textureSize.x;
+    const int height = tileHeight > 0 ? std::min(tileHeight, (int) m_textureSize.y - offset[1]) : m_textureSize.y;
+    rlSetUniform(dispatchOffset_uniLoc, offset, RL_SHADER_UNIFORM_IVEC2, 1);
+
+    // rounded up, the shader skips the pixels past the edges
+    const int groupX = (width + workgroupWidth - 1) / workgroupWidth;
+    const int groupY = (height + workgroupHeight - 1) / workgroupHeight;
+    // one layer of workgroups per view, they all share the scene
+    rlComputeShaderDispatch(groupX, groupY, m_shaderParams.numViews);
+    m_tileIndex = (m_tileIndex + 1) % (tilesX * tilesY);
+
+    if (m_shaderParams.collectStats) {
+        // the heatmap is sampled by the display pass, the totals are read back next frame
+        glext::memoryBarrier(glext::TEXTURE_FETCH_BARRIER_BIT | glext::BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    if (environmentLit) {
+        rlActiveTextureSlot(environmentTextureUnit);
+        rlDisableTexture();
+    }
+    if (texturedMaterials) {
+        rlActiveTextureSlot(materialTextureUnit);
+        rlDisableTexture();
+    }
+    if (texturedMaterials || environmentLit) {
+        rlActiveTextureSlot(0);
+    }
+
+    return true;
+}
+
+
+void Raytracer::setDispatchTileSize(int tileSize) {
+    INFO("Setting dispatch tile size to %d", tileSize);
+    m_dispatchTileSize = tileSize;
+    m_tileIndex = 0;
+}
+
+
+void Raytracer::prepareReprojection() {
+    const int reprojectHistory_uniLoc = getUniLoc("reprojectHistory");
+    const int viewMat_uniLoc = getUniLoc("prevCamera.viewMat");
+    const int projMat_uniLoc = getUniLoc("prevCamera.projMat");
+    const int position_uniLoc = getUniLoc("prevCamera.position");
+
+    // nothing to reproject right after a reset
+    const int reprojectHistory = m_cameraChanged && m_frameIndex > 1;
+    rlSetUniform(reprojectHistory_uniLoc, &reprojectHistory, RL_SHADER_UNIFORM_INT, 1);
+
+    if (!reprojectHistory) {
+        return;
+    }
+
+    rlSetUniformMatrix(viewMat_uniLoc, MatrixInvert(m_lastFrameCamera.invViewMat));
+    rlSetUniformMatrix(projMat_uniLoc, MatrixInvert(m_lastFrameCamera.invProjMat));
+    rlSetUniform(position_uniLoc, &m_lastFrameCamera.position, RL_SHADER_UNIFORM_VEC3, 1);
+
+    // the shader reads last frame's data while overwriting the current images
+    glext::memoryBarrier(glext::SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glext::copyTexture(m_outTexture.id, m_historyTexture.id, m_textureSize.x, m_textureSize.y);
+    glext::copyTexture(m_normalDepthTexture.id, m_historyNormalDepthTexture.id, m_textureSize.x, m_textureSize.y);
 }
 
 
 void Raytracer::reset() {
+    PROFILE_FUNCTION();
+    // the shader ignores the accumulated image on the first frame
     m_frameIndex = 0;
-
-    static Image img = GenImageColor(m_textureSize.x, m_textureSize.y, RED);
-    ImageFormat(&img, m_outTexture.format);
-    UpdateTexture(m_outTexture, img.data);
+    m_tileIndex = 0;
 }
 
 
 void Raytracer::setScene_materials(const rt::CompiledScene& scene) {
+    PROFILE_FUNCTION();
     TRACE("    Setting materialData [ID: %u]:", scene.m_materialData->getId());
 
-    const int numMaterials_uniLoc = getUniLoc("numMaterials");
-    const float numMaterials = scene.m_materialData->getMaterialCount();
-    rlSetUniform(numMaterials_uniLoc, &numMaterials, RL_SHADER_UNIFORM_FLOAT, 1);
-    TRACE("        numMaterials = %d", (int) numMaterials);
+    const int materialGridSize_uniLoc = getUniLoc("materialGridSize");
+    const Vector2 materialGridSize = scene.m_materialData->getGridSize();
+    m_materialGeneration = scene.m_materialData->getGeneration();
+    rlSetUniform(materialGridSize_uniLoc, &materialGridSize, RL_SHADER_UNIFORM_VEC2, 1);
+    TRACE("        materialGridSize = (%d %d)", (int) materialGridSize.x, (int) materialGridSize.y);
 
+    if (m_variant.constantMaterials) {
+        const int materialConstants_uniLoc = getUniLoc("materialConstants");
+        rlSetUniform(materialConstants_uniLoc, scene.m_constantMaterials.data(), RL_SHADER_UNIFORM_VEC4, scene.m_constantMaterials.size());
+        TRACE("        materialConstants = %u values", (unsigned) scene.m_constantMaterials.size());
+        return;
+    }
+
+    // the texture itself is bound when dispatching
     const int materialTexture_uniLoc = getUniLoc("materialTexture");
-    const int materialTexture = scene.m_materialData->getTextureId();
-    rlSetUniformSampler(materialTexture_uniLoc, materialTexture);
-    TRACE("        materialTextureId = %d", materialTexture);
+    rlSetUniform(materialTexture_uniLoc, &materialTextureUnit, RL_SHADER_UNIFORM_SAMPLER2D, 1);
+    TRACE("        materialTextureId = %d (unit %d)", scene.m_materialData->getTextureId(), materialTextureUnit);
+}
+
+
+void Raytracer::setScene_quantization(const rt::CompiledScene& scene) {
+    PROFILE_FUNCTION();
+    m_quantizationBounds = primitiveencoding::getBounds(scene.m_spheres, scene.m_triangles);
+
+    const int origin_uniLoc = getUniLoc("quantizeOrigin");
+    const int scale_uniLoc = getUniLoc("quantizeScale");
+    rlSetUniform(origin_uniLoc, &m_quantizationBounds.origin, RL_SHADER_UNIFORM_VEC3, 1);
+    rlSetUniform(scale_uniLoc, &m_quantizationBounds.scale, RL_SHADER_UNIFORM_VEC3, 1);
+
+    const Vector3& origin = m_quantizationBounds.origin;
+    const Vector3& scale = m_quantizationBounds.scale;
+    TRACE("    quantizeOrigin = (%f %f %f), quantizeScale = (%g %g %g)", origin.x, origin.y, origin.z, scale.x, scale.y, scale.z);
 }
 
 
 void Raytracer::setScene_spheres(const rt::CompiledScene& scene) {
+    PROFILE_FUNCTION();
     const uint32_t numSpheres = std::min((uint32_t) scene.m_spheres.size(), m_shaderParams.maxSphereCount);
 
     const int numSpheres_uniLoc = getUniLoc("sceneInfo.numSpheres");
@@ -236,14 +1052,33 @@ void Raytracer::setScene_spheres(const rt::CompiledScene& scene) {
 
     } else {
 
-        const uint32_t bufferSize = sizeof(rt::internal::Sphere) * numSpheres;
-        rlUpdateShaderBuffer(m_sceneSpheresBuffer, scene.m_spheres.data(), bufferSize, 0);
+        // only what fits the buffer is encoded
+        const rt::internal::Sphere* spheres = scene.m_spheres.data();
+        std::vector<rt::internal::CompactSphere> compact;
+        std::vector<rt::internal::QuantizedSphere> quantized;
+        const void* data = scene.m_spheres.data();
+        switch (m_shaderParams.primitiveFormat) {
+            case PrimitiveFormat::Compact:
+                primitiveencoding::encode(spheres, numSpheres, compact);
+                data = compact.data();
+                break;
+            case PrimitiveFormat::Quantized:
+                primitiveencoding::encode(spheres, numSpheres, m_quantizationBounds, quantized);
+                data = quantized.data();
+                break;
+            default:
+                break;
+        }
+
+        const uint32_t bufferSize = getSphereSize(m_shaderParams.primitiveFormat) * numSpheres;
+        rlUpdateShaderBuffer(m_sceneSpheresBuffer, data, bufferSize, 0);
         TRACE("    Setting scene-spheres SSBO[ID: %u] (buffer-size: %f KB)", m_sceneSpheresBuffer, numSpheres, bufferSize / 1024.0f);
     }
 }
 
 
 void Raytracer::setScene_triangles(const rt::CompiledScene& scene) {
+    PROFILE_FUNCTION();
     const uint32_t numTriangles = std::min((uint32_t) scene.m_triangles.size(), m_shaderParams.maxTriangleCount);
 
     const int numTriangles_uniLoc = getUniLoc("sceneInfo.numTriangles");
@@ -284,8 +1119,60 @@ void Raytracer::setScene_triangles(const rt::CompiledScene& scene) {
 
     } else {
 
-        const uint32_t bufferSize = sizeof(rt::internal::Triangle) * numTriangles;
-        rlUpdateShaderBuffer(m_sceneTrianglesBuffer, scene.m_triangles.data(), bufferSize, 0);
+        const rt::internal::Triangle* triangles = scene.m_triangles.data();
+        std::vector<rt::internal::CompactTriangle> compact;
+        std::vector<rt::internal::QuantizedTriangle> quantized;
+        std::vector<rt::internal::TriangleAttributes> attributes;
+        const void* data = scene.m_triangles.data();
+        switch (m_shaderParams.primitiveFormat) {
+            case PrimitiveFormat::Compact:
+                primitiveencoding::encode(triangles, numTriangles, compact, attributes);
+                data = compact.data();
+                break;
+            case PrimitiveFormat::Quantized:
+                primitiveencoding::encode(triangles, numTriangles, m_quantizationBounds, quantized, attributes);
+                data = quantized.data();
+                break;
+            default:
+                break;
+        }
+
+        const uint32_t bufferSize = getTriangleSize(m_shaderParams.primitiveFormat) * numTriangles;
+        rlUpdateShaderBuffer(m_sceneTrianglesBuffer, data, bufferSize, 0);
         TRACE("    Setting scene-triangles SSBO[ID: %u] (buffer-size: %f KB)", m_sceneTrianglesBuffer, numTriangles, bufferSize / 1024.0f);
+
+        if (!attributes.empty()) {
+            const uint32_t attributesSize = sizeof(rt::internal::TriangleAttributes) * numTriangles;
+            rlUpdateShaderBuffer(m_sceneTriangleAttributesBuffer, attributes.data(), attributesSize, 0);
+            TRACE("    Setting scene-triangle attributes SSBO[ID: %u] (buffer-size: %f KB)", m_sceneTriangleAttributesBuffer, attributesSize / 1024.0f);
+        }
+    }
+}
+
+
+void Raytracer::setScene_environment(const rt::CompiledScene& scene) {
+    PROFILE_FUNCTION();
+    // variants without the map only have the background color
+    if (!m_variant.environmentMap) {
+        return;
     }
+
+    const int useEnvironment = scene.m_environment != nullptr;
+    const int useEnvironment_uniLoc = getUniLoc("useEnvironment");
+    rlSetUniform(useEnvironment_uniLoc, &useEnvironment, RL_SHADER_UNIFORM_INT, 1);
+    TRACE("    Environment map: %s", useEnvironment ? scene.m_environment->getName().c_str() : "none");
+
+    if (!useEnvironment) {
+        return;
+    }
+
+    const int environmentSize[2] = {scene.m_environment->getWidth(), scene.m_environment->getHeight()};
+    const int environmentSize_uniLoc = getUniLoc("environmentSize");
+    const int environmentIntensity_uniLoc = getUniLoc("environmentIntensity");
+    const int environmentTexture_uniLoc = getUniLoc("environmentTexture");
+    rlSetUniform(environmentSize_uniLoc, environmentSize, RL_SHADER_UNIFORM_IVEC2, 1);
+    rlSetUniform(environmentIntensity_uniLoc, &scene.m_environmentIntensity, RL_SHADER_UNIFORM_FLOAT, 1);
+    // the texture and the sampling tables are bound when dispatching
+    rlSetUniform(environmentTexture_uniLoc, &environmentTextureUnit, RL_SHADER_UNIFORM_SAMPLER2D, 1);
+    TRACE("        size = %d x %d, intensity = %f (unit %d)", environmentSize[0], environmentSize[1], scene.m_environmentIntensity, environmentTextureUnit);
 }
@@ -1,9 +1,17 @@
 
 #pragma once
 
+#include "src/asyncprogram.h"
 #include "src/structs/camera.h"
 #include "src/compiledscene.h"
+#include "src/primitiveencoding.h"
+#include "src/shadercache.h"
 #include "src/structs/config.h"
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
 
 
 enum class SceneStorageType {
@@ -12,11 +20,76 @@ enum class SceneStorageType {
 };
 
 
+// layout of the scene's spheres and triangles on the gpu, the smaller ones only exist as storage buffers
+enum class PrimitiveFormat {
+    // 32 byte spheres and 80 byte triangles
+    Full,
+    // 16 byte spheres, 36 byte triangles (vertex and two edges) with their uvs and material in 16 more bytes
+    // radii and uvs are half floats
+    Compact,
+    // 12 byte spheres and 24 byte triangles, positions are 21 bits per axis relative to the scene bounds
+    Quantized,
+};
+
+
 struct ComputeShaderParams {
-    uint32_t workgroupSize;
+    // pixels covered by a workgroup, any shape works since edge workgroups skip what lies outside the image
+    uint32_t workgroupWidth;
+    uint32_t workgroupHeight;
     SceneStorageType storageType;
     uint32_t maxSphereCount;
     uint32_t maxTriangleCount;
+    // first-hit normal, depth and albedo images (needed by the denoiser)
+    bool writeAOVs;
+    // frames of history kept when reprojecting after a camera change, 0 disables reprojection
+    // (reprojection needs the depth AOV)
+    uint32_t maxHistoryLength;
+    // compile variants specialized to the current scene and config instead of one generic shader
+    // (every distinct combination is compiled once, then reused)
+    bool specializeVariants;
+    // per-pixel cost image (for the heatmap) and frame totals of rays and intersection tests
+    bool collectStats = false;
+    // views rendered by each dispatch, one camera each, more than 1 renders into the layers of a texture array
+    // (those have no AOVs or statistics, and the window only displays single views)
+    uint32_t numViews = 1;
+    // uniform buffers always use the full format
+    PrimitiveFormat primitiveFormat = PrimitiveFormat::Full;
+
+    bool reprojects() const { return writeAOVs && maxHistoryLength > 0; }
+};
+
+
+// totals of one frame, read back a frame late so the dispatch is never waited for
+// layout matches statsBlock in the shader
+struct RayStats {
+    uint32_t paths;
+    uint32_t rays;
+    uint32_t primitiveTests;
+    // acceleration structure nodes, 0 while every ray tests every primitive
+    uint32_t nodeVisits;
+    // tests and visits of the costliest pixel, the top of the heatmap
+    uint32_t maxPixelCost;
+
+    float getPathLength() const { return paths ? (float) rays / paths : 0.0f; }
+    float getTestsPerRay() const { return rays ? (float) primitiveTests / rays : 0.0f; }
+};
+
+
+// compile-time choices of the compute shader, the default is the generic shader
+struct ShaderVariant {
+    bool hasSpheres = true;
+    bool hasTriangles = true;
+    // light from an environment map instead of the background color, with direct light sampling
+    bool environmentMap = true;
+    // material values come from a uniform array instead of the packed texture
+    bool constantMaterials = false;
+    // 0 reads the value from the config uniform
+    int bounceLimit = 0;
+    int numSamples = 0;
+
+    // whether this variant renders the same image as `other` would
+    bool canRender(const ShaderVariant& other) const;
+    std::string getName() const;
 };
 
 
@@ -26,38 +99,164 @@ public:
     Raytracer(Vector2 textureSize, const ComputeShaderParams& shaderParams);
     ~Raytracer();
     const Vector2& getTextureSize() const { return m_textureSize; }
+    const ComputeShaderParams& getShaderParams() const { return m_shaderParams; }
     int getFrameIndex() const { return m_frameIndex; }
+    const std::string& getVariantName() const { return m_variantName; }
+    // zero unless collectStats is set
+    const RayStats& getRayStats() const { return m_rayStats; }
+    void logRayStats() const;
+    // state is uploaded when the next frame is dispatched, the scene must stay alive until then
+    // sets the first view
     void setCamera(const rt::Camera& camera);
+    // one camera per view, extra ones are ignored and missing views keep theirs
+    void setCameras(const std::vector<rt::Camera>& cameras);
     void setScene(const rt::CompiledScene& scene);
+    // forgets the scene, so it can be freed before another one is set
+    void clearScene();
     void setConfig(const rt::Config& config);
+    void setSpecialized(bool specialized);
+    bool isSpecialized() const { return m_specialized; }
+    // compiled in the background, the current shader keeps rendering until the new one is ready
+    void setShaderParams(const ComputeShaderParams& shaderParams);
+    // also happens on its own when the shader file changes
+    void reloadShader();
     bool saveImage(const char* fileName) const;
+    // accumulated image as rgba, type is glext::FLOAT or glext::UNSIGNED_BYTE, alpha is 1
+    // with several views their images follow each other
+    void readPixels(uint32_t type, void* pixels) const;
+    // reallocates the output images, accumulation restarts
+    void resize(Vector2 textureSize);
+    // renders the part of a larger image at offset (with the camera set up for fullSize) instead of a whole one,
+    // pixels come out exactly as in a full render, fullSize of 0 renders the texture as the whole image
+    // (reprojection always treats the texture as the whole image)
+    void setRegion(Vector2 offset, Vector2 fullSize);
+    // splits every frame into dispatches of tiles of about this many pixels square, each call of
+    // runComputeShader() then renders the next tile, 0 renders whole frames
+    // (a frame is counted by getFrameIndex() as soon as its first tile is dispatched)
+    void setDispatchTileSize(int tileSize);
+    int getDispatchTileSize() const { return m_dispatchTileSize; }
     void reset();
 
+private:
+    struct PendingCompile {
+        ShaderVariant variant;
+        uint64_t cacheKey;
+        bool cached;
+        float startTime;
+        std::unique_ptr<AsyncProgram> program;
+    };
+
 private:
     void makeTexture();
+    void unloadTextures();
+    void makeStats();
+    void unloadStats();
+    // reads back the previous frame's totals and clears the buffer of this one
+    void startStatsFrame();
+    void bindStats();
     void makeBuffers();
+    void unloadBuffers();
     char* loadComputeShaderContents();
-    void compileComputeShader();
+    shadercache::Defines getShaderDefines(const ComputeShaderParams& params, const ShaderVariant& variant) const;
+    PendingCompile startCompile(const ComputeShaderParams& params, const ShaderVariant& variant);
+    // waits if needed, returns 0 when the build failed
+    uint32_t finishCompile(PendingCompile& pending);
+    ShaderVariant chooseVariant(const ComputeShaderParams& params) const;
+    // switches to the variant matching the current state and uploads whatever the program is missing
+    // returns false when no program can render the current state yet
+    bool updateProgram();
+    void useProgram(const ShaderVariant& variant, uint32_t program);
+    void watchShaderSource();
+    void startRebuild(const ComputeShaderParams& params);
+    void finishRebuild();
+    void applyShaderParams(const ComputeShaderParams& params);
+    void applyCamera();
+    void applyScene();
+    void applyConfig();
+    bool usingReprojection() const { return m_shaderParams.reprojects(); }
+    void prepareReprojection();
     Texture getOutTexture() const { return m_outTexture; }
-    void runComputeShader();
+    // dispatches the next frame, or the next tile of one, false when nothing could be dispatched yet
+    bool runComputeShader();
     void setScene_materials(const rt::CompiledScene& scene);
+    // bounds of quantized positions, before the spheres and triangles are encoded
+    void setScene_quantization(const rt::CompiledScene& scene);
     void setScene_spheres(const rt::CompiledScene& scene);
     void setScene_triangles(const rt::CompiledScene& scene);
+    void setScene_environment(const rt::CompiledScene& scene);
 
 private:
     Vector2 m_textureSize;
     // shader will write to this texture
     Texture m_outTexture;
+    // first-hit buffers, only created when writeAOVs is set
+    Texture m_normalDepthTexture = {};
+    Texture m_albedoTexture = {};
+    // previous frame's color and normal-depth, only created when reprojecting
+    Texture m_historyTexture = {};
+    Texture m_historyNormalDepthTexture = {};
+
+    // see setRegion()
+    Vector2 m_regionOffset = {0, 0};
+    Vector2 m_regionSize = {0, 0};
+
+    // camera of the last rendered frame, and whether it changed since
+    rt::Camera m_camera = {};
+    rt::Camera m_lastFrameCamera = {};
+    bool m_cameraChanged = false;
+    // every view's camera, the first one is m_camera
+    std::vector<rt::Camera> m_viewCameras;
     // used to average frames over time
     int m_frameIndex = 0;
+    // see setDispatchTileSize(), the tile dispatched next, 0 starts a new frame
+    int m_dispatchTileSize = 0;
+    int m_tileIndex = 0;
 
     ComputeShaderParams m_shaderParams;
 
+    // state last set, and whether the current program has it yet
+    const rt::CompiledScene* m_scene = nullptr;
+    rt::Config m_config = {};
+    bool m_cameraDirty = false;
+    bool m_sceneDirty = false;
+    bool m_configDirty = false;
+    // of the material atlas when its grid size was last set
+    unsigned m_materialGeneration = 0;
+
+    bool m_specialized;
+    // compiled variants by name, m_computeShaderProgram is one of them
+    std::map<std::string, uint32_t> m_programs;
+    ShaderVariant m_variant;
+    std::string m_variantName;
+    std::string m_variantTimerName;
     uint32_t m_computeShaderProgram = 0;
+    std::map<std::string, PendingCompile> m_pendingVariants;
+    std::set<std::string> m_failedVariants;
+
+    // rebuild after a source edit or a parameter change, replaces every variant once it is ready
+    std::unique_ptr<PendingCompile> m_pendingRebuild;
+    ComputeShaderParams m_pendingParams;
+    long m_shaderModTime = 0;
+    float m_lastWatchTime = 0.0f;
     uint32_t m_sceneSpheresBuffer = 0;
     uint32_t m_sceneTrianglesBuffer = 0;
+    // uvs and materials of compact and quantized triangles
+    uint32_t m_sceneTriangleAttributesBuffer = 0;
+    // of the scene last uploaded in the quantized format
+    primitiveencoding::QuantizationBounds m_quantizationBounds = {};
+
+    // only created when collectStats is set, the buffers alternate between frames
+    Texture m_statsTexture = {};
+    uint32_t m_statsBuffers[2] = {};
+    uint32_t m_statsFrame = 0;
+    RayStats m_rayStats = {};
 
 
     friend class Renderer;
+    friend class Denoiser;
+    friend struct rt_context;
+    friend class RenderServer;
+    friend class TiledRender;
+    friend class WorkgroupTimer;
 
 };
@@ -1,8 +1,19 @@
 
+#include "src/autotune.h"
+#include "src/benchmarks.h"
 #include "src/camera.h"
+#include "src/governor.h"
+#include "src/gputimer.h"
+#include "src/headless.h"
 #include "src/logger.h"
+#include "src/memtrack.h"
+#include "src/profiler.h"
 #include "src/renderer.h"
+#include "src/renderserver.h"
+#include "src/scenefile.h"
 #include "src/test_scenes.h"
+#include "src/tiledistributor.h"
+#include "src/tiledrender.h"
 #include "src/cli.h"
 
 
@@ -14,22 +25,53 @@ bool changeIndex(unsigned int& index, KeyboardKey key) {
 }
 
 
-ComputeShaderParams getShaderParams() {
-    return {
-        .workgroupSize = 8,
+ComputeShaderParams getShaderParams(const rt::SceneBuilder* sceneFile) {
+    ComputeShaderParams params = {
+        .workgroupWidth = 8,
+        .workgroupHeight = 8,
         .storageType = SceneStorageType::UBO,
         // .storageType = SceneStorageType::SSBO,
 
         .maxSphereCount = 16,
         .maxTriangleCount = 5,
+        .writeAOVs = true,
+        .maxHistoryLength = 32,
+        .specializeVariants = true,
     };
+
+    // scene files can be far larger than the uniform buffers
+    if (sceneFile) {
+        params.storageType = SceneStorageType::SSBO;
+        params.maxSphereCount = std::max<uint32_t>(params.maxSphereCount, sceneFile->getSphereCount());
+        params.maxTriangleCount = std::max<uint32_t>(params.maxTriangleCount, sceneFile->getTriangleCount());
+    }
+
+    // needs the GL context, the cache is per device
+    autotune::applyCached(params);
+    return params;
+}
+
+
+// the built-in scenes use uniform buffers, which only have the full format
+bool applyPrimitiveFormat(const std::string& name, ComputeShaderParams& params) {
+    if (name == "full") {
+        params.primitiveFormat = PrimitiveFormat::Full;
+    } else if (name == "compact") {
+        params.primitiveFormat = PrimitiveFormat::Compact;
+    } else if (name == "quantized") {
+        params.primitiveFormat = PrimitiveFormat::Quantized;
+    } else {
+        INFO("Unknown primitive format '%s' (available: full, compact, quantized)", name.c_str());
+        return false;
+    }
+    return true;
 }
 
 
-SceneCamera getSceneCamera(Vector2 imageSize) {
-    const Vector3 camPosition = {0, 0, 6};
-    const Vector3 camDirection = {0, 0, -1};
-    const float camFov = 60.0;
+SceneCamera getSceneCamera(Vector2 imageSize, const rt::CameraPose* pose) {
+    const Vector3 camPosition = pose ? pose->position : Vector3{0, 0, 6};
+    const Vector3 camDirection = pose ? pose->direction : Vector3{0, 0, -1};
+    const float camFov = pose ? pose->fov : 60.0;
     const SceneCameraParams camParams = {
         .speed = 10.0,
     };
@@ -38,8 +80,18 @@ SceneCamera getSceneCamera(Vector2 imageSize) {
 }
 
 
-std::vector<std::unique_ptr<rt::CompiledScene>> createScenes() {
+// a loaded scene file is moved into its compiled scene, so this can only be called once for it
+// empty when the scene file has more materials than the atlas holds
+std::vector<std::unique_ptr<rt::CompiledScene>> createScenes(rt::SceneBuilder* sceneFile) {
+    PROFILE_FUNCTION();
     std::vector<std::unique_ptr<rt::CompiledScene>> out;
+    if (sceneFile) {
+        auto compiled = std::make_unique<rt::CompiledScene>(std::move(*sceneFile));
+        if (compiled->hasAllMaterials()) {
+            out.push_back(std::move(compiled));
+        }
+        return out;
+    }
     out.push_back(createScene_1());
     out.push_back(createScene_2());
     out.push_back(createRandomScene(8, 4));
@@ -58,79 +110,304 @@ std::vector<rt::Config> createConfigs() {
 }
 
 
+// renders one image of any size without opening a window
+bool renderTiled(const CommandLineOptions& options, rt::SceneBuilder* sceneFile) {
+    int width = 0;
+    int height = 0;
+    if (sscanf(options.tiledRender.c_str(), "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0) {
+        INFO("--tiledRender expects <width>x<height>");
+        return false;
+    }
+    if (!IsFileExtension(options.output.c_str(), ".ppm")) {
+        INFO("--tiledRender writes a binary ppm, --output must end in .ppm");
+        return false;
+    }
+
+    // checked before the context exists, so a bad format has nothing to tear down
+    ComputeShaderParams formatCheck = {};
+    if (!applyPrimitiveFormat(options.primitiveFormat, formatCheck)) {
+        return false;
+    }
+    if (!headless::createContext()) {
+        return false;
+    }
+
+    // after the context, the tuned workgroup shape is looked up by device
+    ComputeShaderParams params = getShaderParams(sceneFile);
+    applyPrimitiveFormat(options.primitiveFormat, params);
+    // nothing reads them here
+    params.writeAOVs = false;
+    params.maxHistoryLength = 0;
+
+    const Vector2 imageSize = {(float) width, (float) height};
+    const rt::CameraPose* scenePose = sceneFile && !sceneFile->getCameras().empty() ? &sceneFile->getCameras()[0] : nullptr;
+    bool rendered = false;
+    {
+        TiledRenderParams tiledParams;
+        tiledParams.imageSize = imageSize;
+        tiledParams.tileSize = options.tileSize > 0 ? (options.tileSize + 7) / 8 * 8 : tiledParams.tileSize;
+        tiledParams.frames = options.frames;
+
+        const float tileSize = tiledParams.tileSize;
+        Raytracer raytracer({tileSize, tileSize}, params);
+        const std::vector scenes = createScenes(sceneFile);
+        if (!scenes.empty()) {
+            raytracer.setScene(*scenes[0]);
+            raytracer.setConfig(createConfigs()[1]);
+            raytracer.setCamera(getSceneCamera(imageSize, scenePose).get());
+
+            TiledRender tiled(raytracer, tiledParams);
+            rendered = tiled.render(options.output.c_str());
+        }
+    }
+
+    headless::destroyContext();
+    return rendered;
+}
+
+
 int main(int argc, const char* argv[]) {
     CommandLineOptions options(argc, argv);
     logger::setLogLevel(options.verbose ? logger::LogLevel::TRACE : logger::LogLevel::INFO);
+    PROFILE_THREAD_NAME("main");
 
-    const float imageWidth = options.windowWidth / options.imageScale;
-    const float imageHeight = options.windowHeight / options.imageScale;
+    if (!options.benchmark.empty()) {
+        return benchmarks::run(options.benchmark) ? 0 : 1;
+    }
 
-    Renderer renderer({options.windowWidth, options.windowHeight});
+    if (!options.saveScene.empty()) {
+        scenefile::Description desc;
+        if (options.sceneFile.empty()) {
+            INFO("--saveScene needs a --scene to convert");
+            return 1;
+        }
+        return scenefile::parse(options.sceneFile.c_str(), desc) && scenefile::saveBinary(options.saveScene.c_str(), desc) ? 0 : 1;
+    }
 
-    ComputeShaderParams params = getShaderParams();
-    std::shared_ptr raytracer = std::make_shared<Raytracer>(Vector2{imageWidth, imageHeight}, params);
-    renderer.setRaytracer(raytracer);
+    if (!options.serve.empty()) {
+        const std::unique_ptr<RenderServer> server = RenderServer::create({options.windowWidth / options.imageScale, options.windowHeight / options.imageScale});
+        return server && server->run(options.serve.c_str()) ? 0 : 1;
+    }
+
+    if (!options.distribute.empty()) {
+        if (options.sceneFile.empty()) {
+            INFO("--distribute needs a --scene to render");
+            return 1;
+        }
 
-    SceneCamera camera = getSceneCamera({imageWidth, imageHeight});
+        TileDistributorParams distributorParams;
+        for (char* worker = strtok(options.distribute.data(), ","); worker; worker = strtok(nullptr, ",")) {
+            distributorParams.workers.push_back(worker);
+        }
+        distributorParams.scenePath = options.sceneFile;
+        distributorParams.imageSize = {options.windowWidth / options.imageScale, options.windowHeight / options.imageScale};
+        distributorParams.tileSize = options.tileSize;
+        distributorParams.frames = options.frames;
+        distributorParams.config = createConfigs()[1];
+
+        TileDistributor distributor(distributorParams);
+        std::vector<float> pixels;
+        return distributor.render(pixels) && TileDistributor::saveImage(pixels, distributorParams.imageSize, options.output.c_str()) ? 0 : 1;
+    }
 
-    const std::vector scenes = createScenes();
+    // parsed before the window is created, the scene is compiled once there is a context
+    rt::SceneBuilder sceneFile;
+    if (!options.sceneFile.empty() && !scenefile::load(options.sceneFile.c_str(), sceneFile)) {
+        return 1;
+    }
+    rt::SceneBuilder* loadedScene = options.sceneFile.empty() ? nullptr : &sceneFile;
+    // the builder keeps its cameras when compiled
+    const rt::CameraPose* scenePose = loadedScene && !sceneFile.getCameras().empty() ? &sceneFile.getCameras()[0] : nullptr;
+
+    if (!options.tiledRender.empty()) {
+        return renderTiled(options, loadedScene) ? 0 : 1;
+    }
+
+    float imageWidth = options.windowWidth / options.imageScale;
+    float imageHeight = options.windowHeight / options.imageScale;
+
+    memtrack::setGpuBudget(options.memoryBudget * 1024 * 1024);
+    Renderer renderer({options.windowWidth, options.windowHeight});
+
+    SceneCamera camera = getSceneCamera({imageWidth, imageHeight}, scenePose);
+    float fov = scenePose ? scenePose->fov : 60.0f;
+
+    // sized before the scene file is compiled, which empties it
+    ComputeShaderParams params = getShaderParams(loadedScene);
+    if (!applyPrimitiveFormat(options.primitiveFormat, params)) {
+        return 1;
+    }
+    const std::vector scenes = createScenes(loadedScene);
+    if (scenes.empty()) {
+        return 1;
+    }
     const std::vector configs = createConfigs();
 
     unsigned sceneIdx = 0;
-    unsigned configIdx = 2;
+    // denoiser makes low sample counts usable while navigating
+    unsigned configIdx = 1;
     bool benchmarkMode = false;
 
+    if (options.autotune) {
+        autotune::run(params, {imageWidth, imageHeight}, *scenes[sceneIdx], camera.get(), configs[configIdx]);
+    }
+    std::shared_ptr raytracer = std::make_shared<Raytracer>(Vector2{imageWidth, imageHeight}, params);
+    renderer.setRaytracer(raytracer);
+    if (options.dispatchBudget > 0.0f) {
+        renderer.setDispatchBudget(options.dispatchBudget);
+    }
+    if (options.dispatchTile > 0) {
+        raytracer->setDispatchTileSize(options.dispatchTile);
+    }
+
+    std::shared_ptr denoiser = std::make_shared<Denoiser>(Vector2{imageWidth, imageHeight}, DenoiserParams{});
+    renderer.setDenoiser(denoiser);
+
+    ResolutionGovernorParams governorParams;
+    governorParams.targetFrameTime = options.frameBudget / 1000.0f;
+    governorParams.adjustSamples = options.adaptiveSamples;
+    ResolutionGovernor governor({imageWidth, imageHeight}, governorParams);
+
     raytracer->setCamera(camera.get());
     raytracer->setScene(*scenes[sceneIdx].get());
     raytracer->setConfig(configs[configIdx]);
 
+    rt::Config currentConfig = configs[configIdx];
+    governor.setNumSamples(currentConfig.numSamples);
+
+    INFO("Startup took %f seconds since window creation", GetTime());
+
     while (!WindowShouldClose()) {
-        if (IsKeyPressed(KEY_B)) {
-            benchmarkMode = !benchmarkMode;
-            if (benchmarkMode) {
-                SetTargetFPS(0);
-            } else {
-                SetTargetFPS(30);
+        PROFILE_SCOPE("frame");
+        bool cameraMoved = false;
+        bool resized = false;
+
+        {
+            PROFILE_SCOPE("input");
+
+            if (IsKeyPressed(KEY_B)) {
+                benchmarkMode = !benchmarkMode;
+                if (benchmarkMode) {
+                    SetTargetFPS(0);
+                } else {
+                    SetTargetFPS(30);
+                }
             }
-        }
 
-        if (camera.update(GetFrameTime())) {
-            raytracer->setCamera(camera.get());
-            raytracer->reset();
-        }
+            // the raytracer reprojects or resets on camera changes itself
+            if (camera.update(GetFrameTime())) {
+                raytracer->setCamera(camera.get());
+                cameraMoved = true;
+            }
 
-        if (changeIndex(sceneIdx, KEY_S)) {
-            const rt::CompiledScene& scene = *scenes[sceneIdx % scenes.size()];
-            raytracer->setScene(scene);
-            raytracer->reset();
-        }
+            if (changeIndex(sceneIdx, KEY_S)) {
+                const rt::CompiledScene& scene = *scenes[sceneIdx % scenes.size()];
+                raytracer->setScene(scene);
+                raytracer->reset();
+            }
 
-        if (changeIndex(configIdx, KEY_C)) {
-            const rt::Config& config = configs[configIdx % configs.size()];
-            raytracer->setConfig(config);
-        }
+            if (changeIndex(configIdx, KEY_C)) {
+                currentConfig = configs[configIdx % configs.size()];
+                raytracer->setConfig(currentConfig);
+                governor.setNumSamples(currentConfig.numSamples);
+            }
 
-        if (IsKeyDown(KEY_SPACE) && GetMouseWheelMove() != 0) {
-            static float fov = 60.0f;
-            fov += GetMouseWheelMove();
-            camera.updateProjMatrix({imageWidth, imageHeight}, fov);
-            raytracer->setCamera(camera.get());
-            raytracer->reset();
+            if (IsKeyDown(KEY_SPACE) && GetMouseWheelMove() != 0) {
+                fov += GetMouseWheelMove();
+                camera.updateProjMatrix({imageWidth, imageHeight}, fov);
+                raytracer->setCamera(camera.get());
+                cameraMoved = true;
+            }
+
+            if (IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_S)) {
+                raytracer->saveImage("output.png");
+            }
+
+            if (IsKeyPressed(KEY_N)) {
+                denoiser->setEnabled(!denoiser->isEnabled());
+            }
+
+            if (IsKeyPressed(KEY_G)) {
+                renderer.toggleTimings();
+            }
+
+            if (IsKeyPressed(KEY_V)) {
+                raytracer->setSpecialized(!raytracer->isSpecialized());
+            }
+
+            if (IsKeyPressed(KEY_F5)) {
+                raytracer->reloadShader();
+            }
+
+            // cycles square workgroup sizes (4, 8, 16) without blocking the loop
+            if (IsKeyPressed(KEY_F6)) {
+                params.workgroupWidth = params.workgroupWidth >= 16 ? 4 : params.workgroupWidth * 2;
+                params.workgroupHeight = params.workgroupWidth;
+                raytracer->setShaderParams(params);
+            }
+
+            if (IsKeyPressed(KEY_L)) {
+                gputimer::logStats();
+                memtrack::logStats();
+                raytracer->logRayStats();
+            }
+
+            // shows the per-pixel cost heatmap instead of the image
+            if (IsKeyPressed(KEY_H)) {
+                params.collectStats = !params.collectStats;
+                raytracer->setShaderParams(params);
+            }
+
+            if (IsKeyDown(KEY_M)) {
+                renderer.setGamma(1.0);
+            }
+
+            if (IsWindowResized()) {
+                renderer.resize();
+                const Vector2 windowSize = renderer.getWindowSize();
+                governor.setFullSize({windowSize.x / options.imageScale, windowSize.y / options.imageScale});
+                resized = true;
+            }
         }
 
-        if (IsKeyDown(KEY_LEFT_CONTROL) && IsKeyPressed(KEY_S)) {
-            raytracer->saveImage("output.png");
+        {
+            PROFILE_SCOPE("render");
+            renderer.render();
         }
+        // gpu time from the timer queries of earlier frames, so measuring never waits for the gpu
+        // with a dispatch budget the render always takes about as long, the governor keeps each dispatch short instead
+        const float gpuRenderTime = (gputimer::getLast("compute") + gputimer::getLast("denoise")) / 1000.0f;
+        const float renderTime = options.dispatchBudget > 0.0f ? renderer.getDispatchTime() : gpuRenderTime;
 
-        if (IsKeyDown(KEY_M)) {
-            renderer.setGamma(1.0);
+        {
+            PROFILE_SCOPE("draw");
+            renderer.draw();
         }
 
-        if (IsWindowResized()) {
-            renderer.resize();
+        if (governor.update(renderTime, cameraMoved) || resized) {
+            PROFILE_SCOPE("resize");
+            const Vector2 renderSize = governor.isEnabled() ? governor.getRenderSize() : Vector2{
+                renderer.getWindowSize().x / options.imageScale,
+                renderer.getWindowSize().y / options.imageScale,
+            };
+            imageWidth = renderSize.x;
+            imageHeight = renderSize.y;
+
+            raytracer->resize(renderSize);
+            denoiser->resize(renderSize);
+            camera.updateProjMatrix(renderSize, fov);
+            raytracer->setCamera(camera.get());
+
+            if (options.adaptiveSamples && governor.getNumSamples() != currentConfig.numSamples) {
+                currentConfig.numSamples = governor.getNumSamples();
+                raytracer->setConfig(currentConfig);
+            }
         }
+    }
+
+    gputimer::logStats();
 
-        renderer.render();
-        renderer.draw();
+    if (!options.traceFile.empty()) {
+        profiler::writeTrace(options.traceFile.c_str());
     }
 }
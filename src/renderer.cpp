@@ -1,6 +1,21 @@
 
 #include "src/renderer.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
 #include "src/logger.h"
+#include "src/materialregistry.h"
+#include "src/memtrack.h"
+#include <raylib/rlgl.h>
+#include <stdint.h>
+
+
+// texture unit of the heatmap, kept apart from the units rlgl hands out to batch samplers
+// (two sampler types on one unit fail every draw, even when one is never read)
+static const int heatmapTextureUnit = 3;
+// stops a budget from spinning on dispatches that finish instantly
+static const int maxDispatchesPerFrame = 256;
+// dispatches queued on the gpu at once while filling a budget, one runs while the next waits
+static const int maxDispatchesInFlight = 2;
 
 
 Renderer::Renderer(Vector2 windowSize)
@@ -15,19 +30,29 @@ Renderer::Renderer(Vector2 windowSize)
         INFO("Created window of size = %d x %d", (int) windowSize.x, (int) windowSize.y);
     }
 
+    glext::load();
+
     Image img = GenImageChecked(4, 4, 1, 1, PINK, BLACK);
     m_blankTexture = LoadTextureFromImage(img);
+    memtrack::add(memtrack::Kind::Texture, m_blankTexture.id, "renderer", memtrack::getTextureSize(img.width, img.height, img.format, 1));
     UnloadImage(img);
 
     m_texFragShader = LoadShader(nullptr, "shaders/texFrag.glsl");
     SetShaderValue(m_texFragShader, GetShaderLocation(m_texFragShader, "windowSize"), &m_windowSize, SHADER_UNIFORM_VEC2);
     const float gamma = 2.2f;
     SetShaderValue(m_texFragShader, GetShaderLocation(m_texFragShader, "gamma"), &gamma, SHADER_UNIFORM_FLOAT);
+    SetShaderValue(m_texFragShader, GetShaderLocation(m_texFragShader, "heatmapTexture"), &heatmapTextureUnit, SHADER_UNIFORM_INT);
+    m_showHeatmap_uniLoc = GetShaderLocation(m_texFragShader, "showHeatmap");
+    m_heatmapScale_uniLoc = GetShaderLocation(m_texFragShader, "heatmapScale");
 }
 
 
 Renderer::~Renderer() {
+    gputimer::shutdown();
+    rt::MaterialRegistry::shutdown();
     UnloadTexture(m_blankTexture);
+    memtrack::remove(memtrack::Kind::Texture, m_blankTexture.id);
+    memtrack::logStats();
     UnloadShader(m_texFragShader);
     CloseWindow();
     INFO("Closed window");
@@ -39,6 +64,11 @@ void Renderer::setRaytracer(std::weak_ptr<Raytracer> raytracer) {
 }
 
 
+void Renderer::setDenoiser(std::weak_ptr<Denoiser> denoiser) {
+    m_denoiser = denoiser;
+}
+
+
 void Renderer::setGamma(float gamma) {
     static int gamma_uniLoc = GetShaderLocation(m_texFragShader, "gamma");
 
@@ -46,9 +76,68 @@ void Renderer::setGamma(float gamma) {
 }
 
 
+void Renderer::setDispatchBudget(float milliseconds) {
+    INFO("Setting dispatch budget to %f ms per frame", milliseconds);
+    m_dispatchBudget = milliseconds / 1000.0f;
+    m_dispatchTime = 0.0f;
+}
+
+
 void Renderer::render() {
+    gputimer::update();
+
     if (auto raytracer = m_raytracer.lock()) {
-        raytracer->runComputeShader();
+        if (m_dispatchBudget > 0.0f) {
+            dispatchWithinBudget(*raytracer);
+        } else {
+            raytracer->runComputeShader();
+        }
+
+        auto denoiser = m_denoiser.lock();
+        if (denoiser && denoiser->isEnabled()) {
+            denoiser->run(*raytracer);
+        }
+    }
+}
+
+
+void Renderer::dispatchWithinBudget(Raytracer& raytracer) {
+    // predicted from the timer queries of earlier dispatches (read back by gputimer::update())
+    // smoothed, one slow dispatch (like the first after a variant switch) should not stop the next frames
+    const float measured = gputimer::getLast("compute") / 1000.0f;
+    if (measured > 0.0f) {
+        m_dispatchTime = m_dispatchTime > 0.0f ? m_dispatchTime * 0.8f + measured * 0.2f : measured;
+    }
+
+    // doubles, the session time is too coarse as a float after a while
+    const double start = GetTime();
+    m_dispatchCount = 0;
+
+    // the gpu always has the next dispatch queued, the cpu only waits once maxDispatchesInFlight are
+    void* fences[maxDispatchesInFlight] = {};
+    while (m_dispatchCount < maxDispatchesPerFrame) {
+        // a dispatch that would overrun the budget is left for the next frame
+        // nothing is measured yet on the first frames, they dispatch once
+        const float predicted = (m_dispatchCount + 1) * m_dispatchTime;
+        if (m_dispatchCount > 0 && (m_dispatchTime == 0.0f || predicted > m_dispatchBudget || GetTime() - start > m_dispatchBudget)) {
+            break;
+        }
+
+        void*& fence = fences[m_dispatchCount % maxDispatchesInFlight];
+        glext::waitSync(fence, UINT64_MAX);
+        glext::deleteSync(fence);
+
+        if (!raytracer.runComputeShader()) {
+            fence = nullptr;
+            break;
+        }
+        fence = glext::fenceSync();
+        m_dispatchCount++;
+    }
+
+    // the last dispatches finish while the frame is drawn
+    for (void* fence : fences) {
+        glext::deleteSync(fence);
     }
 }
 
@@ -59,16 +148,68 @@ void Renderer::draw() {
     DrawTexturePro(m_blankTexture, {0, 0, 4, 4}, {0, 0, m_windowSize.x, m_windowSize.y}, {0, 0}, 0, WHITE);
 
     if (auto raytracer = m_raytracer.lock()) {
-        const Texture outTexture = raytracer->getOutTexture();
+        auto denoiser = m_denoiser.lock();
+        const bool denoised = denoiser && denoiser->isEnabled() && raytracer->getShaderParams().writeAOVs;
+
+        const Texture outTexture = denoised ? denoiser->getOutTexture() : raytracer->getOutTexture();
         const Vector2 texSize = raytracer->getTextureSize();
         const Rectangle srcRect = {0, 0, texSize.x, texSize.y};
         const Rectangle destRect = {0, 0, m_windowSize.x, m_windowSize.y};
+        // replaces the image while ray statistics are collected
+        const bool heatmap = raytracer->m_statsTexture.id != 0;
+        const RayStats& rayStats = raytracer->getRayStats();
+
+        // the render resolution can be lower than the window, the texture filter upscales it
+        {
+            // ending the shader mode flushes the batch, so the draw lands inside the timer
+            GPU_TIMER_SCOPE("display");
+            BeginShaderMode(m_texFragShader);
+            const int showHeatmap = heatmap;
+            SetShaderValue(m_texFragShader, m_showHeatmap_uniLoc, &showHeatmap, SHADER_UNIFORM_INT);
+            if (heatmap) {
+                const float heatmapScale = rayStats.maxPixelCost > 0 ? 1.0f / rayStats.maxPixelCost : 0.0f;
+                SetShaderValue(m_texFragShader, m_heatmapScale_uniLoc, &heatmapScale, SHADER_UNIFORM_FLOAT);
+                rlActiveTextureSlot(heatmapTextureUnit);
+                rlEnableTexture(raytracer->m_statsTexture.id);
+            }
+            DrawTexturePro(outTexture, srcRect, destRect, {0, 0}, 0, WHITE);
+            EndShaderMode();
+            if (heatmap) {
+                rlDisableTexture();
+                rlActiveTextureSlot(0);
+            }
+        }
+
+        if (m_dispatchBudget > 0.0f) {
+            DrawText(TextFormat("Frame Index: %d (%d dispatches of %.2f ms)", raytracer->getFrameIndex(), m_dispatchCount, m_dispatchTime * 1000.0f), 10, 30, 18, BLACK);
+        } else {
+            DrawText(TextFormat("Frame Index: %d", raytracer->getFrameIndex()), 10, 30, 18, BLACK);
+        }
+        DrawText(TextFormat("Denoiser: %s", denoised ? "on" : "off"), 10, 50, 18, BLACK);
+        DrawText(TextFormat("Resolution: %d x %d", (int) texSize.x, (int) texSize.y), 10, 70, 18, BLACK);
+        DrawText(TextFormat("Shader: %s", raytracer->getVariantName().c_str()), 10, 90, 18, BLACK);
+
+        if (heatmap) {
+            DrawText(
+                TextFormat("Rays: %.2f M | path length: %.2f | tests per ray: %.1f | max pixel cost: %u", rayStats.rays / 1e6f, rayStats.getPathLength(), rayStats.getTestsPerRay(), rayStats.maxPixelCost),
+                10, 130, 18, BLACK
+            );
+        }
+    }
 
-        BeginShaderMode(m_texFragShader);
-        DrawTexturePro(outTexture, srcRect, destRect, {0, 0}, 0, WHITE);
-        EndShaderMode();
-
-        DrawText(TextFormat("Frame Index: %d", raytracer->getFrameIndex()), 10, 30, 18, BLACK);
+    // red while over the budget
+    const memtrack::Totals memory = memtrack::getTotals();
+    DrawText(
+        TextFormat("GPU memory: %.1f MB (peak %.1f MB) | host: %.1f MB", memory.gpuBytes / 1048576.0f, memory.gpuPeak / 1048576.0f, memory.hostBytes / 1048576.0f),
+        10, 110, 18, memory.overBudget ? RED : BLACK
+    );
+
+    if (m_showTimings) {
+        int y = 160;
+        for (const gputimer::PassStats& stats : gputimer::getStats()) {
+            DrawText(TextFormat("%s: %.3f ms (min %.3f | max %.3f)", stats.name.c_str(), stats.average, stats.min, stats.max), 10, y, 18, BLACK);
+            y += 20;
+        }
     }
 
     DrawFPS(10, 10);
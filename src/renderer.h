@@ -1,7 +1,7 @@
 
 #pragma once
 
-#include "src/raytracer.h"
+#include "src/denoiser.h"
 
 
 class Renderer {
@@ -9,17 +9,36 @@ class Renderer {
 public:
     Renderer(Vector2 windowSize);
     void setRaytracer(std::weak_ptr<Raytracer> raytracer);
+    void setDenoiser(std::weak_ptr<Denoiser> denoiser);
     ~Renderer();
     const Vector2& getWindowSize() const { return m_windowSize; }
     void setGamma(float gamma);
+    // milliseconds of dispatches per render(), as many as fit, 0 dispatches once
+    void setDispatchBudget(float milliseconds);
+    // seconds of one dispatch while a budget is set, from gpu timer queries a few frames old
+    float getDispatchTime() const { return m_dispatchTime; }
     void render();
     void draw();
     void resize();
+    void toggleTimings() { m_showTimings = !m_showTimings; }
+
+private:
+    void dispatchWithinBudget(Raytracer& raytracer);
 
 private:
     Vector2 m_windowSize;
     std::weak_ptr<Raytracer> m_raytracer;
+    std::weak_ptr<Denoiser> m_denoiser;
+
+    bool m_showTimings = true;
+
+    // seconds, see setDispatchBudget()
+    float m_dispatchBudget = 0.0f;
+    float m_dispatchTime = 0.0f;
+    int m_dispatchCount = 0;
 
     Texture m_blankTexture;
     Shader m_texFragShader;
+    int m_showHeatmap_uniLoc;
+    int m_heatmapScale_uniLoc;
 };
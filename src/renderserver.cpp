@@ -0,0 +1,380 @@
+#include "src/renderserver.h"
+#include "src/autotune.h"
+#include "src/camera.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
+#include "src/headless.h"
+#include "src/logger.h"
+#include "src/scenefile.h"
+#include <algorithm>
+#include <sstream>
+
+
+// limits of every scene the server renders, the scene buffers are allocated once
+static const uint32_t maxSphereCount = 1 << 16;
+static const uint32_t maxTriangleCount = 1 << 16;
+// scenes kept loaded between jobs
+static const size_t maxResidentScenes = 8;
+// milliseconds to sleep in poll while there is nothing to render
+static const int idleTimeout = 100;
+// seconds between progress replies of a job
+static const float progressInterval = 0.25f;
+
+
+std::unique_ptr<RenderServer> RenderServer::create(Vector2 defaultSize) {
+    if (!headless::createContext()) {
+        return nullptr;
+    }
+    return std::unique_ptr<RenderServer>(new RenderServer(defaultSize));
+}
+
+
+RenderServer::RenderServer(Vector2 defaultSize)
+    : m_defaultSize(defaultSize) {
+
+    ComputeShaderParams params = {
+        .workgroupWidth = 8,
+        .workgroupHeight = 8,
+        .storageType = SceneStorageType::SSBO,
+        .maxSphereCount = maxSphereCount,
+        .maxTriangleCount = maxTriangleCount,
+        // nothing here reads the AOVs
+        .writeAOVs = false,
+        .maxHistoryLength = 0,
+        .specializeVariants = true,
+    };
+    autotune::applyCached(params);
+    m_raytracer = std::make_unique<Raytracer>(defaultSize, params);
+}
+
+
+RenderServer::~RenderServer() {
+    // scenes release their material cells before the registry goes
+    m_raytracer.reset();
+    m_scenes.clear();
+    headless::destroyContext();
+}
+
+
+bool RenderServer::run(const char* socketPath) {
+    if (!m_listener.open(socketPath)) {
+        return false;
+    }
+
+    while (!m_stopping) {
+        const bool busy = m_currentJob.has_value() || !m_queue.empty();
+        m_listener.wait(m_connections, busy ? 0 : idleTimeout);
+
+        acceptConnections();
+
+        std::string line;
+        for (const auto& connection : m_connections) {
+            connection->receive();
+            while (connection->nextLine(line)) {
+                handleRequest(*connection, line);
+            }
+        }
+
+        if (!m_currentJob) {
+            startNextJob();
+        }
+        if (m_currentJob) {
+            renderCurrentJob();
+        }
+
+        for (auto it = m_connections.begin(); it != m_connections.end();) {
+            (*it)->flush();
+            if ((*it)->isOpen()) {
+                it++;
+                continue;
+            }
+            dropConnection(it->get());
+            it = m_connections.erase(it);
+        }
+    }
+
+    INFO("Render server stopped");
+    return true;
+}
+
+
+void RenderServer::acceptConnections() {
+    while (std::unique_ptr<ipc::Connection> connection = m_listener.accept()) {
+        TRACE("Accepted a render client");
+        m_connections.push_back(std::move(connection));
+    }
+}
+
+
+void RenderServer::handleRequest(ipc::Connection& client, const std::string& line) {
+    std::istringstream tokens(line);
+    std::string command;
+    tokens >> command;
+
+    if (command == "render") {
+        RenderJob job;
+        std::string error;
+        if (!parseJob(line, job, error)) {
+            reply(&client, "error - " + error);
+            return;
+        }
+
+        job.id = m_nextJobId++;
+        job.client = &client;
+        m_queue.push_back(job);
+        reply(&client, TextFormat("queued %u", job.id));
+        INFO("Queued render job %u: '%s', %u frames (priority %d)", job.id, job.scenePath.c_str(), job.frames, job.priority);
+
+    } else if (command == "cancel") {
+        uint32_t id = 0;
+        tokens >> id;
+        if (m_currentJob && m_currentJob->id == id) {
+            failCurrentJob("cancelled");
+            return;
+        }
+
+        auto it = std::find_if(m_queue.begin(), m_queue.end(), [&](const RenderJob& job) { return job.id == id; });
+        if (it == m_queue.end()) {
+            reply(&client, TextFormat("error %u no such job", id));
+            return;
+        }
+        reply(it->client, TextFormat("error %u cancelled", id));
+        m_queue.erase(it);
+
+    } else if (command == "status") {
+        const std::string running = m_currentJob ? std::to_string(m_currentJob->id) : "-";
+        reply(&client, TextFormat("status %s %u %u", running.c_str(), (unsigned) m_queue.size(), (unsigned) m_scenes.size()));
+
+    } else if (command == "shutdown") {
+        INFO("Render server shutting down on request");
+        m_stopping = true;
+
+    } else if (!command.empty()) {
+        reply(&client, "error - unknown request '" + command + "'");
+    }
+}
+
+
+bool RenderServer::parseJob(const std::string& line, RenderJob& job, std::string& error) const {
+    std::istringstream tokens(line);
+    std::string command;
+    tokens >> command >> job.priority >> job.scenePath >> job.frames >> job.config.numSamples >> job.config.bounceLimit >> job.output;
+    if (!tokens) {
+        error = "expected: render <priority> <scene> <frames> <numSamples> <bounceLimit> <output>";
+        return false;
+    }
+
+    job.size = m_defaultSize;
+    job.camera.reset();
+    job.region = {0, 0, 0, 0};
+    job.floatPixels = false;
+
+    std::string option;
+    while (tokens >> option) {
+        if (option == "size") {
+            tokens >> job.size.x >> job.size.y;
+        } else if (option == "camera") {
+            rt::CameraPose pose;
+            tokens >> pose.position.x >> pose.position.y >> pose.position.z >> pose.direction.x >> pose.direction.y >> pose.direction.z >> pose.fov;
+            job.camera = pose;
+        } else if (option == "region") {
+            tokens >> job.region.x >> job.region.y >> job.region.width >> job.region.height;
+        } else if (option == "float") {
+            job.floatPixels = true;
+        } else {
+            error = "unknown option '" + option + "'";
+            return false;
+        }
+        if (!tokens) {
+            error = "incomplete option '" + option + "'";
+            return false;
+        }
+    }
+
+    if (job.frames == 0 || job.config.numSamples < 1 || job.config.bounceLimit < 1 || job.size.x < 1 || job.size.y < 1) {
+        error = "frames, samples, bounces and size must be positive";
+        return false;
+    }
+
+    if (job.region.width == 0 || job.region.height == 0) {
+        job.region = {0, 0, job.size.x, job.size.y};
+    } else if (job.region.x < 0 || job.region.y < 0 || job.region.width < 0 || job.region.height < 0) {
+        error = "region must be positive";
+        return false;
+    }
+    return true;
+}
+
+
+void RenderServer::dropConnection(ipc::Connection* client) {
+    TRACE("Render client disconnected");
+
+    // jobs writing files still finish, the pixels of the others have nowhere to go
+    m_queue.erase(
+        std::remove_if(m_queue.begin(), m_queue.end(), [&](const RenderJob& job) { return job.client == client && job.output == "-"; }),
+        m_queue.end()
+    );
+    for (RenderJob& job : m_queue) {
+        if (job.client == client) {
+            job.client = nullptr;
+        }
+    }
+
+    if (m_currentJob && m_currentJob->client == client) {
+        m_currentJob->client = nullptr;
+        if (m_currentJob->output == "-") {
+            failCurrentJob("client disconnected");
+        }
+    }
+}
+
+
+const RenderServer::CachedScene* RenderServer::getScene(const std::string& path, std::string& error) {
+    const long modTime = GetFileModTime(path.c_str());
+    auto it = m_scenes.find(path);
+    if (it != m_scenes.end() && it->second.modTime == modTime) {
+        it->second.lastUse = ++m_sceneUseCounter;
+        return &it->second;
+    }
+
+    rt::SceneBuilder scene;
+    if (!scenefile::load(path.c_str(), scene)) {
+        error = "failed to load '" + path + "'";
+        return nullptr;
+    }
+    if (scene.getSphereCount() > maxSphereCount || scene.getTriangleCount() > maxTriangleCount) {
+        error = TextFormat("'%s' has more than %u spheres or %u triangles", path.c_str(), maxSphereCount, maxTriangleCount);
+        return nullptr;
+    }
+
+    // unloaded before compiling, so the new scene can reuse their material cells
+    // the raytracer may still point at one of them, and keeps nothing if the new scene fails
+    m_raytracer->clearScene();
+    m_scenes.erase(path);
+    evictScenes(maxResidentScenes - 1);
+
+    CachedScene& cached = m_scenes[path];
+    cached.modTime = modTime;
+    cached.lastUse = ++m_sceneUseCounter;
+    cached.cameras = scene.getCameras();
+    cached.compiled = std::make_unique<rt::CompiledScene>(std::move(scene));
+    if (!cached.compiled->hasAllMaterials()) {
+        m_scenes.erase(path);
+        error = "'" + path + "' has more materials than fit in the material atlas";
+        return nullptr;
+    }
+    INFO("Scene '%s' is resident [ID: %u]", path.c_str(), cached.compiled->getId());
+    return &cached;
+}
+
+
+void RenderServer::evictScenes(size_t count) {
+    while (m_scenes.size() > count) {
+        auto oldest = std::min_element(m_scenes.begin(), m_scenes.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUse < b.second.lastUse;
+        });
+        INFO("Unloading scene '%s' [ID: %u]", oldest->first.c_str(), oldest->second.compiled->getId());
+        m_scenes.erase(oldest);
+    }
+}
+
+
+void RenderServer::startNextJob() {
+    if (m_queue.empty()) {
+        return;
+    }
+
+    // highest priority, then the oldest
+    auto next = std::min_element(m_queue.begin(), m_queue.end(), [](const RenderJob& a, const RenderJob& b) {
+        return a.priority != b.priority ? a.priority > b.priority : a.id < b.id;
+    });
+    m_currentJob = *next;
+    m_queue.erase(next);
+
+    const RenderJob& job = *m_currentJob;
+    m_jobStartTime = GetTime();
+    m_lastProgressTime = m_jobStartTime;
+
+    std::string error;
+    const CachedScene* scene = getScene(job.scenePath, error);
+    if (scene == nullptr) {
+        failCurrentJob(error.c_str());
+        return;
+    }
+
+    const rt::CameraPose defaultPose = {{0, 0, 6}, {0, 0, -1}, 60.0f};
+    const rt::CameraPose& pose = job.camera ? *job.camera : scene->cameras.empty() ? defaultPose : scene->cameras[0];
+    const SceneCamera camera(pose.position, pose.direction, pose.fov, job.size, SceneCameraParams{});
+
+    m_raytracer->resize({job.region.width, job.region.height});
+    m_raytracer->setRegion({job.region.x, job.region.y}, job.size);
+    m_raytracer->setScene(*scene->compiled);
+    m_raytracer->setConfig(job.config);
+    m_raytracer->setCamera(camera.get());
+    m_raytracer->reset();
+
+    reply(job.client, TextFormat("started %u", job.id));
+    INFO("Started render job %u", job.id);
+}
+
+
+void RenderServer::renderCurrentJob() {
+    gputimer::update();
+
+    // no frame is dispatched while the variant for this job compiles
+    m_raytracer->runComputeShader();
+    if (m_raytracer->m_computeShaderProgram == 0) {
+        failCurrentJob("compute shader failed to build");
+        return;
+    }
+
+    const RenderJob& job = *m_currentJob;
+    const uint32_t frame = m_raytracer->getFrameIndex();
+    if (frame >= job.frames) {
+        finishCurrentJob();
+        return;
+    }
+
+    const float now = GetTime();
+    if (now - m_lastProgressTime >= progressInterval) {
+        m_lastProgressTime = now;
+        reply(job.client, TextFormat("progress %u %u %u", job.id, frame, job.frames));
+    }
+}
+
+
+void RenderServer::finishCurrentJob() {
+    const RenderJob& job = *m_currentJob;
+
+    if (job.output == "-") {
+        const int width = job.region.width;
+        const int height = job.region.height;
+        std::vector<unsigned char> pixels((size_t) width * height * 4 * (job.floatPixels ? sizeof(float) : 1));
+        m_raytracer->readPixels(job.floatPixels ? glext::FLOAT : glext::UNSIGNED_BYTE, pixels.data());
+
+        reply(job.client, TextFormat("image %u %d %d %u", job.id, width, height, (unsigned) pixels.size()));
+        job.client->send(pixels.data(), pixels.size());
+    } else if (!m_raytracer->saveImage(job.output.c_str())) {
+        failCurrentJob(TextFormat("failed to write '%s'", job.output.c_str()));
+        return;
+    }
+
+    const float seconds = GetTime() - m_jobStartTime;
+    reply(job.client, TextFormat("done %u %s %f", job.id, job.output.c_str(), seconds));
+    INFO("Finished render job %u in %f seconds", job.id, seconds);
+    m_currentJob.reset();
+}
+
+
+void RenderServer::failCurrentJob(const char* message) {
+    INFO("Render job %u failed: %s", m_currentJob->id, message);
+    reply(m_currentJob->client, TextFormat("error %u %s", m_currentJob->id, message));
+    m_currentJob.reset();
+}
+
+
+void RenderServer::reply(ipc::Connection* client, const std::string& line) {
+    if (client != nullptr) {
+        client->sendLine(line);
+    }
+}
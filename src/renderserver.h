@@ -0,0 +1,105 @@
+#pragma once
+
+#include "src/ipc.h"
+#include "src/raytracer.h"
+#include "src/scene.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+// long-lived headless renderer taking jobs over a unix domain socket (--serve <path>)
+// the compiled shader variants, scenes and material atlas stay resident between jobs
+// (the scenes used last, the others are unloaded to free their material cells)
+//
+// requests, one per line (paths cannot contain spaces)
+//     render <priority> <scene> <frames> <numSamples> <bounceLimit> <output> [size <w> <h>] [camera <x> <y> <z> <dirX> <dirY> <dirZ> <fov>]
+//            [region <x> <y> <w> <h>] [float]
+//         region renders only that part of the image (pixels identical to a full render), float sends rgba32f pixels
+//     cancel <job>
+//     status
+//     shutdown
+// replies
+//     queued <job>
+//     started <job>
+//     progress <job> <frame> <frames>
+//     image <job> <width> <height> <bytes>      followed by that many bytes of rgba8 (or rgba32f), when the output is '-'
+//     done <job> <output> <seconds>
+//     error <job> <message>                      job is '-' for requests that are not about a job
+//     status <running job or '-'> <queued jobs> <resident scenes>
+// higher priorities run first, equal ones in submission order, and a running job is never interrupted
+// the scene's first camera is used when the job has none
+
+
+struct RenderJob {
+    uint32_t id;
+    int priority;
+    std::string scenePath;
+    uint32_t frames;
+    rt::Config config;
+    // image file written by raylib (format from the extension), or '-' to send the pixels back
+    std::string output;
+    // of the whole image
+    Vector2 size;
+    std::optional<rt::CameraPose> camera;
+    // rendered part of the image, all of it by default
+    Rectangle region;
+    bool floatPixels;
+    // nullptr once the client has disconnected
+    ipc::Connection* client;
+};
+
+
+class RenderServer {
+
+public:
+    // creates a headless GL context, nullptr when that fails
+    static std::unique_ptr<RenderServer> create(Vector2 defaultSize);
+    ~RenderServer();
+    // serves until a shutdown request, returns false when the socket could not be opened
+    bool run(const char* socketPath);
+
+private:
+    struct CachedScene {
+        long modTime;
+        // for unloading the least recently used scene first
+        uint64_t lastUse;
+        std::vector<rt::CameraPose> cameras;
+        std::unique_ptr<rt::CompiledScene> compiled;
+    };
+
+private:
+    // needs the GL context
+    RenderServer(Vector2 defaultSize);
+    void acceptConnections();
+    void handleRequest(ipc::Connection& client, const std::string& line);
+    bool parseJob(const std::string& line, RenderJob& job, std::string& error) const;
+    void dropConnection(ipc::Connection* client);
+    // loads on first use, and again when the file has changed
+    const CachedScene* getScene(const std::string& path, std::string& error);
+    // unloads the least recently used scenes until at most count are left
+    void evictScenes(size_t count);
+    void startNextJob();
+    void renderCurrentJob();
+    void finishCurrentJob();
+    void failCurrentJob(const char* message);
+    void reply(ipc::Connection* client, const std::string& line);
+
+private:
+    Vector2 m_defaultSize;
+    std::unique_ptr<Raytracer> m_raytracer;
+    std::map<std::string, CachedScene> m_scenes;
+    uint64_t m_sceneUseCounter = 0;
+
+    ipc::Listener m_listener;
+    std::vector<std::unique_ptr<ipc::Connection>> m_connections;
+    bool m_stopping = false;
+
+    uint32_t m_nextJobId = 1;
+    std::vector<RenderJob> m_queue;
+    std::optional<RenderJob> m_currentJob;
+    float m_jobStartTime = 0.0f;
+    float m_lastProgressTime = 0.0f;
+};
@@ -1,13 +1,23 @@
 
 #pragma once
 
+#include "src/environmentmap.h"
 #include "src/hittable.h"
+#include <memory>
 #include <vector>
 
 
 namespace rt {
 
 
+// viewpoint stored with a scene file
+struct CameraPose {
+    Vector3 position;
+    Vector3 direction;
+    float fov;
+};
+
+
 struct Scene {
 
     void addObject(const Sphere& obj) { spheres.push_back(obj); }
@@ -16,6 +26,12 @@ struct Scene {
     std::vector<Sphere> spheres;
     std::vector<Triangle> triangles;
     Color backgroundColor;
+    // optional, lights the scene and replaces the background color
+    std::shared_ptr<EnvironmentMap> environment;
+    // scales the environment map's radiance
+    float environmentIntensity = 1.0f;
+    // optional, the first one is used when the scene is loaded
+    std::vector<CameraPose> cameras;
 
 };
 
@@ -0,0 +1,93 @@
+#include "src/scenebuilder.h"
+#include <algorithm>
+
+
+namespace rt {
+
+
+// same as rt::Triangle
+static const Vector2 defaultUVs[3] = {{0, 0}, {0, 1}, {1, 0}};
+
+
+MaterialHandle SceneBuilder::addMaterial(std::shared_ptr<Material> material) {
+    m_materials.push_back(std::move(material));
+    return m_materials.size() - 1;
+}
+
+
+void SceneBuilder::reserveSpheres(size_t count) {
+    count += getSphereCount();
+    m_spherePositions.reserve(count);
+    m_sphereRadii.reserve(count);
+    m_sphereMaterials.reserve(count);
+}
+
+
+void SceneBuilder::reserveTriangles(size_t count) {
+    count += getTriangleCount();
+    m_triangleVertices.reserve(3 * count);
+    m_triangleUVs.reserve(3 * count);
+    m_triangleMaterials.reserve(count);
+}
+
+
+void SceneBuilder::addSphere(Vector3 position, float radius, MaterialHandle material) {
+    m_spherePositions.push_back(position);
+    m_sphereRadii.push_back(radius);
+    m_sphereMaterials.push_back(material);
+}
+
+
+void SceneBuilder::addSpheres(const Vector3* positions, const float* radii, size_t count, MaterialHandle material) {
+    m_spherePositions.insert(m_spherePositions.end(), positions, positions + count);
+    m_sphereRadii.insert(m_sphereRadii.end(), radii, radii + count);
+    m_sphereMaterials.insert(m_sphereMaterials.end(), count, material);
+}
+
+
+void SceneBuilder::addSpheres(const Vector3* positions, const float* radii, const MaterialHandle* materials, size_t count) {
+    m_spherePositions.insert(m_spherePositions.end(), positions, positions + count);
+    m_sphereRadii.insert(m_sphereRadii.end(), radii, radii + count);
+    m_sphereMaterials.insert(m_sphereMaterials.end(), materials, materials + count);
+}
+
+
+void SceneBuilder::addTriangle(Vector3 v0, Vector3 v1, Vector3 v2, MaterialHandle material) {
+    addTriangle(v0, v1, v2, defaultUVs[0], defaultUVs[1], defaultUVs[2], material);
+}
+
+
+void SceneBuilder::addTriangle(Vector3 v0, Vector3 v1, Vector3 v2, Vector2 uv0, Vector2 uv1, Vector2 uv2, MaterialHandle material) {
+    m_triangleVertices.insert(m_triangleVertices.end(), {v0, v1, v2});
+    m_triangleUVs.insert(m_triangleUVs.end(), {uv0, uv1, uv2});
+    m_triangleMaterials.push_back(material);
+}
+
+
+void SceneBuilder::addTriangles(const Vector3* vertices, const Vector2* uvs, size_t count, MaterialHandle material) {
+    m_triangleVertices.insert(m_triangleVertices.end(), vertices, vertices + 3 * count);
+    if (uvs) {
+        m_triangleUVs.insert(m_triangleUVs.end(), uvs, uvs + 3 * count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            m_triangleUVs.insert(m_triangleUVs.end(), defaultUVs, defaultUVs + 3);
+        }
+    }
+    m_triangleMaterials.insert(m_triangleMaterials.end(), count, material);
+}
+
+
+void SceneBuilder::addTriangles(const Vector3* vertices, const Vector2* uvs, const MaterialHandle* materials, size_t count) {
+    const size_t first = getTriangleCount();
+    addTriangles(vertices, uvs, count, 0);
+    std::copy(materials, materials + count, m_triangleMaterials.begin() + first);
+}
+
+
+void SceneBuilder::setEnvironment(std::shared_ptr<EnvironmentMap> environment, float intensity) {
+    m_environment = std::move(environment);
+    m_environmentIntensity = intensity;
+}
+
+
+} // namespace rt
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "src/environmentmap.h"
+#include "src/material.h"
+#include "src/scene.h"
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+
+namespace rt {
+
+
+// index of a material within the builder it was added to
+using MaterialHandle = uint32_t;
+
+
+// builds a scene as one array per attribute, primitives refer to materials by handle instead of holding them
+// compiling consumes the arrays, so building a scene costs about the size of its raw data
+// (rt::Scene is simpler for small hand-made scenes)
+class SceneBuilder {
+
+public:
+    MaterialHandle addMaterial(std::shared_ptr<Material> material);
+    void reserveSpheres(size_t count);
+    void reserveTriangles(size_t count);
+    void addSphere(Vector3 position, float radius, MaterialHandle material);
+    // count spheres sharing one material, or with a material each
+    void addSpheres(const Vector3* positions, const float* radii, size_t count, MaterialHandle material);
+    void addSpheres(const Vector3* positions, const float* radii, const MaterialHandle* materials, size_t count);
+    void addTriangle(Vector3 v0, Vector3 v1, Vector3 v2, MaterialHandle material);
+    void addTriangle(Vector3 v0, Vector3 v1, Vector3 v2, Vector2 uv0, Vector2 uv1, Vector2 uv2, MaterialHandle material);
+    // three vertices per triangle, and three uvs when they are not null (the defaults of rt::Triangle otherwise)
+    void addTriangles(const Vector3* vertices, const Vector2* uvs, size_t count, MaterialHandle material);
+    void addTriangles(const Vector3* vertices, const Vector2* uvs, const MaterialHandle* materials, size_t count);
+    void setBackgroundColor(Color color) { m_backgroundColor = color; }
+    // lights the scene and replaces the background color
+    void setEnvironment(std::shared_ptr<EnvironmentMap> environment, float intensity = 1.0f);
+    void addCamera(const CameraPose& pose) { m_cameras.push_back(pose); }
+
+    size_t getMaterialCount() const { return m_materials.size(); }
+    size_t getSphereCount() const { return m_sphereRadii.size(); }
+    size_t getTriangleCount() const { return m_triangleMaterials.size(); }
+    // kept when the scene is compiled
+    const std::vector<CameraPose>& getCameras() const { return m_cameras; }
+
+private:
+    std::vector<std::shared_ptr<Material>> m_materials;
+
+    std::vector<Vector3> m_spherePositions;
+    std::vector<float> m_sphereRadii;
+    std::vector<MaterialHandle> m_sphereMaterials;
+
+    // three of each per triangle
+    std::vector<Vector3> m_triangleVertices;
+    std::vector<Vector2> m_triangleUVs;
+    std::vector<MaterialHandle> m_triangleMaterials;
+
+    Color m_backgroundColor = {200, 200, 200, 255};
+    std::shared_ptr<EnvironmentMap> m_environment;
+    float m_environmentIntensity = 1.0f;
+    std::vector<CameraPose> m_cameras;
+
+    friend class CompiledScene;
+};
+
+
+} // namespace rt
@@ -0,0 +1,787 @@
+#include "src/scenefile.h"
+#include "src/logger.h"
+#include "src/profiler.h"
+#include "src/threadpool.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+#include <unordered_map>
+
+
+namespace scenefile {
+
+
+struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t numMaterials;
+    uint32_t numSpheres;
+    uint32_t numTriangles;
+    uint32_t numCameras;
+    Color background;
+};
+
+
+static const char binaryMagic[4] = {'R', 'T', 'S', 'B'};
+// version 2 added the environment map, version 1 files are still read
+static const uint32_t binaryVersion = 2;
+// text is handed to the workers in chunks of about this size
+static const size_t chunkSize = 4 << 20;
+
+// objects and cameras are read and written as they are in memory (little endian)
+static_assert(sizeof(SphereDesc) == 20);
+static_assert(sizeof(TriangleDesc) == 64);
+static_assert(sizeof(rt::CameraPose) == 28);
+
+
+// objects of one chunk of text, their material indices refer to `materialNames` until the chunks are merged
+struct Chunk {
+    std::vector<MaterialDesc> materials;
+    std::vector<SphereDesc> spheres;
+    std::vector<TriangleDesc> triangles;
+    std::vector<rt::CameraPose> cameras;
+    bool hasBackground = false;
+    Color background;
+    bool hasEnvironment = false;
+    std::string environmentMap;
+    float environmentIntensity;
+    std::vector<std::string> materialNames;
+    // line number and message of the first error
+    uint32_t errorLine = 0;
+    const char* error = nullptr;
+};
+
+
+// whitespace separated tokens of a single line
+class Tokens {
+
+public:
+    Tokens(std::string_view line) : m_rest(line) {}
+
+    bool next(std::string_view& token) {
+        skipSpaces();
+        if (m_rest.empty()) {
+            return false;
+        }
+
+        size_t end = 0;
+        while (end < m_rest.size() && !isSpace(m_rest[end])) {
+            end++;
+        }
+        token = m_rest.substr(0, end);
+        m_rest.remove_prefix(end);
+        return true;
+    }
+
+    // leaves the token in place when it is not a number
+    bool nextFloat(float& value) {
+        const std::string_view rest = m_rest;
+        std::string_view token;
+        if (!next(token)) {
+            return false;
+        }
+
+        // from_chars does not take a leading '+'
+        if (token.size() > 1 && token[0] == '+') {
+            token.remove_prefix(1);
+        }
+
+        const auto [end, error] = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (error != std::errc() || end != token.data() + token.size()) {
+            m_rest = rest;
+            return false;
+        }
+        return true;
+    }
+
+    // leaves the tokens in place unless all of them are numbers
+    bool nextVector(Vector3& value) {
+        const std::string_view rest = m_rest;
+        if (nextFloat(value.x) && nextFloat(value.y) && nextFloat(value.z)) {
+            return true;
+        }
+        m_rest = rest;
+        return false;
+    }
+
+    bool nextVector(Vector2& value) {
+        const std::string_view rest = m_rest;
+        if (nextFloat(value.x) && nextFloat(value.y)) {
+            return true;
+        }
+        m_rest = rest;
+        return false;
+    }
+
+    bool empty() {
+        skipSpaces();
+        return m_rest.empty();
+    }
+
+private:
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    void skipSpaces() {
+        while (!m_rest.empty() && isSpace(m_rest[0])) {
+            m_rest.remove_prefix(1);
+        }
+    }
+
+private:
+    std::string_view m_rest;
+};
+
+
+static std::string resolvePath(const std::string& directory, std::string_view path) {
+    if (directory.empty() || std::filesystem::path(path).is_absolute()) {
+        return std::string(path);
+    }
+    return directory + "/" + std::string(path);
+}
+
+
+static bool readFile(const std::string& fileName, std::string& out) {
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+
+    char buffer[1 << 16];
+    size_t read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        out.append(buffer, read);
+    }
+    fclose(file);
+    return true;
+}
+
+
+// positions, texture coordinates and faces (as triangle fans), everything else is ignored
+static const char* loadObj(const std::string& fileName, uint32_t material, Vector3 offset, float scale, std::vector<TriangleDesc>& out) {
+    PROFILE_FUNCTION();
+    std::string text;
+    if (!readFile(fileName, text)) {
+        return "failed to open mesh";
+    }
+
+    std::vector<Vector3> positions;
+    std::vector<Vector2> uvs;
+    const size_t firstTriangle = out.size();
+
+    // 1-based, negative counts from the end
+    auto resolveIndex = [](int index, size_t count) -> int {
+        return index < 0 ? (int) count + index : index - 1;
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        Tokens tokens(std::string_view(text.data() + pos, end - pos));
+        pos = end + 1;
+
+        std::string_view keyword;
+        if (!tokens.next(keyword)) {
+            continue;
+        }
+
+        if (keyword == "v") {
+            Vector3 position;
+            if (!tokens.nextVector(position)) {
+                return "invalid vertex in mesh";
+            }
+            positions.push_back({position.x * scale + offset.x, position.y * scale + offset.y, position.z * scale + offset.z});
+        } else if (keyword == "vt") {
+            Vector2 uv;
+            if (!tokens.nextVector(uv)) {
+                return "invalid texture coordinate in mesh";
+            }
+            uvs.push_back(uv);
+        } else if (keyword == "f") {
+            // v, v/vt, v//vn or v/vt/vn
+            Vector3 corners[3];
+            Vector2 cornerUvs[3];
+            int numCorners = 0;
+
+            std::string_view token;
+            while (tokens.next(token)) {
+                int indices[2] = {0, 0};
+                const char* cursor = token.data();
+                const char* tokenEnd = token.data() + token.size();
+                for (int i = 0; i < 2 && cursor < tokenEnd; i++) {
+                    cursor = std::from_chars(cursor, tokenEnd, indices[i]).ptr;
+                    while (cursor < tokenEnd && *cursor != '/') {
+                        cursor++;
+                    }
+                    cursor++;
+                }
+
+                const int positionIndex = resolveIndex(indices[0], positions.size());
+                const int uvIndex = indices[1] == 0 ? -1 : resolveIndex(indices[1], uvs.size());
+                if (positionIndex < 0 || positionIndex >= (int) positions.size() || uvIndex >= (int) uvs.size()) {
+                    return "invalid face index in mesh";
+                }
+
+                const Vector3 position = positions[positionIndex];
+                const Vector2 uv = uvIndex < 0 ? Vector2{0, 0} : uvs[uvIndex];
+
+                if (numCorners < 3) {
+                    corners[numCorners] = position;
+                    cornerUvs[numCorners] = uv;
+                    numCorners++;
+                } else {
+                    // fan around the first corner
+                    corners[1] = corners[2];
+                    cornerUvs[1] = cornerUvs[2];
+                    corners[2] = position;
+                    cornerUvs[2] = uv;
+                }
+
+                if (numCorners == 3) {
+                    out.push_back({corners[0], corners[1], corners[2], cornerUvs[0], cornerUvs[1], cornerUvs[2], material});
+                }
+            }
+        }
+    }
+
+    TRACE("    Loaded mesh '%s' with %u triangles", fileName.c_str(), (unsigned) (out.size() - firstTriangle));
+    return nullptr;
+}
+
+
+// returns an error message, or nullptr
+template <typename MaterialRef>
+static const char* parseLine(std::string_view line, const std::string& directory, Chunk& chunk, MaterialRef&& materialRef) {
+    Tokens tokens(line);
+    std::string_view keyword;
+    if (!tokens.next(keyword)) {
+        return nullptr;
+    }
+
+    if (keyword == "sphere") {
+        std::string_view material;
+        SphereDesc sphere;
+        if (!tokens.next(material) || !tokens.nextVector(sphere.position) || !tokens.nextFloat(sphere.radius)) {
+            return "expected: sphere <material> <x> <y> <z> <radius>";
+        }
+        sphere.material = materialRef(material);
+        chunk.spheres.push_back(sphere);
+    }
+
+    else if (keyword == "triangle") {
+        std::string_view material;
+        TriangleDesc triangle;
+        if (!tokens.next(material) || !tokens.nextVector(triangle.v0) || !tokens.nextVector(triangle.v1) || !tokens.nextVector(triangle.v2)) {
+            return "expected: triangle <material> <x0> <y0> <z0> <x1> <y1> <z1> <x2> <y2> <z2> [<u0> <v0> <u1> <v1> <u2> <v2>]";
+        }
+        // same defaults as rt::Triangle
+        triangle.uv0 = {0, 0};
+        triangle.uv1 = {0, 1};
+        triangle.uv2 = {1, 0};
+        if (!tokens.empty() && (!tokens.nextVector(triangle.uv0) || !tokens.nextVector(triangle.uv1) || !tokens.nextVector(triangle.uv2))) {
+            return "expected six texture coordinates after the vertices";
+        }
+        triangle.material = materialRef(material);
+        chunk.triangles.push_back(triangle);
+    }
+
+    else if (keyword == "mesh") {
+        std::string_view material;
+        std::string_view path;
+        Vector3 offset = {0, 0, 0};
+        float scale = 1.0f;
+        if (!tokens.next(material) || !tokens.next(path)) {
+            return "expected: mesh <material> <file.obj> [<x> <y> <z> [<scale>]]";
+        }
+        if (!tokens.empty() && (!tokens.nextVector(offset) || (!tokens.empty() && !tokens.nextFloat(scale)))) {
+            return "expected: mesh <material> <file.obj> [<x> <y> <z> [<scale>]]";
+        }
+        if (const char* error = loadObj(resolvePath(directory, path), materialRef(material), offset, scale, chunk.triangles)) {
+            return error;
+        }
+    }
+
+    else if (keyword == "material") {
+        std::string_view name;
+        if (!tokens.next(name)) {
+            return "expected: material <name> [albedo ...] [roughness ...]";
+        }
+        MaterialDesc& material = chunk.materials.emplace_back();
+        material.name = name;
+
+        std::string_view key;
+        while (tokens.next(key)) {
+            if (key == "albedo") {
+                if (tokens.nextVector(material.albedo)) {
+                    tokens.nextFloat(material.albedoDeviation);
+                } else {
+                    std::string_view path;
+                    if (!tokens.next(path)) {
+                        return "expected albedo color or image";
+                    }
+                    material.albedoMap = resolvePath(directory, path);
+                }
+            } else if (key == "roughness") {
+                if (tokens.nextFloat(material.roughness)) {
+                    tokens.nextFloat(material.roughnessDeviation);
+                } else {
+                    std::string_view path;
+                    if (!tokens.next(path)) {
+                        return "expected roughness value or image";
+                    }
+                    material.roughnessMap = resolvePath(directory, path);
+                }
+            } else {
+                return "unknown material property";
+            }
+        }
+    }
+
+    else if (keyword == "camera") {
+        rt::CameraPose camera;
+        if (!tokens.nextVector(camera.position) || !tokens.nextVector(camera.direction) || !tokens.nextFloat(camera.fov)) {
+            return "expected: camera <x> <y> <z> <dirX> <dirY> <dirZ> <fov>";
+        }
+        chunk.cameras.push_back(camera);
+    }
+
+    else if (keyword == "background") {
+        Vector3 color;
+        if (!tokens.nextVector(color)) {
+            return "expected: background <r> <g> <b>";
+        }
+        chunk.hasBackground = true;
+        chunk.background = {(unsigned char) color.x, (unsigned char) color.y, (unsigned char) color.z, 255};
+    }
+
+    else if (keyword == "environment") {
+        std::string_view path;
+        if (!tokens.next(path)) {
+            return "expected: environment <image> [<intensity>]";
+        }
+        chunk.hasEnvironment = true;
+        chunk.environmentMap = resolvePath(directory, path);
+        chunk.environmentIntensity = 1.0f;
+        tokens.nextFloat(chunk.environmentIntensity);
+    }
+
+    else {
+        return "unknown statement";
+    }
+
+    if (!tokens.empty()) {
+        return "unexpected values at the end of the line";
+    }
+    return nullptr;
+}
+
+
+static Chunk parseChunk(const std::string& text, uint32_t firstLine, const std::string& directory) {
+    PROFILE_FUNCTION();
+    Chunk chunk;
+
+    // the names point into the text, which outlives the parsing
+    std::unordered_map<std::string_view, uint32_t> materialIndices;
+    auto materialRef = [&](std::string_view name) {
+        const auto [it, inserted] = materialIndices.try_emplace(name, (uint32_t) chunk.materialNames.size());
+        if (inserted) {
+            chunk.materialNames.emplace_back(name);
+        }
+        return it->second;
+    };
+
+    size_t pos = 0;
+    uint32_t lineNumber = firstLine;
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        std::string_view line(text.data() + pos, end - pos);
+        pos = end + 1;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string_view::npos) {
+            line = line.substr(0, comment);
+        }
+
+        if (const char* error = parseLine(line, directory, chunk, materialRef)) {
+            chunk.error = error;
+            chunk.errorLine = lineNumber;
+            break;
+        }
+        lineNumber++;
+    }
+
+    return chunk;
+}
+
+
+static bool mergeChunks(std::vector<Chunk>& chunks, const char* fileName, Description& desc) {
+    PROFILE_FUNCTION();
+    std::unordered_map<std::string, uint32_t> materialIndices;
+    size_t numSpheres = 0;
+    size_t numTriangles = 0;
+
+    // materials first, objects may use materials defined in later chunks
+    for (Chunk& chunk : chunks) {
+        if (chunk.error) {
+            INFO("Failed to parse scene '%s', line %u: %s", fileName, chunk.errorLine, chunk.error);
+            return false;
+        }
+
+        for (MaterialDesc& material : chunk.materials) {
+            if (!materialIndices.try_emplace(material.name, (uint32_t) desc.materials.size()).second) {
+                INFO("Material '%s' is defined twice in scene '%s'", material.name.c_str(), fileName);
+                return false;
+            }
+            desc.materials.push_back(std::move(material));
+        }
+
+        desc.cameras.insert(desc.cameras.end(), chunk.cameras.begin(), chunk.cameras.end());
+        if (chunk.hasBackground) {
+            desc.background = chunk.background;
+        }
+        if (chunk.hasEnvironment) {
+            desc.environmentMap = chunk.environmentMap;
+            desc.environmentIntensity = chunk.environmentIntensity;
+        }
+        numSpheres += chunk.spheres.size();
+        numTriangles += chunk.triangles.size();
+    }
+
+    desc.spheres.reserve(numSpheres);
+    desc.triangles.reserve(numTriangles);
+
+    for (Chunk& chunk : chunks) {
+        std::vector<uint32_t> remap;
+        for (const std::string& name : chunk.materialNames) {
+            auto it = materialIndices.find(name);
+            if (it == materialIndices.end()) {
+                INFO("Scene '%s' uses undefined material '%s'", fileName, name.c_str());
+                return false;
+            }
+            remap.push_back(it->second);
+        }
+
+        for (SphereDesc sphere : chunk.spheres) {
+            sphere.material = remap[sphere.material];
+            desc.spheres.push_back(sphere);
+        }
+        for (TriangleDesc triangle : chunk.triangles) {
+            triangle.material = remap[triangle.material];
+            desc.triangles.push_back(triangle);
+        }
+
+        // freeing as we go, the chunks hold a copy of every object
+        chunk = {};
+    }
+
+    return true;
+}
+
+
+static bool parseText(FILE* file, const char* fileName, Description& desc) {
+    PROFILE_FUNCTION();
+    ThreadPool& pool = ThreadPool::get();
+    // chunks waiting to be parsed, so a fast disk does not pull the whole file into memory
+    const size_t maxQueued = pool.getThreadCount() * 2;
+    const std::string directory = std::filesystem::path(fileName).parent_path().string();
+
+    std::vector<std::future<Chunk>> futures;
+    size_t numWaited = 0;
+    std::string carry;
+    uint32_t lineNumber = 1;
+
+    while (true) {
+        std::string text = std::move(carry);
+        carry = {};
+
+        const size_t start = text.size();
+        text.resize(start + chunkSize);
+        const size_t read = fread(text.data() + start, 1, chunkSize, file);
+        text.resize(start + read);
+        const bool last = read < chunkSize;
+
+        if (!last) {
+            // the partial line at the end goes to the next chunk
+            const size_t lineEnd = text.rfind('\n');
+            if (lineEnd == std::string::npos) {
+                carry = std::move(text);
+                continue;
+            }
+            carry.assign(text, lineEnd + 1, std::string::npos);
+            text.resize(lineEnd + 1);
+        }
+
+        const uint32_t numLines = std::count(text.begin(), text.end(), '\n');
+        futures.push_back(pool.submit([text = std::move(text), lineNumber, &directory]() {
+            return parseChunk(text, lineNumber, directory);
+        }));
+        lineNumber += numLines;
+
+        while (futures.size() - numWaited > maxQueued) {
+            futures[numWaited++].wait();
+        }
+
+        if (last) {
+            break;
+        }
+    }
+
+    std::vector<Chunk> chunks;
+    chunks.reserve(futures.size());
+    for (std::future<Chunk>& future : futures) {
+        chunks.push_back(future.get());
+    }
+    TRACE("    Parsed '%s' in %u chunks on %u threads", fileName, (unsigned) chunks.size(), pool.getThreadCount());
+
+    return mergeChunks(chunks, fileName, desc);
+}
+
+
+static bool readString(FILE* file, std::string& value) {
+    uint16_t size;
+    if (fread(&size, sizeof(size), 1, file) != 1) {
+        return false;
+    }
+    value.resize(size);
+    return size == 0 || fread(value.data(), 1, size, file) == size;
+}
+
+
+static void writeString(FILE* file, const std::string& value) {
+    const uint16_t size = std::min(value.size(), (size_t) UINT16_MAX);
+    fwrite(&size, sizeof(size), 1, file);
+    fwrite(value.data(), 1, size, file);
+}
+
+
+template <typename T>
+static bool readArray(FILE* file, uint32_t count, uint64_t remainingBytes, std::vector<T>& out) {
+    // counts come from the file, nothing is allocated for more elements than it can hold
+    if ((uint64_t) count * sizeof(T) > remainingBytes) {
+        return false;
+    }
+    out.resize(count);
+    return count == 0 || fread(out.data(), sizeof(T), count, file) == count;
+}
+
+
+// of the file's bytes after the current position
+static uint64_t getRemainingBytes(FILE* file, uint64_t fileSize) {
+#if defined(_WIN32)
+    const int64_t position = _ftelli64(file);
+#else
+    const int64_t position = ftello(file);
+#endif
+    return position >= 0 && (uint64_t) position <= fileSize ? fileSize - position : 0;
+}
+
+
+static bool parseBinary(FILE* file, const char* fileName, Description& desc) {
+    PROFILE_FUNCTION();
+    BinaryHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.version == 0 || header.version > binaryVersion) {
+        INFO("Scene '%s' has an unsupported binary version", fileName);
+        return false;
+    }
+
+    std::error_code error;
+    const uint64_t fileSize = std::filesystem::file_size(fileName, error);
+    if (error) {
+        INFO("Failed to get the size of scene '%s'", fileName);
+        return false;
+    }
+
+    desc.background = header.background;
+    if (header.version >= 2) {
+        if (!readString(file, desc.environmentMap) || fread(&desc.environmentIntensity, sizeof(float), 1, file) != 1) {
+            INFO("Scene '%s' is truncated", fileName);
+            return false;
+        }
+    }
+    // six floats and three string lengths each, at least
+    const uint64_t minMaterialSize = 6 * sizeof(float) + 3 * sizeof(uint16_t);
+    if ((uint64_t) header.numMaterials * minMaterialSize > getRemainingBytes(file, fileSize)) {
+        INFO("Scene '%s' is truncated", fileName);
+        return false;
+    }
+    desc.materials.resize(header.numMaterials);
+    for (MaterialDesc& material : desc.materials) {
+        float values[6];
+        if (fread(values, sizeof(values), 1, file) != 1 || !readString(file, material.name) || !readString(file, material.albedoMap) || !readString(file, material.roughnessMap)) {
+            INFO("Scene '%s' is truncated", fileName);
+            return false;
+        }
+        material.albedo = {values[0], values[1], values[2]};
+        material.albedoDeviation = values[3];
+        material.roughness = values[4];
+        material.roughnessDeviation = values[5];
+    }
+
+    const auto readCounted = [&](uint32_t count, auto& out) { return readArray(file, count, getRemainingBytes(file, fileSize), out); };
+    if (!readCounted(header.numSpheres, desc.spheres) || !readCounted(header.numTriangles, desc.triangles) || !readCounted(header.numCameras, desc.cameras)) {
+        INFO("Scene '%s' is truncated", fileName);
+        return false;
+    }
+
+    const auto badMaterial = [&](const auto& obj) { return obj.material >= header.numMaterials; };
+    if (std::any_of(desc.spheres.begin(), desc.spheres.end(), badMaterial) || std::any_of(desc.triangles.begin(), desc.triangles.end(), badMaterial)) {
+        INFO("Scene '%s' references a material that does not exist", fileName);
+        return false;
+    }
+
+    return true;
+}
+
+
+bool parse(const char* fileName, Description& desc) {
+    FILE* file = fopen(fileName, "rb");
+    if (file == nullptr) {
+        INFO("Failed to open scene '%s'", fileName);
+        return false;
+    }
+
+    char magic[4] = {};
+    const bool binary = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, binaryMagic, sizeof(magic)) == 0;
+    rewind(file);
+
+    const bool parsed = binary ? parseBinary(file, fileName, desc) : parseText(file, fileName, desc);
+    fclose(file);
+    return parsed;
+}
+
+
+bool saveBinary(const char* fileName, const Description& desc) {
+    PROFILE_FUNCTION();
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for writing the scene", fileName);
+        return false;
+    }
+
+    BinaryHeader header;
+    memcpy(header.magic, binaryMagic, sizeof(binaryMagic));
+    header.version = binaryVersion;
+    header.numMaterials = desc.materials.size();
+    header.numSpheres = desc.spheres.size();
+    header.numTriangles = desc.triangles.size();
+    header.numCameras = desc.cameras.size();
+    header.background = desc.background;
+    fwrite(&header, sizeof(header), 1, file);
+    writeString(file, desc.environmentMap);
+    fwrite(&desc.environmentIntensity, sizeof(float), 1, file);
+
+    for (const MaterialDesc& material : desc.materials) {
+        const float values[6] = {
+            material.albedo.x, material.albedo.y, material.albedo.z, material.albedoDeviation,
+            material.roughness, material.roughnessDeviation,
+        };
+        fwrite(values, sizeof(values), 1, file);
+        writeString(file, material.name);
+        writeString(file, material.albedoMap);
+        writeString(file, material.roughnessMap);
+    }
+
+    fwrite(desc.spheres.data(), sizeof(SphereDesc), desc.spheres.size(), file);
+    fwrite(desc.triangles.data(), sizeof(TriangleDesc), desc.triangles.size(), file);
+    fwrite(desc.cameras.data(), sizeof(rt::CameraPose), desc.cameras.size(), file);
+
+    const bool written = ferror(file) == 0;
+    fclose(file);
+
+    if (!written) {
+        INFO("Failed to write scene '%s'", fileName);
+        return false;
+    }
+    INFO("Wrote scene '%s' (%u materials, %u spheres, %u triangles)", fileName, header.numMaterials, header.numSpheres, header.numTriangles);
+    return true;
+}
+
+
+void build(const Description& desc, rt::SceneBuilder& builder) {
+    PROFILE_FUNCTION();
+    builder.setBackgroundColor(desc.background);
+    for (const rt::CameraPose& pose : desc.cameras) {
+        builder.addCamera(pose);
+    }
+    if (!desc.environmentMap.empty()) {
+        // the scene keeps its background color when the map fails to load
+        if (std::shared_ptr<rt::EnvironmentMap> environment = rt::EnvironmentMap::load(desc.environmentMap.c_str())) {
+            builder.setEnvironment(environment, desc.environmentIntensity);
+        }
+    }
+
+    // handles of the builder, it may hold materials already
+    std::vector<rt::MaterialHandle> materials;
+    for (const MaterialDesc& materialDesc : desc.materials) {
+        auto material = std::make_shared<rt::Material>();
+
+        if (materialDesc.albedoMap.empty()) {
+            material->setAlbedo({.value = materialDesc.albedo, .deviation = materialDesc.albedoDeviation});
+        } else {
+            material->setAlbedo(materialDesc.albedoMap.c_str());
+        }
+
+        if (materialDesc.roughnessMap.empty()) {
+            material->setRoughness({.value = materialDesc.roughness, .deviation = materialDesc.roughnessDeviation});
+        } else {
+            material->setRoughness(materialDesc.roughnessMap.c_str());
+        }
+
+        materials.push_back(builder.addMaterial(material));
+    }
+
+    builder.reserveSpheres(desc.spheres.size());
+    for (const SphereDesc& sphere : desc.spheres) {
+        builder.addSphere(sphere.position, sphere.radius, materials[sphere.material]);
+    }
+
+    builder.reserveTriangles(desc.triangles.size());
+    for (const TriangleDesc& triangle : desc.triangles) {
+        builder.addTriangle(triangle.v0, triangle.v1, triangle.v2, triangle.uv0, triangle.uv1, triangle.uv2, materials[triangle.material]);
+    }
+}
+
+
+bool load(const char* fileName, rt::SceneBuilder& builder) {
+    PROFILE_FUNCTION();
+    const auto start = std::chrono::steady_clock::now();
+
+    Description desc;
+    if (!parse(fileName, desc)) {
+        return false;
+    }
+    const auto parsed = std::chrono::steady_clock::now();
+
+    builder = rt::SceneBuilder();
+    build(desc, builder);
+    const auto built = std::chrono::steady_clock::now();
+
+    std::error_code error;
+    const double megabytes = std::filesystem::file_size(fileName, error) / (1024.0 * 1024.0);
+    const double parseSeconds = std::chrono::duration<double>(parsed - start).count();
+    const double buildSeconds = std::chrono::duration<double>(built - parsed).count();
+    const size_t numObjects = desc.spheres.size() + desc.triangles.size();
+
+    INFO(
+        "Loaded scene '%s' (%u materials, %u spheres, %u triangles, %u cameras)",
+        fileName, (unsigned) desc.materials.size(), (unsigned) desc.spheres.size(), (unsigned) desc.triangles.size(), (unsigned) desc.cameras.size()
+    );
+    INFO(
+        "    parsed %.1f MB in %.3f s (%.1f MB/s, %.2f M objects/s), built in %.3f s",
+        megabytes, parseSeconds, megabytes / parseSeconds, numObjects / parseSeconds / 1e6, buildSeconds
+    );
+    return true;
+}
+
+
+} // namespace scenefile
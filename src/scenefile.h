@@ -0,0 +1,82 @@
+#pragma once
+
+#include "src/scenebuilder.h"
+#include <raylib/raylib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+// scene files, either text for writing by hand or binary (see saveBinary) for large scenes
+//
+// the text format has one statement per line, '#' starts a comment
+//     background <r> <g> <b>                                               (0 - 255)
+//     environment <image> [<intensity>]                                    (equirectangular, .hdr for hdr)
+//     camera <x> <y> <z> <dirX> <dirY> <dirZ> <fov>
+//     material <name> [albedo (<r> <g> <b> [<deviation>] | <image>)] [roughness (<value> [<deviation>] | <image>)]
+//     sphere <material> <x> <y> <z> <radius>
+//     triangle <material> <x0> <y0> <z0> <x1> <y1> <z1> <x2> <y2> <z2> [<u0> <v0> <u1> <v1> <u2> <v2>]
+//     mesh <material> <file.obj> [<x> <y> <z> [<scale>]]
+// materials are referenced by name and may be defined anywhere in the file
+// an environment map lights the scene in place of the background color
+// image and mesh paths are relative to the scene file, and cannot contain spaces
+
+
+namespace scenefile {
+
+
+struct MaterialDesc {
+    std::string name;
+    // maps replace the constant values when set
+    Vector3 albedo = {0.9, 0.9, 0.9};
+    float albedoDeviation = 0.1;
+    std::string albedoMap;
+    float roughness = 1.0;
+    float roughnessDeviation = 0.01;
+    std::string roughnessMap;
+};
+
+
+struct SphereDesc {
+    Vector3 position;
+    float radius;
+    uint32_t material;
+};
+
+
+struct TriangleDesc {
+    Vector3 v0;
+    Vector3 v1;
+    Vector3 v2;
+    Vector2 uv0;
+    Vector2 uv1;
+    Vector2 uv2;
+    uint32_t material;
+};
+
+
+// a parsed file, objects refer to materials by index
+struct Description {
+    Color background = {200, 200, 200, 255};
+    // empty when there is none
+    std::string environmentMap;
+    float environmentIntensity = 1.0f;
+    std::vector<MaterialDesc> materials;
+    std::vector<SphereDesc> spheres;
+    std::vector<TriangleDesc> triangles;
+    std::vector<rt::CameraPose> cameras;
+};
+
+
+// text or binary, told apart by the binary header
+// text is parsed in chunks on the thread pool while the rest of the file is read,
+// so this must not be called from a pool task
+bool parse(const char* fileName, Description& desc);
+bool saveBinary(const char* fileName, const Description& desc);
+// adds the description's materials, objects, lighting and cameras to the builder
+void build(const Description& desc, rt::SceneBuilder& builder);
+// parse() and build() into an empty builder, logging the load throughput
+bool load(const char* fileName, rt::SceneBuilder& builder);
+
+
+} // namespace scenefile
@@ -0,0 +1,155 @@
+#include "src/shadercache.h"
+#include "src/glext.h"
+#include "src/hash.h"
+#include "src/logger.h"
+#include <raylib/raylib.h>
+#include <raylib/rlgl.h>
+#include <cstring>
+#include <filesystem>
+
+
+namespace shadercache {
+
+
+static std::string cacheDirectory = "cache/shaders";
+
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+};
+
+
+static const char fileMagic[4] = {'R', 'T', 'S', 'C'};
+static const uint32_t fileVersion = 1;
+
+
+static uint64_t hashString(const char* str, uint64_t hash) {
+    // hashing the terminator too, so ("ab", "c") and ("a", "bc") differ
+    return hashBytes(str, strlen(str) + 1, hash);
+}
+
+
+static std::string getFilePath(uint64_t key) {
+    return cacheDirectory + TextFormat("/%016llx.bin", (unsigned long long) key);
+}
+
+
+static bool binariesSupported() {
+    static const bool supported = glext::getInteger(glext::NUM_PROGRAM_BINARY_FORMATS) > 0;
+    return supported;
+}
+
+
+void setDirectory(const char* directory) {
+    cacheDirectory = directory;
+}
+
+
+uint64_t makeKey(const char* source, const Defines& defines) {
+    uint64_t hash = hashSeed;
+
+    hash = hashString(source, hash);
+    for (const auto& [name, value] : defines) {
+        hash = hashString(name.c_str(), hash);
+        hash = hashString(value.c_str(), hash);
+    }
+
+    // binaries are only valid for the driver that produced them
+    hash = hashString(glext::getString(glext::VENDOR), hash);
+    hash = hashString(glext::getString(glext::RENDERER), hash);
+    hash = hashString(glext::getString(glext::VERSION), hash);
+
+    return hash;
+}
+
+
+uint32_t loadProgram(uint64_t key) {
+    if (!binariesSupported()) {
+        return 0;
+    }
+
+    const std::string path = getFilePath(key);
+    if (!FileExists(path.c_str())) {
+        TRACE("Shader cache miss [key: %016llx]", (unsigned long long) key);
+        return 0;
+    }
+
+    int dataSize = 0;
+    unsigned char* data = LoadFileData(path.c_str(), &dataSize);
+    if (data == nullptr) {
+        return 0;
+    }
+
+    FileHeader header;
+    bool valid = dataSize >= (int) sizeof(FileHeader);
+    if (valid) {
+        memcpy(&header, data, sizeof(FileHeader));
+        valid = memcmp(header.magic, fileMagic, 4) == 0
+            && header.version == fileVersion
+            && header.key == key
+            && header.binarySize == dataSize - sizeof(FileHeader);
+    }
+
+    uint32_t program = 0;
+    if (valid) {
+        program = glext::createProgram();
+        glext::programBinary(program, header.binaryFormat, data + sizeof(FileHeader), header.binarySize);
+
+        // drivers reject binaries after updates even when the version string is unchanged
+        if (glext::getProgramInteger(program, glext::LINK_STATUS) == 0) {
+            INFO("Cached shader binary was rejected by the driver, recompiling [key: %016llx]", (unsigned long long) key);
+            rlUnloadShaderProgram(program);
+            program = 0;
+        }
+    } else {
+        INFO("Cached shader binary '%s' is invalid, recompiling", path.c_str());
+    }
+
+    UnloadFileData(data);
+
+    if (program != 0) {
+        TRACE("Loaded shader binary from cache [key: %016llx | ID: %u]", (unsigned long long) key, program);
+    }
+    return program;
+}
+
+
+void storeProgram(uint64_t key, uint32_t program) {
+    if (!binariesSupported() || program == 0) {
+        return;
+    }
+
+    const int binarySize = glext::getProgramInteger(program, glext::PROGRAM_BINARY_LENGTH);
+    if (binarySize <= 0) {
+        return;
+    }
+
+    std::vector<unsigned char> data(sizeof(FileHeader) + binarySize);
+    FileHeader header;
+    memcpy(header.magic, fileMagic, 4);
+    header.version = fileVersion;
+    header.key = key;
+
+    int length = 0;
+    glext::getProgramBinary(program, binarySize, &length, &header.binaryFormat, data.data() + sizeof(FileHeader));
+    if (length <= 0) {
+        return;
+    }
+    header.binarySize = length;
+    memcpy(data.data(), &header, sizeof(FileHeader));
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+
+    const std::string path = getFilePath(key);
+    if (SaveFileData(path.c_str(), data.data(), sizeof(FileHeader) + length)) {
+        TRACE("Stored shader binary in cache '%s' (%d bytes)", path.c_str(), length);
+    }
+}
+
+
+} // namespace shadercache
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// on-disk cache of linked program binaries
+// a key covers the shader source, the text substitutions applied to it and the GL driver
+
+
+namespace shadercache {
+
+
+using Defines = std::vector<std::pair<std::string, std::string>>;
+
+
+void setDirectory(const char* directory);
+uint64_t makeKey(const char* source, const Defines& defines);
+// returns 0 when there is no usable binary for the key
+uint32_t loadProgram(uint64_t key);
+void storeProgram(uint64_t key, uint32_t program);
+
+
+} // namespace shadercache
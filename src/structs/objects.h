@@ -2,6 +2,7 @@
 #pragma once
 
 #include <raylib/raylib.h>
+#include <stdint.h>
 
 
 namespace rt::internal {
@@ -37,4 +38,55 @@ struct Triangle {
 };
 
 
+// compact and quantized layouts (storage buffers only), see primitiveencoding.h
+// triangles keep what intersection tests read apart from what is only read for the closest hit
+
+
+struct CompactSphere {
+    // 16 bytes
+    Vector3 position;
+    // radius as a half float in the low bits, material cell in the high ones
+    uint32_t radiusMaterial;
+};
+
+
+struct CompactTriangle {
+    // 36 bytes, no padding (an array of floats in the shader)
+    Vector3 v0;
+    Vector3 edge1;
+    Vector3 edge2;
+};
+
+
+struct QuantizedSphere {
+    // 12 bytes
+    // 21 bits per axis relative to the scene bounds
+    uint32_t position[2];
+    uint32_t radiusMaterial;
+};
+
+
+struct QuantizedTriangle {
+    // 24 bytes
+    // every vertex is quantized on its own, so shared vertices stay shared and meshes stay closed
+    uint32_t vertices[3][2];
+};
+
+
+// closest-hit data of compact and quantized triangles
+struct TriangleAttributes {
+    // 16 bytes
+    // half float uvs
+    uint32_t uvs[3];
+    uint32_t materialIndex;
+};
+
+
+static_assert(sizeof(CompactSphere) == 16);
+static_assert(sizeof(CompactTriangle) == 36);
+static_assert(sizeof(QuantizedSphere) == 12);
+static_assert(sizeof(QuantizedTriangle) == 24);
+static_assert(sizeof(TriangleAttributes) == 16);
+
+
 } // namespace rt::internal
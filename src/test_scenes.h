@@ -44,7 +44,7 @@ std::unique_ptr<rt::CompiledScene> createRandomScene(int numSpheres, int numMats
 
     scene.backgroundColor = {210, 210, 240, 255};
 
-    return std::make_unique<rt::CompiledScene>(scene, Vector2{2048, 2048});
+    return std::make_unique<rt::CompiledScene>(scene);
 }
 
 
@@ -102,7 +102,7 @@ std::unique_ptr<rt::CompiledScene> createScene_1() {
 
     scene.backgroundColor = {200, 200, 200, 255};
 
-    return std::make_unique<rt::CompiledScene>(scene, Vector2{4096, 4096});
+    return std::make_unique<rt::CompiledScene>(scene);
 }
 
 
@@ -172,5 +172,5 @@ std::unique_ptr<rt::CompiledScene> createScene_2() {
 
     scene.backgroundColor = {200, 200, 200, 255};
 
-    return std::make_unique<rt::CompiledScene>(scene, Vector2{4096, 4096});
+    return std::make_unique<rt::CompiledScene>(scene);
 }
@@ -0,0 +1,61 @@
+#include "src/threadpool.h"
+#include "src/logger.h"
+#include "src/profiler.h"
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned numThreads) {
+    for (unsigned i = 0; i < numThreads; i++) {
+        m_threads.emplace_back([this]() { run(); });
+    }
+    TRACE("Created thread pool with %u threads", numThreads);
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (std::thread& thread : m_threads) {
+        thread.join();
+    }
+}
+
+
+ThreadPool& ThreadPool::get() {
+    // hardware_concurrency() may report 0
+    static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+
+void ThreadPool::push(std::function<void()> task) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+
+void ThreadPool::run() {
+    PROFILE_THREAD_NAME("pool worker");
+
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+            // the queue is drained before stopping
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
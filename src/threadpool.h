@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// fixed set of worker threads running queued tasks in submission order
+class ThreadPool {
+
+public:
+    explicit ThreadPool(unsigned numThreads);
+    // waits for the queued tasks to finish
+    ~ThreadPool();
+    unsigned getThreadCount() const { return m_threads.size(); }
+
+    template <typename Fn>
+    auto submit(Fn&& fn) -> std::future<std::invoke_result_t<Fn>> {
+        using Result = std::invoke_result_t<Fn>;
+        // packaged_task is move-only, std::function needs a copyable callable
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> result = task->get_future();
+        push([task]() { (*task)(); });
+        return result;
+    }
+
+    // shared by asset loading, sized to leave a core for the render loop
+    static ThreadPool& get();
+
+private:
+    void push(std::function<void()> task);
+    void run();
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<std::function<void()>> m_tasks;
+    bool m_stopping = false;
+};
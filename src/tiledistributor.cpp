@@ -0,0 +1,215 @@
+#include "src/tiledistributor.h"
+#include "src/logger.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <string.h>
+
+
+// milliseconds to wait in poll for worker replies
+static const int replyTimeout = 100;
+
+
+TileDistributor::TileDistributor(const TileDistributorParams& params)
+    : m_params(params) {
+
+    const int width = params.imageSize.x;
+    const int height = params.imageSize.y;
+    // a single tile covering the image is exactly a single-process render
+    m_tileSize = params.tileSize > 0 ? params.tileSize : std::max(width, height);
+    // dispatches only cover whole workgroups
+    m_tileSize = (m_tileSize + 7) / 8 * 8;
+    m_tilesX = (width + m_tileSize - 1) / m_tileSize;
+    m_tilesY = (height + m_tileSize - 1) / m_tileSize;
+}
+
+
+bool TileDistributor::render(std::vector<float>& pixels) {
+    // there is no window here, so no raylib timer
+    const auto startTime = std::chrono::steady_clock::now();
+    const int numTiles = m_tilesX * m_tilesY;
+    pixels.assign((size_t) m_params.imageSize.x * m_params.imageSize.y * 4, 0.0f);
+
+    m_workers.clear();
+    for (const std::string& path : m_params.workers) {
+        std::unique_ptr<ipc::Connection> connection = ipc::Connection::connect(path.c_str());
+        if (connection) {
+            Worker worker;
+            worker.path = path;
+            worker.connection = std::move(connection);
+            m_workers.push_back(std::move(worker));
+        }
+    }
+
+    m_pendingTiles.clear();
+    for (int i = 0; i < numTiles; i++) {
+        m_pendingTiles.push_back(i);
+    }
+    m_tilesDone = 0;
+
+    INFO(
+        "Distributing %d x %d image as %d tiles of %d x %d to %u workers", (int) m_params.imageSize.x, (int) m_params.imageSize.y,
+        numTiles, m_tileSize, m_tileSize, (unsigned) m_workers.size()
+    );
+
+    while (m_tilesDone < numTiles) {
+        bool anyWorker = false;
+        std::vector<ipc::Connection*> connections;
+
+        for (Worker& worker : m_workers) {
+            if (!worker.connection->isOpen()) {
+                continue;
+            }
+            anyWorker = true;
+
+            const auto inFlight = [&]() { return worker.sentTiles.size() + worker.jobs.size(); };
+            while (!m_pendingTiles.empty() && inFlight() < (size_t) m_params.tilesPerWorker) {
+                sendTile(worker, m_pendingTiles.front());
+                m_pendingTiles.pop_front();
+            }
+            worker.connection->flush();
+            connections.push_back(worker.connection.get());
+        }
+
+        if (!anyWorker) {
+            INFO("No render workers left, %d of %d tiles were rendered", m_tilesDone, numTiles);
+            return false;
+        }
+
+        ipc::wait(connections, replyTimeout);
+
+        for (Worker& worker : m_workers) {
+            if (worker.connection->isOpen()) {
+                worker.connection->receive();
+                if (!handleReplies(worker, pixels)) {
+                    return false;
+                }
+            }
+            // closed by any call, including the flush after sending
+            const bool holdsTiles = !worker.sentTiles.empty() || !worker.jobs.empty();
+            if (!worker.connection->isOpen() && holdsTiles) {
+                INFO("Render worker '%s' disconnected, its %u tiles are requeued", worker.path.c_str(), (unsigned) (worker.sentTiles.size() + worker.jobs.size()));
+                requeueTiles(worker);
+            }
+        }
+    }
+
+    const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+    INFO("Rendered %d tiles in %f seconds", numTiles, seconds);
+    for (const Worker& worker : m_workers) {
+        INFO("    '%s': %d tiles", worker.path.c_str(), worker.tilesDone);
+    }
+    return true;
+}
+
+
+void TileDistributor::sendTile(Worker& worker, int tile) {
+    const int x = (tile % m_tilesX) * m_tileSize;
+    const int y = (tile / m_tilesX) * m_tileSize;
+
+    // edge tiles reach past the image, the extra pixels are dropped when merging
+    worker.connection->sendLine(TextFormat(
+        "render 0 %s %u %d %d - size %d %d region %d %d %d %d float",
+        m_params.scenePath.c_str(), m_params.frames, (int) m_params.config.numSamples, (int) m_params.config.bounceLimit,
+        (int) m_params.imageSize.x, (int) m_params.imageSize.y, x, y, m_tileSize, m_tileSize
+    ));
+    worker.sentTiles.push_back(tile);
+}
+
+
+bool TileDistributor::handleReplies(Worker& worker, std::vector<float>& pixels) {
+    ipc::Connection& connection = *worker.connection;
+    std::string line;
+
+    while (true) {
+        if (worker.imageBytes > 0) {
+            std::vector<float> tilePixels(worker.imageBytes / sizeof(float));
+            if (!connection.nextBytes(worker.imageBytes, tilePixels.data())) {
+                return true;
+            }
+
+            auto it = worker.jobs.find(worker.imageJob);
+            if (it != worker.jobs.end()) {
+                mergeTile(it->second, tilePixels, pixels);
+                worker.jobs.erase(it);
+                worker.tilesDone++;
+                m_tilesDone++;
+            }
+            worker.imageBytes = 0;
+            continue;
+        }
+
+        if (!connection.nextLine(line)) {
+            return true;
+        }
+
+        std::istringstream tokens(line);
+        std::string reply;
+        tokens >> reply;
+
+        if (reply == "queued") {
+            uint32_t job = 0;
+            tokens >> job;
+            if (!worker.sentTiles.empty()) {
+                worker.jobs[job] = worker.sentTiles.front();
+                worker.sentTiles.pop_front();
+            }
+        } else if (reply == "image") {
+            int width = 0;
+            int height = 0;
+            tokens >> worker.imageJob >> width >> height >> worker.imageBytes;
+            if (worker.imageBytes != (size_t) m_tileSize * m_tileSize * 4 * sizeof(float)) {
+                INFO("Render worker '%s' sent a tile of unexpected size", worker.path.c_str());
+                return false;
+            }
+        } else if (reply == "error") {
+            // the same tile would fail on every worker
+            INFO("Render worker '%s' failed: %s", worker.path.c_str(), line.c_str());
+            return false;
+        }
+    }
+}
+
+
+void TileDistributor::mergeTile(int tile, const std::vector<float>& tilePixels, std::vector<float>& pixels) const {
+    const int width = m_params.imageSize.x;
+    const int height = m_params.imageSize.y;
+    const int tileX = (tile % m_tilesX) * m_tileSize;
+    const int tileY = (tile / m_tilesX) * m_tileSize;
+    const int copyWidth = std::min(m_tileSize, width - tileX);
+    const int copyHeight = std::min(m_tileSize, height - tileY);
+
+    for (int y = 0; y < copyHeight; y++) {
+        const float* src = tilePixels.data() + (size_t) y * m_tileSize * 4;
+        float* dst = pixels.data() + ((size_t) (tileY + y) * width + tileX) * 4;
+        memcpy(dst, src, copyWidth * 4 * sizeof(float));
+    }
+}
+
+
+void TileDistributor::requeueTiles(Worker& worker) {
+    for (int tile : worker.sentTiles) {
+        m_pendingTiles.push_front(tile);
+    }
+    for (const auto& [job, tile] : worker.jobs) {
+        m_pendingTiles.push_front(tile);
+    }
+    worker.sentTiles.clear();
+    worker.jobs.clear();
+    worker.imageBytes = 0;
+}
+
+
+bool TileDistributor::saveImage(const std::vector<float>& pixels, Vector2 imageSize, const char* fileName) {
+    const Image floatImage = {(void*) pixels.data(), (int) imageSize.x, (int) imageSize.y, 1, PIXELFORMAT_UNCOMPRESSED_R32G32B32A32};
+    // copied since formatting replaces the data
+    Image image = ImageCopy(floatImage);
+    ImageFormat(&image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+    const bool saved = ExportImage(image, fileName);
+    UnloadImage(image);
+
+    if (saved) {
+        INFO("Saved distributed render as '%s'", fileName);
+    }
+    return saved;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "src/ipc.h"
+#include "src/structs/config.h"
+#include <deque>
+#include <map>
+#include <memory>
+#include <raylib/raylib.h>
+#include <string>
+#include <vector>
+
+
+struct TileDistributorParams {
+    // sockets of running render servers (--serve), started separately so each can be pinned to its own node
+    std::vector<std::string> workers;
+    // opened by the workers, so relative paths are relative to their working directory
+    std::string scenePath;
+    Vector2 imageSize;
+    // a multiple of the workgroup size, 0 sends the whole image as one tile
+    int tileSize = 256;
+    uint32_t frames;
+    rt::Config config;
+    // tiles queued on a worker at once, hides the round trip between tiles
+    int tilesPerWorker = 2;
+};
+
+
+// splits an image into tiles rendered by render server processes and merges them
+// tiles are regions of the full image (see Raytracer::setRegion()), so every pixel is traced with the same
+// rays and random sequence as in a single-process render, and the merged image is bit-identical to it
+// tiles of a worker that disconnects are handed to the others
+class TileDistributor {
+
+public:
+    TileDistributor(const TileDistributorParams& params);
+    // pixels receives rgba32f of the whole image, false when a tile failed or every worker is gone
+    bool render(std::vector<float>& pixels);
+    static bool saveImage(const std::vector<float>& pixels, Vector2 imageSize, const char* fileName);
+
+private:
+    struct Worker {
+        std::string path;
+        std::unique_ptr<ipc::Connection> connection;
+        // tiles sent and not queued yet, replies come in order
+        std::deque<int> sentTiles;
+        // tiles by job id
+        std::map<uint32_t, int> jobs;
+        // header of an image whose pixels have not all arrived
+        uint32_t imageJob = 0;
+        size_t imageBytes = 0;
+        int tilesDone = 0;
+    };
+
+private:
+    void sendTile(Worker& worker, int tile);
+    // false on a failed tile
+    bool handleReplies(Worker& worker, std::vector<float>& pixels);
+    void mergeTile(int tile, const std::vector<float>& tilePixels, std::vector<float>& pixels) const;
+    void requeueTiles(Worker& worker);
+
+private:
+    TileDistributorParams m_params;
+    int m_tileSize;
+    int m_tilesX;
+    int m_tilesY;
+    std::vector<Worker> m_workers;
+    std::deque<int> m_pendingTiles;
+    int m_tilesDone = 0;
+};
@@ -0,0 +1,174 @@
+#include "src/tiledrender.h"
+#include "src/glext.h"
+#include "src/gputimer.h"
+#include "src/logger.h"
+#include "src/memtrack.h"
+#include <algorithm>
+#include <raylib/rlgl.h>
+#include <stdint.h>
+#include <string.h>
+
+
+TiledRender::TiledRender(Raytracer& raytracer, const TiledRenderParams& params)
+    : m_raytracer(raytracer), m_params(params) {
+
+    const int width = params.imageSize.x;
+    const int height = params.imageSize.y;
+    m_tilesX = (width + params.tileSize - 1) / params.tileSize;
+    m_tilesY = (height + params.tileSize - 1) / params.tileSize;
+
+    const size_t tileBytes = (size_t) params.tileSize * params.tileSize * 4;
+    for (Readback& readback : m_readbacks) {
+        readback.buffer = glext::genBuffer();
+        glext::bindBuffer(glext::PIXEL_PACK_BUFFER, readback.buffer);
+        glext::bufferData(glext::PIXEL_PACK_BUFFER, tileBytes, nullptr, glext::STREAM_READ);
+        memtrack::add(memtrack::Kind::Buffer, readback.buffer, "tiled render", tileBytes);
+    }
+    glext::bindBuffer(glext::PIXEL_PACK_BUFFER, 0);
+
+    m_row.resize((size_t) width * params.tileSize * 3);
+    memtrack::add(memtrack::Kind::Host, (uintptr_t) m_row.data(), "tiled render", m_row.size());
+}
+
+
+TiledRender::~TiledRender() {
+    for (Readback& readback : m_readbacks) {
+        glext::deleteSync(readback.fence);
+        glext::deleteBuffer(readback.buffer);
+        memtrack::remove(memtrack::Kind::Buffer, readback.buffer);
+    }
+    memtrack::remove(memtrack::Kind::Host, (uintptr_t) m_row.data());
+}
+
+
+bool TiledRender::render(const char* fileName) {
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr) {
+        INFO("Failed to open '%s' for writing", fileName);
+        return false;
+    }
+
+    const int width = m_params.imageSize.x;
+    const int height = m_params.imageSize.y;
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    INFO("Rendering %d x %d image as %d x %d tiles of %d x %d", width, height, m_tilesX, m_tilesY, m_params.tileSize, m_params.tileSize);
+    const float startTime = GetTime();
+    m_raytracer.resize({(float) m_params.tileSize, (float) m_params.tileSize});
+
+    int tileIndex = 0;
+    bool rendered = true;
+    for (int tileY = 0; tileY < m_tilesY && rendered; tileY++) {
+        for (int tileX = 0; tileX < m_tilesX; tileX++) {
+            if (!renderTile(tileX, tileY)) {
+                rendered = false;
+                break;
+            }
+
+            // the buffer was last used two tiles ago, so its copy has usually finished
+            Readback& readback = m_readbacks[tileIndex++ % 2];
+            if (readback.tileX >= 0) {
+                finishReadback(readback);
+            }
+            startReadback(readback, tileX);
+        }
+
+        for (Readback& readback : m_readbacks) {
+            if (readback.tileX >= 0) {
+                finishReadback(readback);
+            }
+        }
+        rendered = rendered && writeRow(file, tileY);
+        TRACE("Wrote row %d of %d", tileY + 1, m_tilesY);
+    }
+
+    fclose(file);
+    if (!rendered) {
+        INFO("Tiled render of '%s' failed", fileName);
+        return false;
+    }
+
+    const float seconds = GetTime() - startTime;
+    INFO("Rendered '%s' in %f seconds (%.2f megapixels per second)", fileName, seconds, (float) width * height / seconds / 1e6f);
+    return true;
+}
+
+
+bool TiledRender::renderTile(int tileX, int tileY) {
+    gputimer::update();
+    m_raytracer.setRegion({(float) tileX * m_params.tileSize, (float) tileY * m_params.tileSize}, m_params.imageSize);
+
+    for (uint32_t frame = 0; frame < m_params.frames; frame++) {
+        // nothing is dispatched while a variant compiles, so this waits for it
+        const int frameIndex = m_raytracer.getFrameIndex();
+        while (m_raytracer.getFrameIndex() == frameIndex) {
+            m_raytracer.runComputeShader();
+            if (m_raytracer.m_computeShaderProgram == 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void TiledRender::startReadback(Readback& readback, int tileX) {
+    // the image was written by the compute shader, not through the texture api
+    glext::memoryBarrier(glext::TEXTURE_UPDATE_BARRIER_BIT);
+    rlEnableTexture(m_raytracer.m_outTexture.id);
+    glext::bindBuffer(glext::PIXEL_PACK_BUFFER, readback.buffer);
+    // into the bound buffer, so this returns before the copy is done
+    glext::getTexImage(0, glext::RGBA, glext::UNSIGNED_BYTE, nullptr);
+    glext::bindBuffer(glext::PIXEL_PACK_BUFFER, 0);
+    rlDisableTexture();
+
+    readback.fence = glext::fenceSync();
+    readback.tileX = tileX;
+}
+
+
+void TiledRender::finishReadback(Readback& readback) {
+    // waits without a timeout, the copy has been submitted
+    glext::waitSync(readback.fence, UINT64_MAX);
+    glext::deleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    const int tileSize = m_params.tileSize;
+    const int width = m_params.imageSize.x;
+    const int x0 = readback.tileX * tileSize;
+    const int copyWidth = std::min(tileSize, width - x0);
+
+    glext::bindBuffer(glext::PIXEL_PACK_BUFFER, readback.buffer);
+    const unsigned char* pixels = (const unsigned char*) glext::mapBufferRange(glext::PIXEL_PACK_BUFFER, 0, (size_t) tileSize * tileSize * 4, glext::MAP_READ_BIT);
+
+    if (pixels != nullptr) {
+        // rgba to rgb, edge tiles reach past the image
+        for (int y = 0; y < tileSize; y++) {
+            const unsigned char* src = pixels + (size_t) y * tileSize * 4;
+            unsigned char* dst = m_row.data() + ((size_t) y * width + x0) * 3;
+            for (int x = 0; x < copyWidth; x++) {
+                dst[3 * x + 0] = src[4 * x + 0];
+                dst[3 * x + 1] = src[4 * x + 1];
+                dst[3 * x + 2] = src[4 * x + 2];
+            }
+        }
+        glext::unmapBuffer(glext::PIXEL_PACK_BUFFER);
+    }
+
+    glext::bindBuffer(glext::PIXEL_PACK_BUFFER, 0);
+    readback.tileX = -1;
+}
+
+
+bool TiledRender::writeRow(FILE* file, int tileY) {
+    const int width = m_params.imageSize.x;
+    const int height = m_params.imageSize.y;
+    const int rows = std::min(m_params.tileSize, height - tileY * m_params.tileSize);
+
+    const size_t rowBytes = (size_t) width * rows * 3;
+    if (fwrite(m_row.data(), 1, rowBytes, file) != rowBytes) {
+        INFO("Failed to write rows of tile row %d", tileY);
+        return false;
+    }
+    return true;
+}
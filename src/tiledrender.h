@@ -0,0 +1,53 @@
+#pragma once
+
+#include "src/raytracer.h"
+#include <stdio.h>
+#include <vector>
+
+
+struct TiledRenderParams {
+    // of the whole image, may exceed the maximum texture size
+    Vector2 imageSize;
+    // a multiple of the workgroup size
+    int tileSize = 512;
+    uint32_t frames;
+};
+
+
+// renders an image of any size one tile at a time into a binary ppm
+// the raytracer's texture is resized to a single tile and reused, each tile is read back into a pixel buffer
+// while the next one renders, and finished rows of tiles are written out, so memory stays bounded by a row of tiles
+class TiledRender {
+
+public:
+    // the raytracer's scene and config must be set, and its camera set up for the whole image
+    TiledRender(Raytracer& raytracer, const TiledRenderParams& params);
+    ~TiledRender();
+    bool render(const char* fileName);
+
+private:
+    // a tile's readback in flight
+    struct Readback {
+        uint32_t buffer;
+        void* fence = nullptr;
+        int tileX = -1;
+    };
+
+private:
+    // false when no program could be built
+    bool renderTile(int tileX, int tileY);
+    void startReadback(Readback& readback, int tileX);
+    // waits for the copy, then moves the pixels into the row of tiles
+    void finishReadback(Readback& readback);
+    bool writeRow(FILE* file, int tileY);
+
+private:
+    Raytracer& m_raytracer;
+    TiledRenderParams m_params;
+    int m_tilesX;
+    int m_tilesY;
+    // two, so one tile is copied while the next renders
+    Readback m_readbacks[2];
+    // rgb of every pixel in one row of tiles
+    std::vector<unsigned char> m_row;
+};